@@ -0,0 +1,133 @@
+#include "Corpus.h"
+
+#include <random>
+
+namespace {
+
+    const char *const names[] = {"value", "index", "whale", "form", "this_one", "counter",
+                                 "an", "orbit", "printer", "x", "returned", "superb"};
+    constexpr std::size_t nameCount = sizeof(names) / sizeof(names[0]);
+
+    // one operand of an expression chain: a name, a literal, a call or a grouping
+    void operand(std::string &source, std::mt19937 &rng) {
+        const char *name = names[rng() % nameCount];
+        switch (rng() % 6) {
+            case 0:
+                source += std::to_string(rng() % 1000);
+                break;
+            case 1:
+                source += name;
+                source += "(";
+                source += names[rng() % nameCount];
+                source += ", ";
+                source += std::to_string(rng() % 10);
+                source += ")";
+                break;
+            case 2:
+                source += "(";
+                source += name;
+                source += " - 1)";
+                break;
+            case 3:
+                source += "-";
+                source += name;
+                break;
+            default:
+                source += name;
+        }
+    }
+
+}// namespace
+
+std::string cpplox::bench::identifierCorpus(std::size_t bytes) {
+    std::string source;
+    for (std::size_t i = 0; source.size() < bytes; i++) {
+        const char *a = names[i % nameCount];
+        const char *b = names[(i * 7 + 3) % nameCount];
+        source += "var ";
+        source += a;
+        source += std::to_string(i % 100);
+        source += " = ";
+        source += b;
+        source += " and ";
+        source += a;
+        source += " or ";
+        source += b;
+        source += ";\n";
+    }
+    return source;
+}
+
+std::string cpplox::bench::literalCorpus(std::size_t bytes) {
+    std::mt19937 rng(42);
+    std::string source;
+    for (std::size_t i = 0; source.size() < bytes; i++) {
+        source += "var row" + std::to_string(i % 1000) + " = ";
+        for (int column = 0; column < 8; column++) {
+            if (column > 0) source += " + ";
+            if (column == 3) source += "\"cell " + std::to_string(rng() % 100000) + "\"";
+            else if (column % 2 == 0) source += std::to_string(rng() % 1000000);
+            else source += std::to_string(rng() % 10000) + "." + std::to_string(rng() % 100);
+        }
+        source += ";\n";
+    }
+    return source;
+}
+
+std::string cpplox::bench::nestedCorpus(std::size_t bytes) {
+    constexpr int depth = 48;
+    std::string source;
+    for (std::size_t i = 0; source.size() < bytes; i++) {
+        for (int level = 0; level < depth; level++) {
+            source.append(static_cast<std::size_t>(level) * 2, ' ');
+            switch ((level + i) % 3) {
+                case 0: source += "{\n"; break;
+                case 1: source += "if (depth" + std::to_string(level) + " < " + std::to_string(i % 100) + ") {\n"; break;
+                default: source += "while (depth" + std::to_string(level) + ") {\n";
+            }
+            source.append(static_cast<std::size_t>(level) * 2 + 2, ' ');
+            source += "var depth" + std::to_string(level + 1) + " = depth" + std::to_string(level) + " + 1;\n";
+        }
+        for (int level = depth - 1; level >= 0; level--) {
+            source.append(static_cast<std::size_t>(level) * 2, ' ');
+            source += (level + i) % 3 == 1 ? "} else {}\n" : "}\n";
+        }
+    }
+    return source;
+}
+
+std::string cpplox::bench::expressionCorpus(std::size_t bytes) {
+    static const char *const operators[] = {" + ", " - ", " * ", " / ", " < ", " >= ", " == ", " != ", " and ", " or "};
+    std::mt19937 rng(7);
+    std::string source;
+    for (std::size_t i = 0; source.size() < bytes; i++) {
+        source += "chain" + std::to_string(i % 100) + " = ";
+        operand(source, rng);
+        for (int term = 0; term < 64; term++) {
+            source += operators[rng() % 10];
+            if (rng() % 4 == 0) source += "!";
+            operand(source, rng);
+        }
+        source += ";\n";
+    }
+    return source;
+}
+
+std::string cpplox::bench::commentCorpus(std::size_t bytes) {
+    std::string source;
+    for (std::size_t i = 0; source.size() < bytes; i++) {
+        source += "        // generated entry " + std::to_string(i) + ", do not edit by hand, see the generator\n";
+        source += "        var configuration_entry_name = \"some fairly long configuration string value\";\n\n";
+    }
+    return source;
+}
+
+std::vector<cpplox::bench::Corpus> cpplox::bench::corpora(std::size_t bytes) {
+    std::vector<Corpus> all;
+    all.push_back({"identifiers", identifierCorpus(bytes)});
+    all.push_back({"literals", literalCorpus(bytes)});
+    all.push_back({"nested", nestedCorpus(bytes)});
+    all.push_back({"expressions", expressionCorpus(bytes)});
+    all.push_back({"comments", commentCorpus(bytes)});
+    return all;
+}
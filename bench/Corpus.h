@@ -0,0 +1,34 @@
+#ifndef CPPLOX_BENCH_CORPUS_H
+#define CPPLOX_BENCH_CORPUS_H
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace cpplox::bench {
+
+    // A synthetic Lox program of roughly the requested size. The generators
+    // only use their own counters and a fixed-seed std::mt19937, so the same
+    // size always gives the same bytes, on every platform.
+    struct Corpus {
+        const char *name;
+        std::string source;
+    };
+
+    // mostly user names, some of them keyword look-alikes
+    std::string identifierCorpus(std::size_t bytes);
+    // data tables of number and string literals
+    std::string literalCorpus(std::size_t bytes);
+    // blocks, ifs and whiles nested a few dozen levels deep
+    std::string nestedCorpus(std::size_t bytes);
+    // long chains of binary, logical and unary operators, groupings and calls
+    std::string expressionCorpus(std::size_t bytes);
+    // long comments, indentation and string literals, the runs the skip kernels handle
+    std::string commentCorpus(std::size_t bytes);
+
+    // all of the above, in that order
+    std::vector<Corpus> corpora(std::size_t bytes);
+
+}// namespace cpplox::bench
+
+#endif// CPPLOX_BENCH_CORPUS_H
@@ -0,0 +1,250 @@
+#include "Corpus.h"
+#include "FlatAst.h"
+#include "Parser.h"
+#include "Scanner.h"
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstddef>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <sys/resource.h>
+#include <unordered_map>
+#include <vector>
+
+using namespace cpplox;
+
+namespace {
+
+    // the lookup Scanner::parseKeywords used before the perfect hash
+    const std::unordered_map<std::string, TokenType> keywordMap = {
+            {"and", TokenType::AND},
+            {"class", TokenType::CLASS},
+            {"else", TokenType::ELSE},
+            {"false", TokenType::FALSE_TOKEN},
+            {"for", TokenType::FOR},
+            {"fun", TokenType::FUN},
+            {"if", TokenType::IF},
+            {"nil", TokenType::NIL},
+            {"or", TokenType::OR},
+            {"print", TokenType::PRINT},
+            {"return", TokenType::RETURN},
+            {"super", TokenType::SUPER},
+            {"this", TokenType::THIS},
+            {"true", TokenType::TRUE_TOKEN},
+            {"var", TokenType::VAR},
+            {"while", TokenType::WHILE}};
+
+    struct Options {
+        std::size_t megabytes = 8;
+        int repeat = 5;
+        bool json = false;
+        // run a single corpus, so its peak RSS isn't masked by the others
+        std::string only;
+    };
+
+    struct Result {
+        const char *name;
+        std::size_t bytes = 0;
+        std::size_t tokens = 0;
+        std::size_t nodes = 0;
+        double scanSeconds = 0;
+        double parseSeconds = 0;
+        // the parsed program in the arena, and lowered to a flat::Tree
+        std::size_t astBytes = 0;
+        std::size_t flatBytes = 0;
+        long peakRssKiB = 0;
+    };
+
+    std::size_t countNodes(const AST::pExpr &pExpr);
+
+    std::size_t countNodes(const AST::pStmt &pStmt) {
+        return std::visit(
+                [](auto &&pStmt) -> std::size_t {
+                    using T = std::decay_t<decltype(pStmt)>;
+                    std::size_t nodes = 1;
+                    if constexpr (std::is_same_v<T, std::nullptr_t>) return 0;
+                    if constexpr (std::is_same_v<T, AST::pBlockStmt>)
+                        for (const AST::pStmt &statement: pStmt->statements) nodes += countNodes(statement);
+                    if constexpr (std::is_same_v<T, AST::pExpressionStmt> || std::is_same_v<T, AST::pPrintStmt>) nodes += countNodes(pStmt->expression);
+                    if constexpr (std::is_same_v<T, AST::pFunctionStmt>)
+                        for (const AST::pStmt &statement: pStmt->body) nodes += countNodes(statement);
+                    if constexpr (std::is_same_v<T, AST::pIfStmt>) nodes += countNodes(pStmt->condition) + countNodes(pStmt->thenBranch) + countNodes(pStmt->elseBranch);
+                    if constexpr (std::is_same_v<T, AST::pVarStmt>) nodes += countNodes(pStmt->initializer);
+                    if constexpr (std::is_same_v<T, AST::pWhileStmt>) nodes += countNodes(pStmt->condition) + countNodes(pStmt->body);
+                    return nodes;
+                },
+                pStmt);
+    }
+
+    std::size_t countNodes(const AST::pExpr &pExpr) {
+        return std::visit(
+                [](auto &&pExpr) -> std::size_t {
+                    using T = std::decay_t<decltype(pExpr)>;
+                    std::size_t nodes = 1;
+                    if constexpr (std::is_same_v<T, std::nullptr_t>) return 0;
+                    if constexpr (std::is_same_v<T, AST::pAssignExpr>) nodes += countNodes(pExpr->value);
+                    if constexpr (std::is_same_v<T, AST::pBinaryExpr> || std::is_same_v<T, AST::pLogicalExpr>) nodes += countNodes(pExpr->left) + countNodes(pExpr->right);
+                    if constexpr (std::is_same_v<T, AST::pCallExpr>) {
+                        nodes += countNodes(pExpr->callee);
+                        for (const AST::pExpr &argument: pExpr->arguments) nodes += countNodes(argument);
+                    }
+                    if constexpr (std::is_same_v<T, AST::pGroupingExpr>) nodes += countNodes(pExpr->expression);
+                    if constexpr (std::is_same_v<T, AST::pUnaryExpr>) nodes += countNodes(pExpr->right);
+                    return nodes;
+                },
+                pExpr);
+    }
+
+    // the fastest of `repeat` runs, which is the least disturbed by the rest of the machine
+    template<typename F>
+    double bestSeconds(int repeat, F &&f) {
+        double best = 0;
+        for (int run = 0; run < repeat; run++) {
+            const auto begin = std::chrono::steady_clock::now();
+            f();
+            const double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+            if (run == 0 || secs < best) best = secs;
+        }
+        return best;
+    }
+
+    // the high-water mark of the whole process so far, in KiB on Linux
+    long peakRssKiB() {
+        rusage usage{};
+        getrusage(RUSAGE_SELF, &usage);
+        return usage.ru_maxrss;
+    }
+
+    Result measure(const bench::Corpus &corpus, int repeat) {
+        Result result{corpus.name};
+        result.bytes = corpus.source.size();
+        result.scanSeconds = bestSeconds(repeat, [&] { result.tokens = Scanner(corpus.source).scanTokens().size(); });
+
+        // parse from a list scanned up front, so the timing covers Parser::parse alone;
+        // dropping the previous run's arena is a few chunk frees, whatever the tree size
+        const TokenList tokens = Scanner(corpus.source).scanTokens();
+        std::unique_ptr<Arena> arena;
+        std::vector<AST::pStmt> program;
+        result.parseSeconds = bestSeconds(repeat, [&] {
+            program.clear();
+            arena.reset();
+            arena = std::make_unique<Arena>();
+            TokenList::Reader reader(tokens);
+            program = Parser(reader, *arena).parse();
+        });
+        for (const AST::pStmt &statement: program) result.nodes += countNodes(statement);
+        result.astBytes = arena->bytesUsed() + program.size() * sizeof(AST::pStmt);
+        result.flatBytes = flat::Tree(program).bytes();
+        result.peakRssKiB = peakRssKiB();
+        return result;
+    }
+
+    void keywordBench(const std::string &source, int repeat, bool json) {
+        // split the corpus into words once, so both lookups see the same views
+        std::vector<std::string_view> words;
+        for (std::size_t i = 0; i < source.size();) {
+            std::size_t j = i;
+            while (j < source.size() && (std::isalnum(static_cast<unsigned char>(source[j])) || source[j] == '_')) j++;
+            if (j > i && !std::isdigit(static_cast<unsigned char>(source[i]))) words.push_back(std::string_view(source).substr(i, j - i));
+            i = j == i ? i + 1 : j;
+        }
+
+        std::size_t hits = 0;
+        const double map = bestSeconds(repeat, [&] {
+            for (std::string_view word: words)
+                if (keywordMap.find(std::string(word)) != keywordMap.end()) hits++;
+        });
+        const double hash = bestSeconds(repeat, [&] {
+            for (std::string_view word: words)
+                if (keywords::find(word)) hits++;
+        });
+
+        const auto perSecond = [&](double secs) { return static_cast<double>(words.size()) / secs; };
+        if (json) {
+            std::cout << "  \"keywords\": {\"words\": " << words.size() << ", \"unordered_map_words_per_s\": " << perSecond(map)
+                      << ", \"perfect_hash_words_per_s\": " << perSecond(hash) << "},\n";
+        } else {
+            std::cout << std::left << std::setw(30) << "keywords: unordered_map" << std::right << std::setw(10)
+                      << perSecond(map) / 1e6 << " Mwords/s\n"
+                      << std::left << std::setw(30) << "keywords: perfect hash" << std::right << std::setw(10)
+                      << perSecond(hash) / 1e6 << " Mwords/s\n";
+        }
+        // keep the optimizer from dropping the loops
+        if (hits == 0) std::cerr << "no keywords found" << std::endl;
+    }
+
+    void print(const Result &result, bool json, bool last) {
+        const double megabytes = static_cast<double>(result.bytes) / 1e6;
+        if (json) {
+            std::cout << "    {\"name\": \"" << result.name << "\", \"bytes\": " << result.bytes
+                      << ", \"tokens\": " << result.tokens << ", \"nodes\": " << result.nodes
+                      << ", \"scan_seconds\": " << result.scanSeconds
+                      << ", \"scan_mb_per_s\": " << megabytes / result.scanSeconds
+                      << ", \"scan_tokens_per_s\": " << static_cast<double>(result.tokens) / result.scanSeconds
+                      << ", \"parse_seconds\": " << result.parseSeconds
+                      << ", \"parse_nodes_per_s\": " << static_cast<double>(result.nodes) / result.parseSeconds
+                      << ", \"ast_bytes\": " << result.astBytes << ", \"flat_ast_bytes\": " << result.flatBytes
+                      << ", \"peak_rss_kib\": " << result.peakRssKiB << "}" << (last ? "\n" : ",\n");
+            return;
+        }
+        std::cout << std::left << std::setw(14) << result.name << std::right
+                  << std::setw(8) << megabytes << " MB"
+                  << std::setw(10) << megabytes / result.scanSeconds << " MB/s"
+                  << std::setw(10) << static_cast<double>(result.tokens) / result.scanSeconds / 1e6 << " Mtok/s"
+                  << std::setw(10) << static_cast<double>(result.nodes) / result.parseSeconds / 1e6 << " Mnodes/s"
+                  << std::setw(8) << static_cast<double>(result.astBytes) / 1e6 << " MB AST"
+                  << std::setw(8) << static_cast<double>(result.flatBytes) / 1e6 << " MB flat"
+                  << std::setw(10) << result.peakRssKiB / 1024 << " MiB peak RSS\n";
+    }
+
+    bool parseOptions(int argc, char *argv[], Options &options) {
+        for (int i = 1; i < argc; i++) {
+            const char *arg = argv[i];
+            if (std::strcmp(arg, "--json") == 0) options.json = true;
+            else if (std::strncmp(arg, "--mb=", 5) == 0) options.megabytes = std::stoul(arg + 5);
+            else if (std::strncmp(arg, "--repeat=", 9) == 0) options.repeat = std::max(1, std::stoi(arg + 9));
+            else if (std::strncmp(arg, "--corpus=", 9) == 0) options.only = arg + 9;
+            else return false;
+        }
+        return true;
+    }
+
+}// namespace
+
+int main(int argc, char *argv[]) {
+    Options options;
+    if (!parseOptions(argc, argv, options)) {
+        std::cout << "Usage: cpplox.bench [--json] [--mb=N] [--repeat=N] "
+                     "[--corpus=identifiers|literals|nested|expressions|comments]"
+                  << std::endl;
+        return 64;
+    }
+
+    std::vector<bench::Corpus> corpora = bench::corpora(options.megabytes * 1000 * 1000);
+    if (!options.only.empty()) {
+        corpora.erase(std::remove_if(corpora.begin(), corpora.end(), [&](const bench::Corpus &corpus) { return corpus.name != options.only; }),
+                      corpora.end());
+        if (corpora.empty()) {
+            std::cout << "Unknown corpus " << options.only << std::endl;
+            return 64;
+        }
+    }
+
+    std::cout << std::fixed << std::setprecision(options.json ? 6 : 1);
+    if (options.json) std::cout << "{\n";
+    keywordBench(bench::identifierCorpus(options.megabytes * 1000 * 1000 / 4), options.repeat, options.json);
+    if (options.json) std::cout << "  \"corpora\": [\n";
+    for (std::size_t i = 0; i < corpora.size(); i++) {
+        const Result result = measure(corpora[i], options.repeat);
+        // the source is no longer needed, drop it before the next corpus is measured
+        corpora[i].source = std::string();
+        print(result, options.json, i + 1 == corpora.size());
+    }
+    if (options.json) std::cout << "  ],\n  \"peak_rss_kib\": " << peakRssKiB() << "\n}" << std::endl;
+    return 0;
+}
@@ -1,11 +1,74 @@
 #include "Runner.h"
 
+#include <cctype>
+#include <cerrno>
+#include <cstdlib>
 #include <iostream>
+#include <limits>
+#include <string>
+#include <string_view>
 #include <sysexits.h>
 
+namespace {
+
+    int usage() {
+        std::cout << "Usage: cpplox [options] [script | -]" << std::endl
+                  << "  --lex-threads=N             threads used to lex large scripts" << std::endl
+                  << "  --parallel-lex-threshold=N  size in bytes from which a script is lexed in parallel" << std::endl
+                  << "  --engine=tree|flat|vm|closure" << std::endl
+                  << "                              walk the AST or a flat struct-of-arrays copy of it, run bytecode," << std::endl
+                  << "                              or run each function body compiled to C++ closures" << std::endl
+                  << "  --no-optimize               don't fold constants or hoist loop invariants first" << std::endl
+                  << "  --cse                       compute repeated subexpressions once per statement run" << std::endl
+                  << "  --lazy-functions            parse function bodies on their first call (tree, closure engines)" << std::endl
+                  << "  --no-cache                  always compile the script, and don't write a .loxc" << std::endl
+                  << "  --cache-dir=DIR             keep .loxc files in DIR instead of next to the scripts" << std::endl
+                  << "  --cache-stats               print cache hits and misses to stderr" << std::endl;
+        return EX_USAGE;
+    }
+
+    enum class Numeric { Other, Stored, Invalid };
+
+    // accepts "--name=value" and stores the number in value; anything but a
+    // whole unsigned number that fits is Invalid, rather than quietly 0
+    template<typename T>
+    Numeric numericOption(std::string_view arg, std::string_view name, T &value) {
+        if (arg.substr(0, name.length()) != name || arg.substr(name.length(), 1) != "=") return Numeric::Other;
+        const std::string text(arg.substr(name.length() + 1));
+        // strtoull would skip blanks and take a sign
+        if (text.empty() || !std::isdigit(static_cast<unsigned char>(text.front()))) return Numeric::Invalid;
+        char *end = nullptr;
+        errno = 0;
+        const unsigned long long number = std::strtoull(text.c_str(), &end, 10);
+        if (*end != '\0' || errno == ERANGE || number > static_cast<unsigned long long>(std::numeric_limits<T>::max())) return Numeric::Invalid;
+        value = static_cast<T>(number);
+        return Numeric::Stored;
+    }
+
+}// namespace
+
 int main(const int argc, char **argv) {
-    if (argc == 1) return cpplox::Runner::runREPL();
-    if (argc == 2) return cpplox::Runner::runScript(argv[1]);
-    std::cout << "Usage: cpplox [script]" << std::endl;
-    return EX_USAGE;
+    cpplox::Runner::Options options;
+    std::string script;
+    for (int i = 1; i < argc; i++) {
+        const std::string_view arg = argv[i];
+        Numeric numeric = numericOption(arg, "--lex-threads", options.lexThreads);
+        if (numeric == Numeric::Other) numeric = numericOption(arg, "--parallel-lex-threshold", options.parallelLexThreshold);
+        if (numeric == Numeric::Invalid) return usage();
+        if (numeric == Numeric::Stored) continue;
+        if (arg == "--engine=tree") options.engine = cpplox::Runner::Engine::Tree;
+        else if (arg == "--engine=flat") options.engine = cpplox::Runner::Engine::Flat;
+        else if (arg == "--engine=vm") options.engine = cpplox::Runner::Engine::Vm;
+        else if (arg == "--engine=closure") options.engine = cpplox::Runner::Engine::Closure;
+        else if (arg == "--no-optimize") options.optimize = false;
+        else if (arg == "--cse") options.eliminateSubexpressions = true;
+        else if (arg == "--lazy-functions") options.lazyBodies = true;
+        else if (arg == "--no-cache") options.cache = false;
+        else if (arg.substr(0, 12) == "--cache-dir=") options.cacheDirectory = arg.substr(12);
+        else if (arg == "--cache-stats") options.cacheStats = true;
+        else if (arg.substr(0, 2) == "--" || !script.empty()) return usage();
+        else script = arg;
+    }
+    if (script.empty()) return cpplox::Runner::runREPL(options);
+    return cpplox::Runner::runScript(script, options);
 }
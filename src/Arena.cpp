@@ -0,0 +1,30 @@
+#include "Arena.h"
+
+#include <algorithm>
+
+namespace {
+
+    constexpr std::size_t maxChunkSize = 4 * 1024 * 1024;
+
+    std::byte *alignUp(std::byte *p, std::size_t alignment) {
+        const auto address = reinterpret_cast<std::uintptr_t>(p);
+        return p + ((alignment - address % alignment) % alignment);
+    }
+
+}// namespace
+
+void *cpplox::Arena::allocate(std::size_t size, std::size_t alignment) {
+    std::byte *start = next ? alignUp(next, alignment) : nullptr;
+    if (!start || start + size > limit) {
+        // chunks double up to a cap, and anything bigger than a chunk gets one of its own
+        const std::size_t chunkSize = std::max(nextChunkSize, size + alignment);
+        chunks.emplace_back(new std::byte[chunkSize]);
+        next = chunks.back().get();
+        limit = next + chunkSize;
+        nextChunkSize = std::min(nextChunkSize * 2, maxChunkSize);
+        start = alignUp(next, alignment);
+    }
+    next = start + size;
+    used += size;
+    return start;
+}
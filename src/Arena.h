@@ -0,0 +1,81 @@
+#ifndef CPPLOX_ARENA_H
+#define CPPLOX_ARENA_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace cpplox {
+
+    // a read-only run of elements that lives in an Arena
+    template<class T>
+    class Span {
+    public:
+        Span() = default;
+        Span(const T *first, std::uint32_t count) : first(first), count(count) {}
+
+        const T *begin() const { return first; }
+        const T *end() const { return first + count; }
+        std::size_t size() const { return count; }
+        bool empty() const { return count == 0; }
+        const T &operator[](std::size_t index) const { return first[index]; }
+
+    private:
+        const T *first = nullptr;
+        std::uint32_t count = 0;
+    };
+
+    // Bump allocator that owns every node of one parse. Nodes are trivially
+    // destructible and handed out as plain pointers, so freeing a program is
+    // a handful of chunk frees instead of a recursive walk over the tree.
+    class Arena {
+    public:
+        Arena() = default;
+        Arena(const Arena &) = delete;
+        Arena &operator=(const Arena &) = delete;
+
+        template<class T, class... Args>
+        T *make(Args &&...args) {
+            static_assert(std::is_trivially_destructible_v<T>, "the arena never runs destructors");
+            return new (allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+        }
+
+        // moves the items next to the nodes that refer to them
+        template<class T>
+        Span<T> copy(const std::vector<T> &items) {
+            static_assert(std::is_trivially_destructible_v<T>, "the arena never runs destructors");
+            if (items.empty()) return {};
+            T *first = static_cast<T *>(allocate(sizeof(T) * items.size(), alignof(T)));
+            std::uninitialized_copy(items.begin(), items.end(), first);
+            return {first, static_cast<std::uint32_t>(items.size())};
+        }
+
+        // a copy of the characters that lives as long as the arena
+        std::string_view copy(std::string_view text) {
+            char *first = static_cast<char *>(allocate(text.size(), 1));
+            std::copy(text.begin(), text.end(), first);
+            return {first, text.size()};
+        }
+
+        // bytes handed out so far, not counting the unused tail of each chunk
+        std::size_t bytesUsed() const { return used; }
+
+    private:
+        std::vector<std::unique_ptr<std::byte[]>> chunks;
+        std::byte *next = nullptr;
+        std::byte *limit = nullptr;
+        std::size_t nextChunkSize = 64 * 1024;
+        std::size_t used = 0;
+
+        void *allocate(std::size_t size, std::size_t alignment);
+    };
+
+}// namespace cpplox
+
+#endif// CPPLOX_ARENA_H
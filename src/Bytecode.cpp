@@ -0,0 +1,254 @@
+#include "Bytecode.h"
+
+#include <algorithm>
+#include <cstring>
+#include <type_traits>
+#include <variant>
+
+cpplox::vm::Program::Program(const std::vector<AST::pStmt> &program) {
+    prototypes.push_back(std::make_unique<Prototype>(Prototype{intern("script"), 0, 0, 0, {}, {}, {}}));
+    Compiler(*this, *prototypes.front()).compile(program);
+    Heap::global().addRoots(this);
+}
+
+cpplox::vm::Program::~Program() { Heap::global().removeRoots(this); }
+
+void cpplox::vm::Program::markRoots(Heap &heap) {
+    for (const std::unique_ptr<Prototype> &prototype: prototypes)
+        for (const Value constant: prototype->chunk.constants) heap.mark(constant);
+}
+
+std::size_t cpplox::vm::Program::bytes() const {
+    std::size_t total = 0;
+    for (const std::unique_ptr<Prototype> &prototype: prototypes)
+        total += sizeof(Prototype) + prototype->chunk.code.size() * (1 + sizeof(std::uint32_t)) +
+                 prototype->chunk.constants.size() * sizeof(Value) + prototype->captures.size() * sizeof(Capture);
+    return total;
+}
+
+void cpplox::vm::Compiler::compile(const std::vector<AST::pStmt> &statements) {
+    for (const AST::pStmt &statement: statements) compile(statement);
+    finish();
+}
+
+void cpplox::vm::Compiler::compile(Span<AST::pStmt> statements, std::uint32_t slots, Span<std::uint32_t> boxed) {
+    // the Resolver gives the parameters the first slots of the body's scope
+    scopes.push_back(0);
+    slotsUsed = slots;
+    prototype.slots = slots;
+    for (const std::uint32_t param: boxed) emit(OpCode::Box, param, 0, 0);
+    for (const AST::pStmt &statement: statements) compile(statement);
+    finish();
+}
+
+void cpplox::vm::Compiler::finish() {
+    // falling off the end returns nil
+    emit(OpCode::Nil, 0, 1);
+    emit(OpCode::Return, 0, -1);
+    prototype.frameSize = prototype.slots + maxDepth;
+}
+
+void cpplox::vm::Compiler::block(Span<AST::pStmt> statements, std::uint32_t slots) {
+    scopes.push_back(slotsUsed);
+    slotsUsed += slots;
+    prototype.slots = std::max(prototype.slots, slotsUsed);
+    for (const AST::pStmt &statement: statements) compile(statement);
+    slotsUsed -= slots;
+    scopes.pop_back();
+}
+
+void cpplox::vm::Compiler::function(const AST::pFunctionStmt &pStmt) {
+    const auto index = static_cast<std::uint32_t>(prototype.functions.size());
+    program.prototypes.push_back(std::make_unique<Prototype>(
+            Prototype{pStmt->name.symbol, static_cast<std::uint32_t>(pStmt->params.size()), 0, 0, {}, {}, {}}));
+    Prototype &function = *program.prototypes.back();
+    prototype.functions.push_back(&function);
+    for (const AST::Capture &capture: pStmt->captures) function.captures.push_back({local(capture.from), capture.slot});
+    Compiler(program, function).compile(pStmt->body, pStmt->slots, pStmt->boxed);
+    emit(OpCode::Function, index, static_cast<std::uint32_t>(pStmt->name.line), 1);
+}
+
+void cpplox::vm::Compiler::compile(const AST::pStmt &pStmt) {
+    std::visit(
+            [this](auto &&pStmt) {
+                using T = std::decay_t<decltype(pStmt)>;
+                if constexpr (std::is_same_v<T, AST::pBlockStmt>) block(pStmt->statements, pStmt->slots);
+                if constexpr (std::is_same_v<T, AST::pExpressionStmt>) {
+                    compile(pStmt->expression);
+                    emit(OpCode::Pop, 0, -1);
+                }
+                if constexpr (std::is_same_v<T, AST::pFunctionStmt>) {
+                    // a function that calls itself captures its own Box, so that comes first
+                    if (pStmt->binding.boxed) {
+                        emit(OpCode::Nil, pStmt->name.line, 1);
+                        variable(OpCode::DefineGlobal, OpCode::DefineLocal, OpCode::DefineLocal, pStmt->binding, pStmt->name.line);
+                        function(pStmt);
+                        variable(OpCode::SetGlobal, OpCode::SetLocal, OpCode::SetBoxed, pStmt->binding, pStmt->name.line);
+                        emit(OpCode::Pop, 0, -1);
+                        return;
+                    }
+                    function(pStmt);
+                    variable(OpCode::DefineGlobal, OpCode::DefineLocal, OpCode::DefineLocal, pStmt->binding, pStmt->name.line);
+                }
+                if constexpr (std::is_same_v<T, AST::pIfStmt>) {
+                    compile(pStmt->condition);
+                    const std::size_t toElse = jump(OpCode::JumpIfFalse, 0, -1);
+                    compile(pStmt->thenBranch);
+                    if (std::holds_alternative<std::nullptr_t>(pStmt->elseBranch)) return land(toElse);
+                    const std::size_t toEnd = jump(OpCode::Jump, 0, 0);
+                    land(toElse);
+                    compile(pStmt->elseBranch);
+                    land(toEnd);
+                }
+                if constexpr (std::is_same_v<T, AST::pPrintStmt>) {
+                    compile(pStmt->expression);
+                    emit(OpCode::Print, 0, -1);
+                }
+                if constexpr (std::is_same_v<T, AST::pReturnStmt>) {
+                    if (std::holds_alternative<std::nullptr_t>(pStmt->value)) emit(OpCode::Nil, pStmt->keyword.line, 1);
+                    else compile(pStmt->value);
+                    emit(OpCode::Return, pStmt->keyword.line, -1);
+                }
+                if constexpr (std::is_same_v<T, AST::pVarStmt>) {
+                    if (std::holds_alternative<std::nullptr_t>(pStmt->initializer)) emit(OpCode::Nil, pStmt->name.line, 1);
+                    else compile(pStmt->initializer);
+                    variable(OpCode::DefineGlobal, OpCode::DefineLocal, OpCode::DefineLocal, pStmt->binding, pStmt->name.line);
+                }
+                if constexpr (std::is_same_v<T, AST::pWhileStmt>) {
+                    const auto start = static_cast<std::uint32_t>(prototype.chunk.code.size());
+                    compile(pStmt->condition);
+                    const std::size_t exit = jump(OpCode::JumpIfFalse, 0, -1);
+                    compile(pStmt->body);
+                    emit(OpCode::Jump, start, 0, 0);
+                    land(exit);
+                }
+            },
+            pStmt);
+}
+
+void cpplox::vm::Compiler::compile(const AST::pExpr &pExpr) {
+    std::visit(
+            [this](auto &&pExpr) {
+                using T = std::decay_t<decltype(pExpr)>;
+                if constexpr (std::is_same_v<T, AST::pAssignExpr>) {
+                    compile(pExpr->value);
+                    variable(OpCode::SetGlobal, OpCode::SetLocal, OpCode::SetBoxed, pExpr->binding, pExpr->name.line);
+                }
+                if constexpr (std::is_same_v<T, AST::pBinaryExpr>) {
+                    compile(pExpr->left);
+                    compile(pExpr->right);
+                    const OpCode op = [](TokenType type) {
+                        switch (type) {
+                            case TokenType::EQUAL_EQUAL:
+                                return OpCode::Equal;
+                            case TokenType::BANG_EQUAL:
+                                return OpCode::NotEqual;
+                            case TokenType::GREATER:
+                                return OpCode::Greater;
+                            case TokenType::GREATER_EQUAL:
+                                return OpCode::GreaterEqual;
+                            case TokenType::LESS:
+                                return OpCode::Less;
+                            case TokenType::LESS_EQUAL:
+                                return OpCode::LessEqual;
+                            case TokenType::MINUS:
+                                return OpCode::Subtract;
+                            case TokenType::SLASH:
+                                return OpCode::Divide;
+                            case TokenType::STAR:
+                                return OpCode::Multiply;
+                            default:
+                                return OpCode::Add;
+                        }
+                    }(pExpr->op.type);
+                    emit(op, pExpr->op.line, -1);
+                }
+                if constexpr (std::is_same_v<T, AST::pCallExpr>) {
+                    compile(pExpr->callee);
+                    for (const AST::pExpr &argument: pExpr->arguments) compile(argument);
+                    const auto count = static_cast<std::uint8_t>(pExpr->arguments.size());
+                    emit(OpCode::Call, pExpr->paren.line, -count);
+                    prototype.chunk.code.push_back(count);
+                    prototype.chunk.lines.push_back(pExpr->paren.line);
+                }
+                if constexpr (std::is_same_v<T, AST::pGroupingExpr>) compile(pExpr->expression);
+                if constexpr (std::is_same_v<T, AST::pLiteralExpr>) {
+                    std::visit(
+                            overloaded{
+                                    [this](std::monostate) { emit(OpCode::Nil, 0, 1); },
+                                    [this](bool value) { emit(value ? OpCode::True : OpCode::False, 0, 1); },
+                                    [this](auto value) { constant(value, 0); }},
+                            pExpr->value);
+                }
+                if constexpr (std::is_same_v<T, AST::pLogicalExpr>) {
+                    compile(pExpr->left);
+                    const OpCode op = pExpr->op.type == TokenType::OR ? OpCode::JumpIfTrueOrPop : OpCode::JumpIfFalseOrPop;
+                    const std::size_t toEnd = jump(op, pExpr->op.line, -1);
+                    compile(pExpr->right);
+                    land(toEnd);
+                }
+                if constexpr (std::is_same_v<T, AST::pUnaryExpr>) {
+                    compile(pExpr->right);
+                    emit(pExpr->op.type == TokenType::BANG ? OpCode::Not : OpCode::Negate, pExpr->op.line, 0);
+                }
+                if constexpr (std::is_same_v<T, AST::pVariableExpr>)
+                    variable(OpCode::GetGlobal, OpCode::GetLocal, OpCode::GetBoxed, pExpr->binding, pExpr->name.line);
+            },
+            pExpr);
+}
+
+std::uint32_t cpplox::vm::Compiler::local(const AST::Binding &binding) const { return scopes[scopes.size() - 1 - binding.depth] + binding.slot; }
+
+void cpplox::vm::Compiler::variable(OpCode global, OpCode local, OpCode boxed, const AST::Binding &binding, std::uint32_t line) {
+    // Get pushes, Set keeps its value and Define takes it
+    const int effect = global == OpCode::GetGlobal ? 1 : global == OpCode::SetGlobal ? 0 : -1;
+    if (binding.isGlobal()) return emit(global, binding.slot, line, effect);
+    emit(binding.boxed ? boxed : local, this->local(binding), line, effect);
+    // a define puts the value in its slot first, then boxes it there
+    if (binding.boxed && global == OpCode::DefineGlobal) emit(OpCode::Box, this->local(binding), line, 0);
+}
+
+void cpplox::vm::Compiler::constant(double value, std::uint32_t line) {
+    std::uint64_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    const auto [it, added] = numbers.try_emplace(bits, static_cast<std::uint32_t>(prototype.chunk.constants.size()));
+    if (added) prototype.chunk.constants.emplace_back(value);
+    emit(OpCode::Constant, it->second, line, 1);
+}
+
+void cpplox::vm::Compiler::constant(std::string_view value, std::uint32_t line) {
+    const auto [it, added] = strings.try_emplace(value, static_cast<std::uint32_t>(prototype.chunk.constants.size()));
+    if (added) prototype.chunk.constants.emplace_back(Heap::global().string(std::string(value)));
+    emit(OpCode::Constant, it->second, line, 1);
+}
+
+void cpplox::vm::Compiler::emit(OpCode op, std::uint32_t line, int effect) {
+    prototype.chunk.code.push_back(static_cast<std::uint8_t>(op));
+    prototype.chunk.lines.push_back(line);
+    depth += effect;
+    maxDepth = std::max(maxDepth, depth);
+}
+
+void cpplox::vm::Compiler::emit(OpCode op, std::uint32_t operand, std::uint32_t line, int effect) {
+    emit(op, line, effect);
+    this->operand(operand, line);
+}
+
+std::size_t cpplox::vm::Compiler::jump(OpCode op, std::uint32_t line, int effect) {
+    emit(op, line, effect);
+    const std::size_t at = prototype.chunk.code.size();
+    operand(0, line);
+    return at;
+}
+
+void cpplox::vm::Compiler::land(std::size_t jump) {
+    const auto target = static_cast<std::uint32_t>(prototype.chunk.code.size());
+    std::memcpy(&prototype.chunk.code[jump], &target, sizeof(target));
+}
+
+void cpplox::vm::Compiler::operand(std::uint32_t value, std::uint32_t line) {
+    std::uint8_t bytes[sizeof(value)];
+    std::memcpy(bytes, &value, sizeof(value));
+    prototype.chunk.code.insert(prototype.chunk.code.end(), bytes, bytes + sizeof(value));
+    prototype.chunk.lines.insert(prototype.chunk.lines.end(), sizeof(value), line);
+}
@@ -0,0 +1,158 @@
+#ifndef CPPLOX_BYTECODE_H
+#define CPPLOX_BYTECODE_H
+
+#include "Heap.h"
+#include "Object.h"
+#include "Stmt.h"
+#include "Symbol.h"
+#include "Token.h"
+#include <cstdint>
+#include <memory>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace cpplox::vm {
+
+    // Each instruction is an opcode byte followed by its operands, 4 bytes
+    // each unless noted, in host byte order.
+    enum class OpCode : std::uint8_t {
+        Constant,// index into constants
+        Nil,
+        True,
+        False,
+        Pop,
+        GetLocal,   // slot in the frame
+        SetLocal,   // slot in the frame; leaves the value on the stack
+        DefineLocal,// slot in the frame
+        // a local that closures capture and assign lives in a Box in its slot
+        Box,      // slot in the frame; puts its value in a new Box
+        GetBoxed, // slot in the frame
+        SetBoxed, // slot in the frame; leaves the value on the stack
+        GetGlobal,  // slot in Globals
+        SetGlobal,  // slot in Globals; leaves the value on the stack
+        DefineGlobal,
+        Equal,
+        NotEqual,
+        Greater,
+        GreaterEqual,
+        Less,
+        LessEqual,
+        Add,
+        Subtract,
+        Multiply,
+        Divide,
+        Not,
+        Negate,
+        Print,
+        Jump,       // offset in the chunk
+        JumpIfFalse,// offset in the chunk; pops the condition
+        // and/or: jump keeping the left operand, or pop it and go on to the right one
+        JumpIfFalseOrPop,
+        JumpIfTrueOrPop,
+        Function,// index into the enclosing Prototype's functions; takes its captures from the frame
+        Call,    // 1 byte: number of arguments
+        Return,  // pops the result, which takes the callee's place on the stack
+    };
+
+    struct Chunk {
+        std::vector<std::uint8_t> code;
+        // cold: the source line of each byte, only read to report runtime errors
+        std::vector<std::uint32_t> lines;
+        std::vector<Value> constants;
+    };
+
+    // a local of the enclosing frame that a call finds in its own, see AST::Capture
+    struct Capture {
+        std::uint32_t from;
+        std::uint32_t slot;
+    };
+
+    // A compiled function body, or the top level of a script.
+    // A frame holds the parameters and every local of the nested blocks, each
+    // block's locals right after those of the blocks around it, then the
+    // temporaries of the expressions.
+    struct Prototype {
+        Symbol name;
+        std::uint32_t arity;
+        // the parameters and locals, then those plus the deepest the stack gets above them
+        std::uint32_t slots;
+        std::uint32_t frameSize;
+        Chunk chunk;
+        // the declarations nested in this body
+        std::vector<const Prototype *> functions;
+        std::vector<Capture> captures;
+    };
+
+    // A resolved program compiled to bytecode, one Prototype per function
+    // declaration with the top level first. Like a flat::Tree it doesn't refer
+    // back to the Arena nodes, so those can be released once it is built.
+    // The strings among its constants stay on the Heap as long as it lives.
+    class Program : private Heap::Roots {
+    public:
+        explicit Program(const std::vector<AST::pStmt> &program);
+        Program(const Program &) = delete;
+        Program &operator=(const Program &) = delete;
+        ~Program();
+
+        const Prototype &script() const { return *prototypes.front(); }
+
+        // bytes of code and line tables, for comparing against flat::Tree::bytes
+        std::size_t bytes() const;
+
+    private:
+        // each Prototype stays put, running Functions point to theirs
+        std::vector<std::unique_ptr<Prototype>> prototypes;
+
+        void markRoots(Heap &heap) override;
+
+        friend class Compiler;
+    };
+
+    // Turns the statements of one function body, or of the top level, into its
+    // Prototype's chunk; the bodies of nested declarations get Compilers of
+    // their own. The tree has to be resolved and fully parsed, see AST::LazyBody.
+    class Compiler {
+    public:
+        Compiler(Program &program, Prototype &prototype) : program(program), prototype(prototype) {}
+
+        // boxed are the slots of the parameters that closures capture and assign
+        void compile(Span<AST::pStmt> statements, std::uint32_t slots, Span<std::uint32_t> boxed);
+        void compile(const std::vector<AST::pStmt> &statements);
+
+    private:
+        Program &program;
+        Prototype &prototype;
+        // where the locals of each enclosing block start in the frame, innermost last
+        std::vector<std::uint32_t> scopes;
+        std::uint32_t slotsUsed = 0;
+        std::uint32_t depth = 0;
+        std::uint32_t maxDepth = 0;
+        std::unordered_map<std::uint64_t, std::uint32_t> numbers;
+        std::unordered_map<std::string_view, std::uint32_t> strings;
+
+        void compile(const AST::pStmt &pStmt);
+        void compile(const AST::pExpr &pExpr);
+        void block(Span<AST::pStmt> statements, std::uint32_t slots);
+        void function(const AST::pFunctionStmt &pStmt);
+        void finish();
+
+        // the frame slot of a local binding
+        std::uint32_t local(const AST::Binding &binding) const;
+        // boxed is the op for a local in a Box, or local itself where that needs no special case
+        void variable(OpCode global, OpCode local, OpCode boxed, const AST::Binding &binding, std::uint32_t line);
+        void constant(double value, std::uint32_t line);
+        void constant(std::string_view value, std::uint32_t line);
+
+        // effect is how many values the instruction leaves on the stack, less those it takes
+        void emit(OpCode op, std::uint32_t line, int effect);
+        void emit(OpCode op, std::uint32_t operand, std::uint32_t line, int effect);
+        // a jump to be patched once its target is known, see land
+        std::size_t jump(OpCode op, std::uint32_t line, int effect);
+        void land(std::size_t jump);
+        void operand(std::uint32_t value, std::uint32_t line);
+    };
+
+}// namespace cpplox::vm
+
+#endif// CPPLOX_BYTECODE_H
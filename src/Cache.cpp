@@ -0,0 +1,611 @@
+#include "Cache.h"
+#include "SourceBuffer.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <exception>
+#include <fstream>
+#include <type_traits>
+#include <unistd.h>
+#include <unordered_map>
+#include <utility>
+#include <variant>
+
+#ifndef CPPLOX_VERSION
+#define CPPLOX_VERSION "unknown"
+#endif
+
+cpplox::Cache::Stats cpplox::Cache::counters;
+
+namespace {
+
+    using namespace cpplox;
+
+    // bumped whenever the encoding below, the meaning of a node or what the
+    // optimizing passes make of a program changes
+    constexpr std::uint32_t formatVersion = 8;
+
+    constexpr std::uint32_t optimized = 1;
+    constexpr std::uint32_t lazyBodies = 2;
+    constexpr std::uint32_t subexpressions = 4;
+
+    struct Header {
+        char magic[4];
+        std::uint32_t format;
+        char version[16];
+        std::uint64_t sourceHash;
+        std::uint64_t sourceSize;
+        std::uint32_t compiledWith;
+        // entries in the name table that follows the header
+        std::uint32_t names;
+        // contentHash of the name table and the program after it, so a torn
+        // write or a stray edit makes a miss instead of a program out of range
+        std::uint64_t payloadHash;
+    };
+
+    Header header(std::uint64_t sourceHash, std::uint64_t sourceSize, std::uint32_t compiledWith) {
+        Header header{{'L', 'O', 'X', 'C'}, formatVersion, {}, sourceHash, sourceSize, compiledWith, 0, 0};
+        std::strncpy(header.version, CPPLOX_VERSION, sizeof(header.version) - 1);
+        return header;
+    }
+
+    // XXH64: every bit of the input reaches every bit of the hash, so scripts
+    // that differ anywhere get different .loxc files
+    std::uint64_t contentHash(std::string_view bytes) {
+        constexpr std::uint64_t prime1 = 0x9e3779b185ebca87, prime2 = 0xc2b2ae3d27d4eb4f, prime3 = 0x165667b19e3779f9,
+                                prime4 = 0x85ebca77c2b2ae63, prime5 = 0x27d4eb2f165667c5;
+        const auto rotl = [](std::uint64_t x, int r) { return x << r | x >> (64 - r); };
+        const auto round = [rotl](std::uint64_t acc, std::uint64_t input) { return rotl(acc + input * prime2, 31) * prime1; };
+        const auto merge = [round](std::uint64_t hash, std::uint64_t acc) { return (hash ^ round(0, acc)) * prime1 + prime4; };
+        const auto read64 = [&bytes](std::size_t at) {
+            std::uint64_t word;
+            std::memcpy(&word, bytes.data() + at, sizeof(word));
+            return word;
+        };
+        const auto read32 = [&bytes](std::size_t at) {
+            std::uint32_t word;
+            std::memcpy(&word, bytes.data() + at, sizeof(word));
+            return static_cast<std::uint64_t>(word);
+        };
+
+        const std::size_t size = bytes.size();
+        std::size_t i = 0;
+        std::uint64_t hash;
+        if (size >= 32) {
+            std::uint64_t acc[4] = {prime1 + prime2, prime2, 0, 0 - prime1};
+            for (; i + 32 <= size; i += 32)
+                for (int lane = 0; lane < 4; lane++) acc[lane] = round(acc[lane], read64(i + 8 * lane));
+            hash = rotl(acc[0], 1) + rotl(acc[1], 7) + rotl(acc[2], 12) + rotl(acc[3], 18);
+            for (const std::uint64_t lane: acc) hash = merge(hash, lane);
+        } else {
+            hash = prime5;
+        }
+        hash += size;
+        for (; i + 8 <= size; i += 8) hash = rotl(hash ^ round(0, read64(i)), 27) * prime1 + prime4;
+        if (i + 4 <= size) {
+            hash = rotl(hash ^ read32(i) * prime1, 23) * prime2 + prime3;
+            i += 4;
+        }
+        for (; i < size; i++) hash = rotl(hash ^ static_cast<unsigned char>(bytes[i]) * prime5, 11) * prime1;
+        hash ^= hash >> 33;
+        hash *= prime2;
+        hash ^= hash >> 29;
+        hash *= prime3;
+        return hash ^ hash >> 32;
+    }
+
+    // the index of alternative T in Variant, which is what tags a node in the file
+    template<typename Variant, typename T>
+    constexpr std::uint8_t tag = static_cast<std::uint8_t>(Variant(std::in_place_type<T>).index());
+
+    // Nodes are written in pre-order: a tag, then the fields, with spans as a
+    // count followed by their items. Integers are LEB128 varints, since most
+    // are small. Symbols become indices into a name table, and so do global
+    // slots, which are handed out again when the file is read.
+    class Writer {
+    public:
+        explicit Writer(const Globals &globals) : globals(globals) {}
+
+        std::string bytes;
+        std::vector<Symbol> names;
+
+        template<typename T>
+        void put(const T &value) {
+            static_assert(std::is_trivially_copyable_v<T>);
+            bytes.append(reinterpret_cast<const char *>(&value), sizeof(T));
+        }
+
+        void varint(std::uint32_t value) {
+            for (; value >= 0x80; value >>= 7) bytes.push_back(static_cast<char>(value | 0x80));
+            bytes.push_back(static_cast<char>(value));
+        }
+
+        void put(std::string_view text) {
+            varint(static_cast<std::uint32_t>(text.size()));
+            bytes.append(text);
+        }
+
+        void put(const Name &name) {
+            varint(nameIndex(name.symbol));
+            varint(static_cast<std::uint32_t>(name.line));
+        }
+
+        void put(const Token &token) {
+            put(token.type);
+            put(token.flags);
+            varint(token.line);
+            varint(token.offset);
+            varint(token.length);
+        }
+
+        void put(const AST::Binding &binding) {
+            // global wraps around to 0
+            varint(binding.depth + 1);
+            varint(binding.isGlobal() ? nameIndex(globals.name(binding.slot)) : binding.slot);
+            if (!binding.isGlobal()) put(static_cast<std::uint8_t>(binding.boxed));
+        }
+
+        void put(Span<AST::pStmt> statements) {
+            varint(static_cast<std::uint32_t>(statements.size()));
+            for (const AST::pStmt &statement: statements) put(statement);
+        }
+
+        void put(const AST::pStmt &pStmt) {
+            put(static_cast<std::uint8_t>(pStmt.index()));
+            std::visit(
+                    [this](auto &&pStmt) {
+                        using T = std::decay_t<decltype(pStmt)>;
+                        if constexpr (std::is_same_v<T, AST::pBlockStmt>) {
+                            varint(pStmt->slots);
+                            put(pStmt->statements);
+                        }
+                        if constexpr (std::is_same_v<T, AST::pExpressionStmt> || std::is_same_v<T, AST::pPrintStmt>) put(pStmt->expression);
+                        if constexpr (std::is_same_v<T, AST::pFunctionStmt>) {
+                            put(pStmt->name);
+                            put(pStmt->binding);
+                            varint(pStmt->slots);
+                            varint(static_cast<std::uint32_t>(pStmt->params.size()));
+                            for (const Name &param: pStmt->params) put(param);
+                            varint(static_cast<std::uint32_t>(pStmt->captures.size()));
+                            for (const AST::Capture &capture: pStmt->captures) {
+                                put(capture.from);
+                                varint(capture.slot);
+                            }
+                            varint(static_cast<std::uint32_t>(pStmt->boxed.size()));
+                            for (const std::uint32_t slot: pStmt->boxed) varint(slot);
+                            put(static_cast<std::uint8_t>(pStmt->lazy != nullptr));
+                            if (pStmt->lazy) {
+                                put(pStmt->lazy->text);
+                                varint(pStmt->lazy->line);
+                                put(static_cast<std::uint8_t>(pStmt->lazy->optimize));
+                                put(static_cast<std::uint8_t>(pStmt->lazy->eliminateSubexpressions));
+                            } else {
+                                put(pStmt->body);
+                            }
+                        }
+                        if constexpr (std::is_same_v<T, AST::pIfStmt>) {
+                            put(pStmt->condition);
+                            put(pStmt->thenBranch);
+                            put(pStmt->elseBranch);
+                        }
+                        if constexpr (std::is_same_v<T, AST::pReturnStmt>) {
+                            put(pStmt->keyword);
+                            put(pStmt->value);
+                        }
+                        if constexpr (std::is_same_v<T, AST::pVarStmt>) {
+                            put(pStmt->name);
+                            put(pStmt->binding);
+                            put(pStmt->initializer);
+                        }
+                        if constexpr (std::is_same_v<T, AST::pWhileStmt>) {
+                            put(pStmt->condition);
+                            put(pStmt->body);
+                        }
+                    },
+                    pStmt);
+        }
+
+        void put(const AST::pExpr &pExpr) {
+            put(static_cast<std::uint8_t>(pExpr.index()));
+            std::visit(
+                    [this](auto &&pExpr) {
+                        using T = std::decay_t<decltype(pExpr)>;
+                        if constexpr (std::is_same_v<T, AST::pAssignExpr>) {
+                            put(pExpr->name);
+                            put(pExpr->binding);
+                            put(pExpr->value);
+                        }
+                        if constexpr (std::is_same_v<T, AST::pBinaryExpr> || std::is_same_v<T, AST::pLogicalExpr>) {
+                            put(pExpr->left);
+                            put(pExpr->op);
+                            put(pExpr->right);
+                        }
+                        if constexpr (std::is_same_v<T, AST::pCallExpr>) {
+                            put(pExpr->callee);
+                            put(pExpr->paren);
+                            varint(static_cast<std::uint32_t>(pExpr->arguments.size()));
+                            for (const AST::pExpr &argument: pExpr->arguments) put(argument);
+                        }
+                        if constexpr (std::is_same_v<T, AST::pGroupingExpr>) put(pExpr->expression);
+                        if constexpr (std::is_same_v<T, AST::pLiteralExpr>) {
+                            put(static_cast<std::uint8_t>(pExpr->value.index()));
+                            std::visit(
+                                    overloaded{
+                                            [](std::monostate) {},
+                                            [this](std::string_view value) { put(value); },
+                                            [this](double value) { put(value); },
+                                            [this](bool value) { put(static_cast<std::uint8_t>(value)); }},
+                                    pExpr->value);
+                            put(static_cast<std::uint8_t>(pExpr->exactInteger));
+                        }
+                        if constexpr (std::is_same_v<T, AST::pUnaryExpr>) {
+                            put(pExpr->op);
+                            put(pExpr->right);
+                        }
+                        if constexpr (std::is_same_v<T, AST::pVariableExpr>) {
+                            put(pExpr->name);
+                            put(pExpr->binding);
+                        }
+                    },
+                    pExpr);
+        }
+
+    private:
+        const Globals &globals;
+        std::unordered_map<Symbol, std::uint32_t> indices;
+
+        std::uint32_t nameIndex(Symbol symbol) {
+            const auto [index, added] = indices.try_emplace(symbol, static_cast<std::uint32_t>(names.size()));
+            if (added) names.push_back(symbol);
+            return index->second;
+        }
+    };
+
+    // thrown when the file ends early, holds a tag no Writer writes or refers
+    // to a slot outside the Environments the program makes
+    struct Malformed : std::exception {};
+
+    // what a slot of an Environment holds, once its variable is declared
+    enum class Holds : std::uint8_t { Nothing, Value, Box };
+
+    class Reader {
+    public:
+        Reader(std::string_view bytes, Arena &arena, Globals &globals)
+            : next(bytes.data()), end(bytes.data() + bytes.size()), arena(arena), globals(globals) {}
+
+        std::vector<Symbol> symbols;
+
+        template<typename T>
+        T get() {
+            static_assert(std::is_trivially_copyable_v<T>);
+            if (static_cast<std::size_t>(end - next) < sizeof(T)) throw Malformed{};
+            T value;
+            std::memcpy(&value, next, sizeof(T));
+            next += sizeof(T);
+            return value;
+        }
+
+        std::uint32_t varint() {
+            std::uint32_t value = 0;
+            for (int shift = 0; shift < 35; shift += 7) {
+                const auto byte = get<std::uint8_t>();
+                value |= static_cast<std::uint32_t>(byte & 0x7f) << shift;
+                if (!(byte & 0x80)) return value;
+            }
+            throw Malformed{};
+        }
+
+        // a number of things still to read, each of which takes a byte at least,
+        // so it can't ask for more than the file holds
+        std::uint32_t count() {
+            const std::uint32_t count = varint();
+            if (count > static_cast<std::size_t>(end - next)) throw Malformed{};
+            return count;
+        }
+
+        bool atEnd() const { return next == end; }
+
+        std::string_view text() {
+            const auto length = varint();
+            if (static_cast<std::size_t>(end - next) < length) throw Malformed{};
+            const std::string_view text(next, length);
+            next += length;
+            return text;
+        }
+
+        Symbol symbol() {
+            const auto index = varint();
+            if (index >= symbols.size()) throw Malformed{};
+            return symbols[index];
+        }
+
+        Name name() {
+            const Symbol symbol = this->symbol();
+            return {symbol, static_cast<int>(varint())};
+        }
+
+        Token token() {
+            const auto type = get<TokenType>();
+            const auto flags = get<std::uint8_t>();
+            const std::uint32_t line = varint();
+            const std::uint32_t offset = varint();
+            return {type, offset, varint(), line, flags};
+        }
+
+        AST::Binding binding() {
+            AST::Binding binding;
+            binding.depth = varint() - 1;
+            binding.slot = binding.isGlobal() ? globals.slot(symbol()) : varint();
+            if (binding.isGlobal()) return binding;
+            // a local is in one of the Environments around it
+            if (binding.depth >= scopes.size() || binding.slot >= scopes[scopes.size() - 1 - binding.depth].size()) throw Malformed{};
+            binding.boxed = get<std::uint8_t>() != 0;
+            return binding;
+        }
+
+        // a variable that is read or assigned has been declared, and is reached through its Box if it has one
+        AST::Binding use() {
+            const AST::Binding binding = this->binding();
+            if (!binding.isGlobal() && slot(binding) != (binding.boxed ? Holds::Box : Holds::Value)) throw Malformed{};
+            return binding;
+        }
+
+        void declare(const AST::Binding &binding) {
+            if (binding.isGlobal()) return;
+            Holds &holds = slot(binding);
+            if (holds != Holds::Nothing) throw Malformed{};
+            holds = binding.boxed ? Holds::Box : Holds::Value;
+        }
+
+        Span<AST::pStmt> statements() {
+            std::vector<AST::pStmt> statements(count());
+            for (AST::pStmt &statement: statements) statement = stmt();
+            return arena.copy(statements);
+        }
+
+        AST::pStmt stmt() {
+            using AST::pStmt;
+            const auto kind = get<std::uint8_t>();
+            if (kind == tag<pStmt, std::nullptr_t>) return nullptr;
+            if (kind == tag<pStmt, AST::pBlockStmt>) {
+                // every slot is declared by something that follows
+                const std::uint32_t slots = count();
+                scopes.emplace_back(slots, Holds::Nothing);
+                AST::BlockStmt *block = arena.make<AST::BlockStmt>(statements());
+                scopes.pop_back();
+                block->slots = slots;
+                return block;
+            }
+            if (kind == tag<pStmt, AST::pExpressionStmt>) return arena.make<AST::ExprStmt>(expr());
+            if (kind == tag<pStmt, AST::pFunctionStmt>) {
+                const Name name = this->name();
+                const AST::Binding binding = this->binding();
+                // defined before the closure is made, see Interpreter::evalFunctionStmt
+                declare(binding);
+                const std::uint32_t slots = count();
+                std::vector<Holds> body(slots, Holds::Nothing);
+                std::vector<Name> params(count());
+                for (Name &param: params) param = this->name();
+                const Span<Name> paramSpan = arena.copy(params);
+                // a lazy body has no slots until it is parsed
+                std::fill_n(body.begin(), std::min<std::size_t>(params.size(), slots), Holds::Value);
+                std::vector<AST::Capture> captures(count());
+                for (AST::Capture &capture: captures) {
+                    // the closure copies what the slot holds, the Box of a boxed variable included
+                    capture.from = this->binding();
+                    capture.slot = varint();
+                    if (capture.from.isGlobal() || slot(capture.from) == Holds::Nothing || capture.slot >= slots ||
+                        body[capture.slot] != Holds::Nothing)
+                        throw Malformed{};
+                    body[capture.slot] = slot(capture.from);
+                }
+                // only parameters get their Box when the function is called
+                std::vector<std::uint32_t> boxed(count());
+                for (std::uint32_t &slot: boxed) {
+                    if ((slot = varint()) >= std::min<std::size_t>(params.size(), slots)) throw Malformed{};
+                    body[slot] = Holds::Box;
+                }
+                AST::FuncStmt *function;
+                if (get<std::uint8_t>()) {
+                    const std::string_view text = this->text();
+                    const std::uint32_t line = varint();
+                    function = arena.make<AST::FuncStmt>(name, paramSpan, Span<AST::pStmt>());
+                    const bool optimize = get<std::uint8_t>() != 0;
+                    function->lazy = arena.make<AST::LazyBody>(AST::LazyBody{text, line, &arena, optimize, get<std::uint8_t>() != 0});
+                } else {
+                    // the parameters take the first slots
+                    if (params.size() > slots) throw Malformed{};
+                    // the body's Environment encloses nothing, see Function::call
+                    std::vector<std::vector<Holds>> enclosing = std::exchange(scopes, {std::move(body)});
+                    function = arena.make<AST::FuncStmt>(name, paramSpan, statements());
+                    scopes = std::move(enclosing);
+                }
+                function->binding = binding;
+                function->slots = slots;
+                function->captures = arena.copy(captures);
+                function->boxed = arena.copy(boxed);
+                return function;
+            }
+            if (kind == tag<pStmt, AST::pIfStmt>) {
+                const AST::pExpr condition = expr();
+                const AST::pStmt thenBranch = branch();
+                return arena.make<AST::IfStmt>(condition, thenBranch, branch());
+            }
+            if (kind == tag<pStmt, AST::pPrintStmt>) return arena.make<AST::PrintStmt>(expr());
+            if (kind == tag<pStmt, AST::pReturnStmt>) {
+                const Token keyword = token();
+                return arena.make<AST::ReturnStmt>(keyword, expr());
+            }
+            if (kind == tag<pStmt, AST::pVarStmt>) {
+                const Name name = this->name();
+                const AST::Binding binding = this->binding();
+                AST::VarStmt *var = arena.make<AST::VarStmt>(name, expr());
+                // the initializer runs before the variable is there
+                declare(binding);
+                var->binding = binding;
+                return var;
+            }
+            if (kind == tag<pStmt, AST::pWhileStmt>) {
+                const AST::pExpr condition = expr();
+                return arena.make<AST::WhileStmt>(condition, branch());
+            }
+            throw Malformed{};
+        }
+
+        AST::pExpr expr() {
+            using AST::pExpr;
+            const auto kind = get<std::uint8_t>();
+            if (kind == tag<pExpr, std::nullptr_t>) return nullptr;
+            if (kind == tag<pExpr, AST::pAssignExpr>) {
+                const Name name = this->name();
+                const AST::Binding binding = use();
+                AST::AssignExpr *assign = arena.make<AST::AssignExpr>(name, expr());
+                assign->binding = binding;
+                return assign;
+            }
+            if (kind == tag<pExpr, AST::pBinaryExpr> || kind == tag<pExpr, AST::pLogicalExpr>) {
+                const AST::pExpr left = expr();
+                const Token op = token();
+                const AST::pExpr right = expr();
+                if (kind == tag<pExpr, AST::pBinaryExpr>) return arena.make<AST::BinaryExpr>(left, op, right);
+                return arena.make<AST::LogicalExpr>(left, op, right);
+            }
+            if (kind == tag<pExpr, AST::pCallExpr>) {
+                const AST::pExpr callee = expr();
+                const Token paren = token();
+                std::vector<AST::pExpr> arguments(count());
+                for (AST::pExpr &argument: arguments) argument = expr();
+                return arena.make<AST::CallExpr>(callee, paren, arena.copy(arguments));
+            }
+            if (kind == tag<pExpr, AST::pGroupingExpr>) return arena.make<AST::GroupingExpr>(expr());
+            if (kind == tag<pExpr, AST::pLiteralExpr>) {
+                const AST::Literal value = literal();
+                return arena.make<AST::LiteralExpr>(value, get<std::uint8_t>() != 0);
+            }
+            if (kind == tag<pExpr, AST::pUnaryExpr>) {
+                const Token op = token();
+                return arena.make<AST::UnaryExpr>(op, expr());
+            }
+            if (kind == tag<pExpr, AST::pVariableExpr>) {
+                const Name name = this->name();
+                AST::VariableExpr *variable = arena.make<AST::VariableExpr>(name);
+                variable->binding = use();
+                return variable;
+            }
+            throw Malformed{};
+        }
+
+    private:
+        const char *next;
+        const char *const end;
+        Arena &arena;
+        Globals &globals;
+        // the slots of the Environments around what is read, innermost last
+        std::vector<std::vector<Holds>> scopes;
+
+        Holds &slot(const AST::Binding &binding) { return scopes[scopes.size() - 1 - binding.depth][binding.slot]; }
+
+        // the branch of an if or the body of a while, which is never a declaration:
+        // one that runs or not would leave the slot's content unknown
+        AST::pStmt branch() {
+            const AST::pStmt statement = stmt();
+            if (std::holds_alternative<AST::pVarStmt>(statement) || std::holds_alternative<AST::pFunctionStmt>(statement)) throw Malformed{};
+            return statement;
+        }
+
+        AST::Literal literal() {
+            switch (get<std::uint8_t>()) {
+                case tag<AST::Literal, std::monostate>:
+                    return std::monostate{};
+                case tag<AST::Literal, std::string_view>:
+                    return text();
+                case tag<AST::Literal, double>:
+                    return get<double>();
+                case tag<AST::Literal, bool>:
+                    return get<std::uint8_t>() != 0;
+                default:
+                    throw Malformed{};
+            }
+        }
+    };
+
+}// namespace
+
+cpplox::Cache::Cache(const std::string &script, std::string_view source, const Runner::Options &options)
+    : sourceHash(contentHash(source)), sourceSize(source.size()),
+      compiledWith((options.optimize ? optimized : 0) | (options.lazyBodies ? lazyBodies : 0) |
+                   (options.eliminateSubexpressions ? subexpressions : 0)) {
+    const std::string &directory = options.cacheDirectory;
+    if (!directory.empty()) {
+        char name[17];
+        std::snprintf(name, sizeof(name), "%016llx", static_cast<unsigned long long>(sourceHash));
+        file = directory + "/" + name + ".loxc";
+    } else if (script.size() > 4 && script.compare(script.size() - 4, 4, ".lox") == 0) {
+        file = script + "c";
+    } else {
+        file = script + ".loxc";
+    }
+}
+
+auto cpplox::Cache::load(Arena &arena, Globals &globals) -> std::optional<std::vector<AST::pStmt>> {
+    if (access(file.c_str(), R_OK) != 0) {
+        counters.misses++;
+        return std::nullopt;
+    }
+    try {
+        const std::string_view bytes = SourceBuffer::load(file).view();
+        const Header expected = header(sourceHash, sourceSize, compiledWith);
+        Header found{};
+        if (bytes.size() < sizeof(Header)) throw Malformed{};
+        std::memcpy(&found, bytes.data(), sizeof(Header));
+        if (std::memcmp(found.magic, expected.magic, sizeof(expected.magic)) != 0 || found.format != expected.format ||
+            std::memcmp(found.version, expected.version, sizeof(expected.version)) != 0 || found.sourceHash != expected.sourceHash ||
+            found.sourceSize != expected.sourceSize || found.compiledWith != expected.compiledWith)
+            throw Malformed{};
+
+        const std::string_view payload = bytes.substr(sizeof(Header));
+        if (contentHash(payload) != found.payloadHash || found.names > payload.size()) throw Malformed{};
+
+        Reader reader(payload, arena, globals);
+        reader.symbols.reserve(found.names);
+        for (std::uint32_t i = 0; i < found.names; i++) reader.symbols.push_back(intern(reader.text()));
+        std::vector<AST::pStmt> program(reader.count());
+        for (AST::pStmt &statement: program) statement = reader.stmt();
+        if (!reader.atEnd()) throw Malformed{};
+
+        counters.hits++;
+        counters.bytesRead += bytes.size();
+        return program;
+    } catch (const std::exception &) {
+        // unreadable, stale or from another version: compiled again and overwritten
+    }
+    counters.misses++;
+    return std::nullopt;
+}
+
+void cpplox::Cache::store(const std::vector<AST::pStmt> &program, const Globals &globals) {
+    Writer body(globals);
+    body.varint(static_cast<std::uint32_t>(program.size()));
+    for (const AST::pStmt &statement: program) body.put(statement);
+
+    Writer names(globals);
+    for (const Symbol symbol: body.names) names.put(SymbolTable::global().name(symbol));
+    const std::string payload = names.bytes + body.bytes;
+    Header out = header(sourceHash, sourceSize, compiledWith);
+    out.names = static_cast<std::uint32_t>(body.names.size());
+    out.payloadHash = contentHash(payload);
+
+    const std::string temporary = file + ".tmp" + std::to_string(getpid());
+    {
+        std::ofstream stream(temporary, std::ios::binary | std::ios::trunc);
+        stream.write(reinterpret_cast<const char *>(&out), sizeof(out));
+        stream.write(payload.data(), static_cast<std::streamsize>(payload.size()));
+        if (stream.close(), !stream || std::rename(temporary.c_str(), file.c_str()) != 0) {
+            std::remove(temporary.c_str());
+            counters.writeFailures++;
+            return;
+        }
+    }
+    counters.bytesWritten += sizeof(out) + payload.size();
+}
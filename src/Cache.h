@@ -0,0 +1,58 @@
+#ifndef CPPLOX_CACHE_H
+#define CPPLOX_CACHE_H
+
+#include "Arena.h"
+#include "Environment.h"
+#include "Runner.h"
+#include "Stmt.h"
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace cpplox {
+
+    // Compiled scripts on disk. The parsed, optimized and resolved program is
+    // kept in a .loxc file, keyed by a hash of the source and the interpreter
+    // version, so an unchanged script skips scanning, parsing and both passes.
+    // A .loxc sits next to its script (script.lox -> script.loxc), or inside a
+    // cache directory, named after the hash of the source.
+    class Cache {
+    public:
+        struct Stats {
+            std::size_t hits = 0;
+            std::size_t misses = 0;
+            // e.g. the script's directory is read-only
+            std::size_t writeFailures = 0;
+            std::size_t bytesRead = 0;
+            std::size_t bytesWritten = 0;
+        };
+
+        // a .loxc is only used by runs with the same Optimizer and lazy body options
+        Cache(const std::string &script, std::string_view source, const Runner::Options &options);
+
+        // The cached program with its nodes in arena, or nothing when there is
+        // no .loxc or it is stale or from another version. String literals view
+        // into the mapped file, which is kept until exit like a SourceBuffer.
+        std::optional<std::vector<AST::pStmt>> load(Arena &arena, Globals &globals);
+        // written to a temporary file and renamed, so a concurrent run never reads half of it
+        void store(const std::vector<AST::pStmt> &program, const Globals &globals);
+
+        const std::string &path() const { return file; }
+        static const Stats &stats() { return counters; }
+
+    private:
+        std::string file;
+        std::uint64_t sourceHash;
+        std::uint64_t sourceSize;
+        // the options that change what is compiled, as bits
+        std::uint32_t compiledWith;
+
+        static Stats counters;
+    };
+
+}// namespace cpplox
+
+#endif// CPPLOX_CACHE_H
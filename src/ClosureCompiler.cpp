@@ -0,0 +1,369 @@
+#include "ClosureCompiler.h"
+
+#include <algorithm>
+#include <iostream>
+#include <type_traits>
+#include <typeinfo>
+#include <utility>
+#include <variant>
+
+namespace {
+
+    using namespace cpplox;
+
+    // whether evaluating the expression may run a call, and so collect
+    bool calls(const AST::pExpr &pExpr) {
+        return std::visit(
+                [](auto &&pExpr) -> bool {
+                    using T = std::decay_t<decltype(pExpr)>;
+                    if constexpr (std::is_same_v<T, AST::pAssignExpr>) return calls(pExpr->value);
+                    if constexpr (std::is_same_v<T, AST::pBinaryExpr> || std::is_same_v<T, AST::pLogicalExpr>)
+                        return calls(pExpr->left) || calls(pExpr->right);
+                    if constexpr (std::is_same_v<T, AST::pCallExpr>) return true;
+                    if constexpr (std::is_same_v<T, AST::pGroupingExpr>) return calls(pExpr->expression);
+                    if constexpr (std::is_same_v<T, AST::pUnaryExpr>) return calls(pExpr->right);
+                    return false;
+                },
+                pExpr);
+    }
+
+    // the closure of an arithmetic or comparison operator, with the fast path
+    // for two numbers inline and the rest left to Interpreter::binary
+    template<typename Operator>
+    closure::Expr numbers(closure::Expr left, closure::Expr right, TokenType op, std::uint32_t line) {
+        return [left = std::move(left), right = std::move(right), op, line](Value *slots) -> Value {
+            const Value a = left(slots);
+            const Value b = right(slots);
+            if (a.isNumber() && b.isNumber()) return Operator()(a.asNumber(), b.asNumber());
+            return Interpreter::binary(op, a, b, line);
+        };
+    }
+
+    // statements run one after the other until one returns
+    closure::Stmt sequence(std::vector<closure::Stmt> code) {
+        return [code = std::move(code)](Value *slots) -> Completion {
+            for (const closure::Stmt &statement: code)
+                if (Completion completion = statement(slots); completion.returned) return completion;
+            return {};
+        };
+    }
+
+}// namespace
+
+cpplox::Value cpplox::closure::Function::call(Interpreter &, const std::vector<Value> &arguments) {
+    return runtime.call(*this, arguments.data());
+}
+
+cpplox::closure::Runtime::Runtime(Interpreter &interpreter) : interpreter(interpreter) { Heap::global().addRoots(this); }
+
+cpplox::closure::Runtime::~Runtime() { Heap::global().removeRoots(this); }
+
+void cpplox::closure::Runtime::markRoots(Heap &heap) {
+    for (const Frame *frame = frames; frame; frame = frame->caller)
+        for (std::uint32_t i = 0; i < frame->size; i++) heap.mark(frame->slots[i]);
+    for (const Value constant: constants) heap.mark(constant);
+}
+
+void cpplox::closure::Runtime::interpret(const std::vector<AST::pStmt> &program) {
+    try {
+        Body script;
+        Compiler(*this, script).compile(program);
+        std::vector<Value> slots(script.frameSize);
+        run(script, slots.data());
+    } catch (const InterpretErr &error) {
+        Errors::hadRuntimeError = true;
+        logger::error(error);
+    }
+}
+
+cpplox::Completion cpplox::closure::Runtime::run(const Body &body, Value *slots) {
+    Frame frame{slots, body.frameSize, frames};
+    frames = &frame;
+    try {
+        const Completion completion = body.code(slots);
+        frames = frame.caller;
+        return completion;
+    } catch (...) {
+        frames = frame.caller;
+        throw;
+    }
+}
+
+const cpplox::closure::Body &cpplox::closure::Runtime::body(Function &function) {
+    std::unique_ptr<Body> &body = bodies[function.declaration];
+    if (!body) {
+        const AST::pFunctionStmt declaration = function.declaration;
+        if (declaration->lazy) interpreter.parseBody(*declaration);
+        auto compiled = std::make_unique<Body>();
+        Compiler(*this, *compiled).compile(declaration->body, declaration->slots);
+        body = std::move(compiled);
+    }
+    function.body = body.get();
+    return *body;
+}
+
+cpplox::Value cpplox::closure::Runtime::call(const Value *values, std::uint32_t count, std::uint32_t line) {
+    // the callee and the arguments sit in the caller's frame, where the Heap sees them
+    if (Heap::global().wantsCollection()) Heap::global().collect();
+    Callable *callable = Interpreter::checkCall(values[0], count, line);
+    if (typeid(*callable) == typeid(Function)) return call(*static_cast<Function *>(callable), values + 1);
+    return callable->call(interpreter, std::vector<Value>(values + 1, values + 1 + count));
+}
+
+cpplox::Value cpplox::closure::Runtime::call(Function &function, const Value *arguments) {
+    const Body &body = function.body ? *function.body : this->body(function);
+    // most frames fit on the native stack, the others go to the free store
+    Value inline_[16];
+    std::unique_ptr<Value[]> spilled;
+    Value *slots = inline_;
+    if (body.frameSize > std::size(inline_)) slots = (spilled = std::make_unique<Value[]>(body.frameSize)).get();
+    // the Resolver gives the parameters the first slots, and the captures slots of their own
+    std::copy(arguments, arguments + function.arity(), slots);
+    const AST::pFunctionStmt declaration = function.declaration;
+    for (std::size_t i = 0; i < function.captures.size(); i++) slots[declaration->captures[i].slot] = function.captures[i];
+    for (const std::uint32_t slot: declaration->boxed) slots[slot] = Heap::global().make<Box>(slots[slot]);
+    return run(body, slots).value;
+}
+
+void cpplox::closure::Compiler::compile(const std::vector<AST::pStmt> &statements) {
+    std::vector<Stmt> code;
+    for (const AST::pStmt &statement: statements) code.push_back(compile(statement));
+    body.code = sequence(std::move(code));
+}
+
+void cpplox::closure::Compiler::compile(Span<AST::pStmt> statements, std::uint32_t slots) {
+    // the Resolver gives the parameters the first slots of the body's scope
+    scopes.push_back(0);
+    slotsUsed = slots;
+    body.frameSize = slots;
+    std::vector<Stmt> code;
+    for (const AST::pStmt &statement: statements) code.push_back(compile(statement));
+    body.code = sequence(std::move(code));
+}
+
+cpplox::closure::Stmt cpplox::closure::Compiler::block(Span<AST::pStmt> statements, std::uint32_t slots) {
+    scopes.push_back(slotsUsed);
+    slotsUsed += slots;
+    body.frameSize = std::max(body.frameSize, slotsUsed);
+    std::vector<Stmt> code;
+    for (const AST::pStmt &statement: statements) code.push_back(compile(statement));
+    slotsUsed -= slots;
+    scopes.pop_back();
+    return sequence(std::move(code));
+}
+
+cpplox::closure::Stmt cpplox::closure::Compiler::compile(const AST::pStmt &pStmt) {
+    return std::visit(
+            [this](auto &&pStmt) -> Stmt {
+                using T = std::decay_t<decltype(pStmt)>;
+                if constexpr (std::is_same_v<T, AST::pBlockStmt>) return block(pStmt->statements, pStmt->slots);
+                if constexpr (std::is_same_v<T, AST::pExpressionStmt>) {
+                    return [expression = compile(pStmt->expression)](Value *slots) {
+                        expression(slots);
+                        return Completion{};
+                    };
+                }
+                if constexpr (std::is_same_v<T, AST::pFunctionStmt>) {
+                    std::vector<std::uint32_t> from;
+                    for (const AST::Capture &capture: pStmt->captures) from.push_back(local(capture.from));
+                    Expr function = [&runtime = this->runtime, declaration = pStmt, from = std::move(from)](Value *slots) -> Value {
+                        std::vector<Value> captures;
+                        captures.reserve(from.size());
+                        for (const std::uint32_t slot: from) captures.push_back(slots[slot]);
+                        return Heap::global().make<Function>(runtime, declaration, std::move(captures));
+                    };
+                    if (!pStmt->binding.boxed) return define(pStmt->binding, std::move(function));
+                    // a function that calls itself captures its own Box, so that comes first
+                    return [box = define(pStmt->binding, [](Value *) { return Value{}; }),
+                            assign = set(pStmt->binding, pStmt->name.line, std::move(function))](Value *slots) {
+                        box(slots);
+                        assign(slots);
+                        return Completion{};
+                    };
+                }
+                if constexpr (std::is_same_v<T, AST::pIfStmt>) {
+                    Expr condition = compile(pStmt->condition);
+                    Stmt thenBranch = compile(pStmt->thenBranch);
+                    if (std::holds_alternative<std::nullptr_t>(pStmt->elseBranch))
+                        return [condition = std::move(condition), thenBranch = std::move(thenBranch)](Value *slots) {
+                            if (condition(slots).isTruthy()) return thenBranch(slots);
+                            return Completion{};
+                        };
+                    return [condition = std::move(condition), thenBranch = std::move(thenBranch),
+                            elseBranch = compile(pStmt->elseBranch)](Value *slots) {
+                        if (condition(slots).isTruthy()) return thenBranch(slots);
+                        return elseBranch(slots);
+                    };
+                }
+                if constexpr (std::is_same_v<T, AST::pPrintStmt>) {
+                    return [expression = compile(pStmt->expression)](Value *slots) {
+                        std::cout << expression(slots) << std::endl;
+                        return Completion{};
+                    };
+                }
+                if constexpr (std::is_same_v<T, AST::pReturnStmt>) {
+                    if (std::holds_alternative<std::nullptr_t>(pStmt->value)) return [](Value *) { return Completion{true, Value{}}; };
+                    return [value = compile(pStmt->value)](Value *slots) { return Completion{true, value(slots)}; };
+                }
+                if constexpr (std::is_same_v<T, AST::pVarStmt>) {
+                    if (std::holds_alternative<std::nullptr_t>(pStmt->initializer))
+                        return define(pStmt->binding, [](Value *) { return Value{}; });
+                    return define(pStmt->binding, compile(pStmt->initializer));
+                }
+                if constexpr (std::is_same_v<T, AST::pWhileStmt>) {
+                    return [condition = compile(pStmt->condition), body = compile(pStmt->body)](Value *slots) {
+                        while (condition(slots).isTruthy()) {
+                            if (Completion completion = body(slots); completion.returned) return completion;
+                            // a loop that allocates would never reach a call otherwise
+                            if (Heap::global().wantsCollection()) Heap::global().collect();
+                        }
+                        return Completion{};
+                    };
+                }
+                // statements that failed to parse
+                return [](Value *) { return Completion{}; };
+            },
+            pStmt);
+}
+
+cpplox::closure::Expr cpplox::closure::Compiler::compile(const AST::pExpr &pExpr) {
+    return std::visit(
+            [this](auto &&pExpr) -> Expr {
+                using T = std::decay_t<decltype(pExpr)>;
+                if constexpr (std::is_same_v<T, AST::pAssignExpr>) return set(pExpr->binding, pExpr->name.line, compile(pExpr->value));
+                if constexpr (std::is_same_v<T, AST::pBinaryExpr>) return binary(pExpr);
+                if constexpr (std::is_same_v<T, AST::pCallExpr>) return call(pExpr);
+                if constexpr (std::is_same_v<T, AST::pGroupingExpr>) return compile(pExpr->expression);
+                if constexpr (std::is_same_v<T, AST::pLiteralExpr>) {
+                    // a string literal is made once, and kept for as long as the Runtime
+                    const Value value = AST::toValue(pExpr->value);
+                    if (value.isObject()) runtime.constants.push_back(value);
+                    return [value](Value *) { return value; };
+                }
+                if constexpr (std::is_same_v<T, AST::pLogicalExpr>) {
+                    if (pExpr->op.type == TokenType::OR)
+                        return [left = compile(pExpr->left), right = compile(pExpr->right)](Value *slots) {
+                            const Value value = left(slots);
+                            return value.isTruthy() ? value : right(slots);
+                        };
+                    return [left = compile(pExpr->left), right = compile(pExpr->right)](Value *slots) {
+                        const Value value = left(slots);
+                        return value.isTruthy() ? right(slots) : value;
+                    };
+                }
+                if constexpr (std::is_same_v<T, AST::pUnaryExpr>) {
+                    if (pExpr->op.type == TokenType::BANG)
+                        return [right = compile(pExpr->right)](Value *slots) { return Value(!right(slots).isTruthy()); };
+                    return [right = compile(pExpr->right), line = pExpr->op.line](Value *slots) {
+                        const Value value = right(slots);
+                        if (value.isNumber()) return Value(-value.asNumber());
+                        return Interpreter::unary(TokenType::MINUS, value, line);
+                    };
+                }
+                if constexpr (std::is_same_v<T, AST::pVariableExpr>) return get(pExpr->binding, pExpr->name.line);
+                return [](Value *) { return Value{}; };
+            },
+            pExpr);
+}
+
+cpplox::closure::Expr cpplox::closure::Compiler::binary(const AST::pBinaryExpr &pExpr) {
+    Expr left = compile(pExpr->left);
+    // the left operand waits in the frame if the right one may collect
+    if (calls(pExpr->right)) {
+        const std::uint32_t slot = temporary();
+        left = [left = std::move(left), slot](Value *slots) { return slots[slot] = left(slots); };
+    }
+    Expr right = compile(pExpr->right);
+    if (calls(pExpr->right)) release(1);
+    const TokenType op = pExpr->op.type;
+    const std::uint32_t line = pExpr->op.line;
+    switch (op) {
+        case TokenType::EQUAL_EQUAL:
+            return [left = std::move(left), right = std::move(right)](Value *slots) {
+                const Value a = left(slots);
+                return Value(a == right(slots));
+            };
+        case TokenType::BANG_EQUAL:
+            return [left = std::move(left), right = std::move(right)](Value *slots) {
+                const Value a = left(slots);
+                return Value(a != right(slots));
+            };
+        case TokenType::GREATER:
+            return numbers<std::greater<>>(std::move(left), std::move(right), op, line);
+        case TokenType::GREATER_EQUAL:
+            return numbers<std::greater_equal<>>(std::move(left), std::move(right), op, line);
+        case TokenType::LESS:
+            return numbers<std::less<>>(std::move(left), std::move(right), op, line);
+        case TokenType::LESS_EQUAL:
+            return numbers<std::less_equal<>>(std::move(left), std::move(right), op, line);
+        case TokenType::MINUS:
+            return numbers<std::minus<>>(std::move(left), std::move(right), op, line);
+        case TokenType::SLASH:
+            return numbers<std::divides<>>(std::move(left), std::move(right), op, line);
+        case TokenType::STAR:
+            return numbers<std::multiplies<>>(std::move(left), std::move(right), op, line);
+        default:
+            return numbers<std::plus<>>(std::move(left), std::move(right), op, line);
+    }
+}
+
+cpplox::closure::Expr cpplox::closure::Compiler::call(const AST::pCallExpr &pExpr) {
+    // the callee and the arguments go to consecutive temporaries, which the call reads in place
+    const std::uint32_t base = temporary();
+    std::vector<Expr> operands{compile(pExpr->callee)};
+    for (const AST::pExpr &argument: pExpr->arguments) {
+        temporary();
+        operands.push_back(compile(argument));
+    }
+    release(static_cast<std::uint32_t>(operands.size()));
+    const auto count = static_cast<std::uint32_t>(pExpr->arguments.size());
+    return [&runtime = this->runtime, operands = std::move(operands), base, count, line = pExpr->paren.line](Value *slots) {
+        Value *values = slots + base;
+        for (std::size_t i = 0; i < operands.size(); i++) values[i] = operands[i](slots);
+        return runtime.call(values, count, line);
+    };
+}
+
+std::uint32_t cpplox::closure::Compiler::local(const AST::Binding &binding) const { return scopes[scopes.size() - 1 - binding.depth] + binding.slot; }
+
+cpplox::closure::Expr cpplox::closure::Compiler::get(const AST::Binding &binding, int line) {
+    if (binding.isGlobal())
+        return [&globals = runtime.interpreter.globals, slot = binding.slot, line](Value *) { return globals.get(slot, line); };
+    if (binding.boxed) return [slot = local(binding)](Value *slots) { return slots[slot].asBox()->value; };
+    return [slot = local(binding)](Value *slots) { return slots[slot]; };
+}
+
+cpplox::closure::Expr cpplox::closure::Compiler::set(const AST::Binding &binding, int line, Expr value) {
+    if (binding.isGlobal())
+        return [&globals = runtime.interpreter.globals, slot = binding.slot, line, value = std::move(value)](Value *slots) {
+            const Value result = value(slots);
+            globals.assign(slot, line, result);
+            return result;
+        };
+    if (binding.boxed)
+        return [slot = local(binding), value = std::move(value)](Value *slots) { return slots[slot].asBox()->value = value(slots); };
+    return [slot = local(binding), value = std::move(value)](Value *slots) { return slots[slot] = value(slots); };
+}
+
+cpplox::closure::Stmt cpplox::closure::Compiler::define(const AST::Binding &binding, Expr value) {
+    if (binding.isGlobal())
+        return [&globals = runtime.interpreter.globals, slot = binding.slot, value = std::move(value)](Value *slots) {
+            globals.define(slot, value(slots));
+            return Completion{};
+        };
+    if (binding.boxed)
+        return [slot = local(binding), value = std::move(value)](Value *slots) {
+            slots[slot] = Heap::global().make<Box>(value(slots));
+            return Completion{};
+        };
+    return [slot = local(binding), value = std::move(value)](Value *slots) {
+        slots[slot] = value(slots);
+        return Completion{};
+    };
+}
+
+std::uint32_t cpplox::closure::Compiler::temporary() {
+    const std::uint32_t slot = slotsUsed + temporaries++;
+    body.frameSize = std::max(body.frameSize, slot + 1);
+    return slot;
+}
@@ -0,0 +1,136 @@
+#ifndef CPPLOX_CLOSURECOMPILER_H
+#define CPPLOX_CLOSURECOMPILER_H
+
+#include "Heap.h"
+#include "Interpreter.h"
+#include "Object.h"
+#include "Stmt.h"
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace cpplox::closure {
+
+    // A node compiled to a C++ closure that calls those of its children
+    // directly: no std::visit on the node kind and no switch on the operator
+    // at run time. Each is handed the slots of the running frame; a statement
+    // hands back how it finished, as the tree walk's do.
+    using Expr = std::function<Value(Value *slots)>;
+    using Stmt = std::function<Completion(Value *slots)>;
+
+    // a function body, or the top level of a script, compiled once
+    struct Body {
+        // the parameters and every local of the nested blocks, then the temporaries
+        std::uint32_t frameSize = 0;
+        Stmt code;
+    };
+
+    class Runtime;
+
+    // a function declared in a program run by a Runtime, with the values it captured
+    class Function : public Callable {
+    public:
+        // the declaration lives in an Arena that is kept until exit, see Runner::run
+        Function(Runtime &runtime, AST::pFunctionStmt declaration, std::vector<Value> captures)
+            : runtime(runtime), declaration(declaration), captures(std::move(captures)) {}
+
+        int arity() override { return static_cast<int>(declaration->params.size()); }
+        Value call(Interpreter &interpreter, const std::vector<Value> &arguments) override;
+        std::string toString() override { return "<fn " + std::string(declaration->name.lexeme()) + ">"; }
+
+        void trace(Heap &heap) const override {
+            for (const Value capture: captures) heap.mark(capture);
+        }
+
+    private:
+        Runtime &runtime;
+        const AST::pFunctionStmt declaration;
+        const std::vector<Value> captures;
+        // null until the first call, see Runtime::body
+        const Body *body = nullptr;
+
+        friend class Runtime;
+    };
+
+    // Runs programs compiled to closures, a function body at a time on its
+    // first call. Every call gets a frame of its own on the native stack; the
+    // running ones are linked together so the Heap can mark them. The globals
+    // and the natives are the Interpreter's, as for the VM.
+    // The Heap collects at calls and at the end of each loop iteration.
+    class Runtime : private Heap::Roots {
+    public:
+        explicit Runtime(Interpreter &interpreter);
+        Runtime(const Runtime &) = delete;
+        Runtime &operator=(const Runtime &) = delete;
+        ~Runtime();
+
+        // the program has to be resolved; its Arena has to outlive the Runtime
+        void interpret(const std::vector<AST::pStmt> &program);
+        // values holds the callee followed by count arguments
+        Value call(const Value *values, std::uint32_t count, std::uint32_t line);
+        Value call(Function &function, const Value *arguments);
+
+    private:
+        // the slots of a running body, innermost first
+        struct Frame {
+            Value *slots;
+            std::uint32_t size;
+            Frame *caller;
+        };
+
+        Interpreter &interpreter;
+        Frame *frames = nullptr;
+        // compiled on the first call of any Function of the declaration
+        std::unordered_map<AST::pFunctionStmt, std::unique_ptr<Body>> bodies;
+        // the string literals of every body compiled so far
+        std::vector<Value> constants;
+
+        const Body &body(Function &function);
+        Completion run(const Body &body, Value *slots);
+        void markRoots(Heap &heap) override;
+
+        friend class Compiler;
+    };
+
+    // Turns the statements of one function body, or of the top level, into
+    // its Body. Like vm::Compiler it gives each block's locals the frame slots
+    // after those of the blocks around it; a temporary goes right above the
+    // locals in scope, and is only kept in the frame when a call may collect
+    // before it is used.
+    class Compiler {
+    public:
+        Compiler(Runtime &runtime, Body &body) : runtime(runtime), body(body) {}
+
+        void compile(Span<AST::pStmt> statements, std::uint32_t slots);
+        void compile(const std::vector<AST::pStmt> &statements);
+
+    private:
+        Runtime &runtime;
+        Body &body;
+        // where the locals of each enclosing block start in the frame, innermost last
+        std::vector<std::uint32_t> scopes;
+        std::uint32_t slotsUsed = 0;
+        std::uint32_t temporaries = 0;
+
+        Stmt compile(const AST::pStmt &pStmt);
+        Expr compile(const AST::pExpr &pExpr);
+        Stmt block(Span<AST::pStmt> statements, std::uint32_t slots);
+        Expr binary(const AST::pBinaryExpr &pExpr);
+        Expr call(const AST::pCallExpr &pExpr);
+
+        // the frame slot of a local binding
+        std::uint32_t local(const AST::Binding &binding) const;
+        Expr get(const AST::Binding &binding, int line);
+        Expr set(const AST::Binding &binding, int line, Expr value);
+        Stmt define(const AST::Binding &binding, Expr value);
+        // a free frame slot for a temporary, until release
+        std::uint32_t temporary();
+        void release(std::uint32_t count) { temporaries -= count; }
+    };
+
+}// namespace cpplox::closure
+
+#endif// CPPLOX_CLOSURECOMPILER_H
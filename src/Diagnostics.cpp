@@ -0,0 +1,18 @@
+#include "Diagnostics.h"
+#include "Errors.h"
+#include "Logger.h"
+#include "Meta.h"
+
+#include <utility>
+
+cpplox::Diagnostics &cpplox::Diagnostics::global() {
+    static Diagnostics diagnostics(true);
+    return diagnostics;
+}
+
+void cpplox::Diagnostics::error(int line, std::string message) {
+    diagnostics.push_back({Meta::sourceFile, line, std::move(message)});
+    if (!log) return;
+    Errors::hadError = true;
+    logger::error(diagnostics.back());
+}
@@ -0,0 +1,46 @@
+#ifndef CPPLOX_DIAGNOSTICS_H
+#define CPPLOX_DIAGNOSTICS_H
+
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace cpplox {
+
+    // a syntax error, kept as plain data rather than thrown
+    struct Diagnostic {
+        std::string source;
+        int line;
+        std::string message;
+
+        friend std::ostream &operator<<(std::ostream &os, const Diagnostic &diagnostic) {
+            os << diagnostic.source << "(" << diagnostic.line << ") : " << diagnostic.message;
+            return os;
+        }
+    };
+
+    // Where the Scanner and the Parser report syntax errors. Reporting one is a
+    // push_back and never unwinds the stack, so a file full of errors scans and
+    // parses about as fast as a clean one.
+    // The global sink logs every error as it comes in and sets Errors::hadError;
+    // other sinks only collect, e.g. for a worker thread of a parallel scan, or
+    // for a caller that checks many files and reports on its own.
+    class Diagnostics {
+    public:
+        static Diagnostics &global();
+        explicit Diagnostics(bool log = false) : log(log) {}
+
+        void error(int line, std::string message);
+
+        const std::vector<Diagnostic> &errors() const { return diagnostics; }
+        bool hadError() const { return !diagnostics.empty(); }
+        void clear() { diagnostics.clear(); }
+
+    private:
+        bool log;
+        std::vector<Diagnostic> diagnostics;
+    };
+
+}// namespace cpplox
+
+#endif// CPPLOX_DIAGNOSTICS_H
@@ -1,30 +1,58 @@
 #include "Environment.h"
 
 #include "Meta.h"
+#include <string>
 #include <utility>
 
-cpplox::Environment::Environment()
-    : enclosing(nullptr) {}
+cpplox::Environment *cpplox::Environment::live = nullptr;
 
-cpplox::Environment::Environment(pEnv enclosing)
-    : enclosing(std::move(enclosing)) {}
+cpplox::Environment::Environment(pEnv enclosing, std::size_t slots)
+    : enclosing(std::move(enclosing)), slots(slots), nextLive(live) {
+    if (live) live->previousLive = this;
+    live = this;
+}
 
-void cpplox::Environment::define(const std::string &name, Object value) { values[name] = std::move(value); }
+cpplox::Environment::~Environment() {
+    if (previousLive) previousLive->nextLive = nextLive;
+    else live = nextLive;
+    if (nextLive) nextLive->previousLive = previousLive;
+}
 
-cpplox::Object cpplox::Environment::get(const Token &name) {
-    if (const auto v = values.find(name.lexeme); v != values.end()) return (*v).second;
-    if (enclosing != nullptr) return enclosing->get(name);
-    throw VarAccessErr(Meta::sourceFile, name.line, "Undefined variable '" + name.lexeme + "'.");
+void cpplox::Environment::markAll(Heap &heap) {
+    for (const Environment *environment = live; environment; environment = environment->nextLive)
+        for (const Value value: environment->slots) heap.mark(value);
 }
 
-void cpplox::Environment::assign(const Token &name, Object value) {
-    if (const auto v = values.find(name.lexeme); v != values.end()) {
-        values[name.lexeme] = std::move(value);
-        return;
-    }
-    if (enclosing != nullptr) {
-        enclosing->assign(name, value);
-        return;
+cpplox::Value &cpplox::Environment::at(std::uint32_t depth, std::uint32_t slot) {
+    Environment *environment = this;
+    for (; depth > 0; depth--) environment = environment->enclosing.get();
+    return environment->slots[slot];
+}
+
+std::uint32_t cpplox::Globals::slot(Symbol name) {
+    const auto [it, added] = slots.try_emplace(name, static_cast<std::uint32_t>(names.size()));
+    if (added) {
+        names.push_back(name);
+        values.emplace_back();
+        defined.push_back(false);
     }
-    throw VarAccessErr(Meta::sourceFile, name.line, "Undefined variable '" + name.lexeme + "'.");
+    return it->second;
+}
+
+void cpplox::Globals::define(std::uint32_t slot, Value value) {
+    values[slot] = value;
+    defined[slot] = true;
+}
+
+void cpplox::Globals::assign(std::uint32_t slot, int line, Value value) {
+    if (!defined[slot]) undefined(slot, line);
+    values[slot] = value;
+}
+
+void cpplox::Globals::mark(Heap &heap) const {
+    for (const Value value: values) heap.mark(value);
+}
+
+void cpplox::Globals::undefined(std::uint32_t slot, int line) const {
+    throw VarAccessErr(Meta::sourceFile, line, "Undefined variable '" + std::string(SymbolTable::global().name(names[slot])) + "'.");
 }
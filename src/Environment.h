@@ -1,12 +1,15 @@
 #ifndef CPPLOX_ENVIRONMENT_H
 #define CPPLOX_ENVIRONMENT_H
 
+#include "Heap.h"
 #include "Object.h"
 #include "Token.h"
 #include "Errors.h"
-#include <string>
-#include <unordered_map>
+#include "Symbol.h"
+#include <cstdint>
 #include <memory>
+#include <unordered_map>
+#include <vector>
 
 namespace cpplox {
 
@@ -16,22 +19,59 @@ namespace cpplox {
 
     using pEnv = std::shared_ptr<Environment>;
 
-    class Environment : std::enable_shared_from_this<Environment> {
+    // The locals of one block or function call, in the slots the Resolver gave
+    // them. The Resolver counts them up front, so the array never grows.
+    // Every Environment that exists is on a list, so the Heap can mark the
+    // Values in all of them, see markAll.
+    class Environment {
     public:
         // a reference to its enclosing one
         pEnv enclosing;
 
-        Environment();
-        explicit Environment(pEnv enclosing);
+        Environment(pEnv enclosing, std::size_t slots);
+        Environment(const Environment &) = delete;
+        Environment &operator=(const Environment &) = delete;
+        ~Environment();
+
+        // the variable `depth` environments out from this one
+        Value &at(std::uint32_t depth, std::uint32_t slot);
+
+        static void markAll(Heap &heap);
+
+    private:
+        std::vector<Value> slots;
+        Environment *previousLive = nullptr;
+        Environment *nextLive = nullptr;
+
+        static Environment *live;
+    };
+
+    // The top-level variables, in a dense table indexed by the slot the Resolver
+    // hands out per name. Globals can be referred to before they are defined,
+    // e.g. from a function body, so an undefined one is still a runtime error.
+    class Globals {
+    public:
+        // the slot of name, allocated on first use
+        std::uint32_t slot(Symbol name);
+        Symbol name(std::uint32_t slot) const { return names[slot]; }
+
+        void define(std::uint32_t slot, Value value);
+        Value get(std::uint32_t slot, int line) const {
+            if (!defined[slot]) undefined(slot, line);
+            return values[slot];
+        }
+        // throws a runtime error if the variable hasn't been defined yet
+        void assign(std::uint32_t slot, int line, Value value);
 
-        // binds a new name to a value
-        void define(const std::string &name, Object value);
-        Object get(const Token &name);
-        // throws a runtime error if the key doesnt already exist in the environments variable map
-        void assign(const Token &name, Object value);
+        void mark(Heap &heap) const;
 
     private:
-        std::unordered_map<std::string, Object> values;
+        std::unordered_map<Symbol, std::uint32_t> slots;
+        std::vector<Symbol> names;
+        std::vector<Value> values;
+        std::vector<bool> defined;
+
+        [[noreturn]] void undefined(std::uint32_t slot, int line) const;
     };
 }// namespace cpplox
 
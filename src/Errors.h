@@ -8,8 +8,8 @@
 
 namespace Errors {
 
-    static bool hadError = false;
-    static bool hadRuntimeError = false;
+    inline bool hadError = false;
+    inline bool hadRuntimeError = false;
 
     // syntax(compile-time) error / runtime error
     class Err final : public std::runtime_error {
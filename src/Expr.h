@@ -1,11 +1,13 @@
 #ifndef CPPLOX_EXPR_H
 #define CPPLOX_EXPR_H
 
+#include "Arena.h"
+#include "Heap.h"
 #include "Object.h"
 #include "Token.h"
-#include <memory>
+#include <cstdint>
+#include <string_view>
 #include <variant>
-#include <vector>
 
 namespace cpplox::AST {
 
@@ -18,22 +20,42 @@ namespace cpplox::AST {
     class UnaryExpr;
     class VariableExpr;
 
-    using pAssignExpr = std::unique_ptr<AssignExpr>;
-    using pBinaryExpr = std::unique_ptr<BinaryExpr>;
-    using pCallExpr = std::unique_ptr<CallExpr>;
-    using pGroupingExpr = std::unique_ptr<GroupingExpr>;
-    using pLiteralExpr = std::unique_ptr<LiteralExpr>;
-    using pLogicalExpr = std::unique_ptr<LogicalExpr>;
-    using pUnaryExpr = std::unique_ptr<UnaryExpr>;
-    using pVariableExpr = std::unique_ptr<VariableExpr>;
+    using pAssignExpr = const AssignExpr *;
+    using pBinaryExpr = const BinaryExpr *;
+    using pCallExpr = const CallExpr *;
+    using pGroupingExpr = const GroupingExpr *;
+    using pLiteralExpr = const LiteralExpr *;
+    using pLogicalExpr = const LogicalExpr *;
+    using pUnaryExpr = const UnaryExpr *;
+    using pVariableExpr = const VariableExpr *;
 
+    // Nodes live in the Arena of the parse that made them and are handed
+    // around as plain pointers; none of them has a destructor to run.
     using pExpr = std::variant<std::nullptr_t, pAssignExpr, pBinaryExpr, pCallExpr, pGroupingExpr, pLiteralExpr, pLogicalExpr, pUnaryExpr, pVariableExpr>;
 
+    // Where the Resolver found a name: `depth` scopes out from the innermost
+    // one at the reference, then `slot` within that scope. Globals sit in no
+    // scope and use `slot` to index the Interpreter's Globals table.
+    // A variable of an enclosing function is found in a slot of the function's
+    // own outermost scope, which the closure fills in on each call, see FuncStmt::captures.
+    struct Binding {
+        static constexpr std::uint32_t global = UINT32_MAX;
+        std::uint32_t depth = global;
+        std::uint32_t slot = 0;
+        // the slot holds a Box with the value: a closure captures the
+        // variable and it is assigned, so the copies have to share it
+        bool boxed = false;
+
+        bool isGlobal() const { return depth == global; }
+    };
+
     class AssignExpr {
     public:
-        const Token name;
+        const Name name;
         const pExpr value;
-        AssignExpr(Token name, pExpr value);
+        // filled in by the Resolver
+        mutable Binding binding;
+        AssignExpr(Name name, pExpr value);
     };
 
     class BinaryExpr {
@@ -48,8 +70,8 @@ namespace cpplox::AST {
     public:
         const pExpr callee;
         const Token paren;
-        const std::vector<pExpr> arguments;
-        CallExpr(pExpr callee,Token paren , std::vector<pExpr> arguments);
+        const Span<pExpr> arguments;
+        CallExpr(pExpr callee, Token paren, Span<pExpr> arguments);
     };
 
     class UnaryExpr {
@@ -59,10 +81,27 @@ namespace cpplox::AST {
         UnaryExpr(Token op, pExpr right);
     };
 
+    // a Value that needs nothing on the Heap; strings view into the SourceBuffer
+    using Literal = std::variant<std::monostate, std::string_view, double, bool>;
+
+    // a string literal is copied to a new String on the global Heap each time,
+    // which whoever evaluates it again keeps, see Interpreter::literal
+    inline Value toValue(const Literal &literal) {
+        return std::visit(
+                overloaded{
+                        [](std::monostate) { return Value(); },
+                        [](std::string_view string) { return Value(Heap::global().string(std::string(string))); },
+                        [](auto value) { return Value(value); }},
+                literal);
+    }
+
     class LiteralExpr {
     public:
-        const Object value;
-        explicit LiteralExpr(Object value);
+        const Literal value;
+        // a NUMBER literal that holds an exact integer, see Token::EXACT_INTEGER;
+        // the value is still a double, this only licenses integer fast paths
+        const bool exactInteger;
+        explicit LiteralExpr(Literal value, bool exactInteger = false);
     };
 
     class LogicalExpr {
@@ -81,8 +120,10 @@ namespace cpplox::AST {
 
     class VariableExpr {
     public:
-        const Token name;
-        explicit VariableExpr(Token name);
+        const Name name;
+        // filled in by the Resolver
+        mutable Binding binding;
+        explicit VariableExpr(Name name);
     };
 
 }// namespace cpplox::AST
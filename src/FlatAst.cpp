@@ -0,0 +1,129 @@
+#include "FlatAst.h"
+
+#include <type_traits>
+#include <variant>
+
+cpplox::flat::Tree::Tree(const std::vector<AST::pStmt> &program) {
+    std::vector<Index> statements;
+    statements.reserve(program.size());
+    for (const AST::pStmt &statement: program) statements.push_back(lower(statement));
+    programList = addList(statements);
+}
+
+std::size_t cpplox::flat::Tree::bytes() const {
+    return exprs.size() * (sizeof(Expr) + sizeof(std::uint32_t)) + stmts.size() * sizeof(Stmt) +
+           lists.size() * sizeof(Index) + bindings.size() * sizeof(AST::Binding) +
+           functions.size() * sizeof(Function) + captures.size() * sizeof(AST::Capture) + numbers.size() * sizeof(double) + strings.size() * sizeof(std::string_view);
+}
+
+auto cpplox::flat::Tree::lower(const AST::pExpr &pExpr) -> Index {
+    return std::visit(
+            [this](auto &&pExpr) -> Index {
+                using T = std::decay_t<decltype(pExpr)>;
+                if constexpr (std::is_same_v<T, AST::pAssignExpr>) {
+                    const Index value = lower(pExpr->value);
+                    return addExpr(ExprKind::Assign, static_cast<std::uint32_t>(pExpr->name.line), addBinding(pExpr->binding), value);
+                }
+                if constexpr (std::is_same_v<T, AST::pBinaryExpr> || std::is_same_v<T, AST::pLogicalExpr>) {
+                    const Index left = lower(pExpr->left);
+                    const Index right = lower(pExpr->right);
+                    const ExprKind kind = std::is_same_v<T, AST::pBinaryExpr> ? ExprKind::Binary : ExprKind::Logical;
+                    return addExpr(kind, pExpr->op.line, left, right, pExpr->op.type);
+                }
+                if constexpr (std::is_same_v<T, AST::pCallExpr>) {
+                    const Index callee = lower(pExpr->callee);
+                    std::vector<Index> arguments;
+                    for (const AST::pExpr &argument: pExpr->arguments) arguments.push_back(lower(argument));
+                    return addExpr(ExprKind::Call, pExpr->paren.line, callee, addList(arguments));
+                }
+                if constexpr (std::is_same_v<T, AST::pGroupingExpr>) return addExpr(ExprKind::Grouping, 0, lower(pExpr->expression));
+                if constexpr (std::is_same_v<T, AST::pLiteralExpr>) {
+                    return std::visit(
+                            overloaded{
+                                    [this](std::monostate) { return addExpr(ExprKind::Nil, 0); },
+                                    [this](bool value) { return addExpr(value ? ExprKind::True : ExprKind::False, 0); },
+                                    [this](double value) {
+                                        numbers.push_back(value);
+                                        return addExpr(ExprKind::Number, 0, static_cast<Index>(numbers.size() - 1));
+                                    },
+                                    [this](std::string_view value) {
+                                        strings.push_back(value);
+                                        return addExpr(ExprKind::String, 0, static_cast<Index>(strings.size() - 1));
+                                    }},
+                            pExpr->value);
+                }
+                if constexpr (std::is_same_v<T, AST::pUnaryExpr>) {
+                    const Index right = lower(pExpr->right);
+                    return addExpr(ExprKind::Unary, pExpr->op.line, right, none, pExpr->op.type);
+                }
+                if constexpr (std::is_same_v<T, AST::pVariableExpr>)
+                    return addExpr(ExprKind::Variable, static_cast<std::uint32_t>(pExpr->name.line), addBinding(pExpr->binding));
+                return none;
+            },
+            pExpr);
+}
+
+auto cpplox::flat::Tree::lower(const AST::pStmt &pStmt) -> Index {
+    return std::visit(
+            [this](auto &&pStmt) -> Index {
+                using T = std::decay_t<decltype(pStmt)>;
+                if constexpr (std::is_same_v<T, AST::pBlockStmt>) return addStmt(StmtKind::Block, lower(pStmt->statements), pStmt->slots);
+                if constexpr (std::is_same_v<T, AST::pExpressionStmt>) return addStmt(StmtKind::Expression, lower(pStmt->expression));
+                if constexpr (std::is_same_v<T, AST::pFunctionStmt>) {
+                    std::vector<Index> captured;
+                    for (const AST::Capture &capture: pStmt->captures) {
+                        captured.push_back(static_cast<Index>(captures.size()));
+                        captures.push_back(capture);
+                    }
+                    const std::vector<Index> boxed(pStmt->boxed.begin(), pStmt->boxed.end());
+                    functions.push_back({pStmt->name.symbol, static_cast<std::uint32_t>(pStmt->params.size()), pStmt->slots,
+                                         addList(captured), addList(boxed)});
+                    const auto function = static_cast<Index>(functions.size() - 1);
+                    return addStmt(StmtKind::Function, addBinding(pStmt->binding), function, lower(pStmt->body));
+                }
+                if constexpr (std::is_same_v<T, AST::pIfStmt>) {
+                    const Index condition = lower(pStmt->condition);
+                    const Index thenBranch = lower(pStmt->thenBranch);
+                    return addStmt(StmtKind::If, condition, thenBranch, lower(pStmt->elseBranch));
+                }
+                if constexpr (std::is_same_v<T, AST::pPrintStmt>) return addStmt(StmtKind::Print, lower(pStmt->expression));
+                if constexpr (std::is_same_v<T, AST::pReturnStmt>) return addStmt(StmtKind::Return, lower(pStmt->value));
+                if constexpr (std::is_same_v<T, AST::pVarStmt>) return addStmt(StmtKind::Var, addBinding(pStmt->binding), lower(pStmt->initializer));
+                if constexpr (std::is_same_v<T, AST::pWhileStmt>) {
+                    const Index condition = lower(pStmt->condition);
+                    return addStmt(StmtKind::While, condition, lower(pStmt->body));
+                }
+                return none;
+            },
+            pStmt);
+}
+
+auto cpplox::flat::Tree::lower(Span<AST::pStmt> statements) -> Index {
+    std::vector<Index> items;
+    items.reserve(statements.size());
+    for (const AST::pStmt &statement: statements) items.push_back(lower(statement));
+    return addList(items);
+}
+
+auto cpplox::flat::Tree::addExpr(ExprKind kind, std::uint32_t line, Index a, Index b, TokenType op) -> Index {
+    exprs.push_back({kind, op, a, b});
+    exprLines.push_back(line);
+    return static_cast<Index>(exprs.size() - 1);
+}
+
+auto cpplox::flat::Tree::addStmt(StmtKind kind, Index a, Index b, Index c) -> Index {
+    stmts.push_back({kind, a, b, c});
+    return static_cast<Index>(stmts.size() - 1);
+}
+
+auto cpplox::flat::Tree::addList(const std::vector<Index> &items) -> Index {
+    const auto list = static_cast<Index>(lists.size());
+    lists.push_back(static_cast<Index>(items.size()));
+    lists.insert(lists.end(), items.begin(), items.end());
+    return list;
+}
+
+auto cpplox::flat::Tree::addBinding(const AST::Binding &binding) -> Index {
+    bindings.push_back(binding);
+    return static_cast<Index>(bindings.size() - 1);
+}
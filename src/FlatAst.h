@@ -0,0 +1,126 @@
+#ifndef CPPLOX_FLATAST_H
+#define CPPLOX_FLATAST_H
+
+#include "Arena.h"
+#include "Stmt.h"
+#include "Symbol.h"
+#include "Token.h"
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+namespace cpplox::flat {
+
+    // nodes refer to each other by their position in the Tree's pools
+    using Index = std::uint32_t;
+    inline constexpr Index none = UINT32_MAX;
+
+    // literals get a kind each, so nil, true and false need no payload
+    enum class ExprKind : std::uint8_t {
+        Assign,  // a: index into bindings, b: value
+        Binary,  // op, a: left, b: right
+        Call,    // a: callee, b: list of arguments
+        Grouping,// a: expression
+        Nil,
+        True,
+        False,
+        Number,  // a: index into numbers
+        String,  // a: index into strings
+        Logical, // op, a: left, b: right
+        Unary,   // op, a: operand
+        Variable,// a: index into bindings
+    };
+
+    enum class StmtKind : std::uint8_t {
+        Block,     // a: list of statements, b: number of slots
+        Expression,// a: expression
+        Function,  // a: index into bindings, b: index into functions, c: list of statements
+        If,        // a: condition, b: then, c: else or none
+        Print,     // a: expression
+        Return,    // a: value or none
+        Var,       // a: index into bindings, b: initializer or none
+        While,     // a: condition, b: body
+    };
+
+    // what the interpreter reads of a node, packed so one load brings in all of it
+    struct Expr {
+        ExprKind kind;
+        // the operator of Binary, Logical and Unary
+        TokenType op;
+        Index a;
+        Index b;
+    };
+
+    struct Stmt {
+        StmtKind kind;
+        Index a;
+        Index b;
+        Index c;
+    };
+
+    static_assert(sizeof(Expr) == 12 && sizeof(Stmt) == 16);
+
+    // what a call needs of a function declaration besides its body
+    struct Function {
+        Symbol name;
+        std::uint32_t arity;
+        // the parameters, the captures and the locals declared directly in the body
+        std::uint32_t slots;
+        // a list of indices into captures, and one of the slots of the parameters to box
+        Index captures;
+        Index boxed;
+    };
+
+    // The AST lowered into typed pools: 12 bytes per expression and 16 per
+    // statement, with the lines of expressions split off into a cold array.
+    // Operators are kept as their TokenType.
+    // Strings view into the SourceBuffer; nothing refers back to the Arena nodes,
+    // so those can be released once the tree is built.
+    class Tree {
+    public:
+        explicit Tree(const std::vector<AST::pStmt> &program);
+
+        // the top-level statements
+        Span<Index> program() const { return list(programList); }
+
+        const Expr &expr(Index expr) const { return exprs[expr]; }
+        std::uint32_t exprLine(Index expr) const { return exprLines[expr]; }
+        const Stmt &stmt(Index stmt) const { return stmts[stmt]; }
+
+        Span<Index> list(Index list) const { return {&lists[list + 1], lists[list]}; }
+        const AST::Binding &binding(Index binding) const { return bindings[binding]; }
+        const Function &function(Index function) const { return functions[function]; }
+        const AST::Capture &capture(Index capture) const { return captures[capture]; }
+        double number(Index literal) const { return numbers[literal]; }
+        std::string_view string(Index literal) const { return strings[literal]; }
+
+        // bytes held by the pools, for comparing against Arena::bytesUsed
+        std::size_t bytes() const;
+
+    private:
+        std::vector<Expr> exprs;
+        std::vector<Stmt> stmts;
+        // cold: only read to report runtime errors
+        std::vector<std::uint32_t> exprLines;
+
+        // each list is its length followed by its items
+        std::vector<Index> lists;
+        std::vector<AST::Binding> bindings;
+        std::vector<Function> functions;
+        std::vector<AST::Capture> captures;
+        std::vector<double> numbers;
+        std::vector<std::string_view> strings;
+        Index programList = 0;
+
+        Index lower(const AST::pExpr &pExpr);
+        Index lower(const AST::pStmt &pStmt);
+        Index lower(Span<AST::pStmt> statements);
+        Index addExpr(ExprKind kind, std::uint32_t line, Index a = none, Index b = none, TokenType op = TokenType::EOF_TOKEN);
+        Index addStmt(StmtKind kind, Index a = none, Index b = none, Index c = none);
+        Index addList(const std::vector<Index> &items);
+        Index addBinding(const AST::Binding &binding);
+    };
+
+}// namespace cpplox::flat
+
+#endif// CPPLOX_FLATAST_H
@@ -0,0 +1,139 @@
+#include "Interpreter.h"
+#include "FlatAst.h"
+#include <iostream>
+#include "Function.h"
+
+// The walk over flat::Tree mirrors the one over the pointer AST in
+// Interpreter.cpp, dispatching on the kind columns instead of std::visit.
+
+void cpplox::Interpreter::interpret(const flat::Tree &tree) {
+    try { for (const flat::Index stmt: tree.program()) execute(tree, stmt); } catch (const InterpretErr &error) {
+        Errors::hadRuntimeError = true;
+        logger::error(error);
+    }
+}
+
+cpplox::Completion cpplox::Interpreter::execute(const flat::Tree &tree, flat::Index stmt) {
+    // statements that failed to parse were lowered to none
+    if (stmt == flat::none) return {};
+    safePoint();
+    const flat::Stmt &node = tree.stmt(stmt);
+    switch (node.kind) {
+        case flat::StmtKind::Block:
+            return executeBlock(tree, tree.list(node.a), std::make_shared<Environment>(environment, node.b));
+        case flat::StmtKind::Expression:
+            evaluate(tree, node.a);
+            return {};
+        case flat::StmtKind::Function:
+            evalFlatFunction(tree, stmt);
+            return {};
+        case flat::StmtKind::If:
+            if (isTruthy(evaluate(tree, node.a))) return execute(tree, node.b);
+            return execute(tree, node.c);
+        case flat::StmtKind::Print:
+            std::cout << evaluate(tree, node.a) << std::endl;
+            return {};
+        case flat::StmtKind::Return:
+            return {true, node.a == flat::none ? Value{} : evaluate(tree, node.a)};
+        case flat::StmtKind::Var: {
+            const flat::Index initializer = node.b;
+            define(tree.binding(node.a), initializer == flat::none ? Value{} : evaluate(tree, initializer));
+            return {};
+        }
+        case flat::StmtKind::While:
+            while (isTruthy(evaluate(tree, node.a)))
+                if (Completion completion = execute(tree, node.b); completion.returned) return completion;
+            return {};
+    }
+    // Unreachable.
+    return {};
+}
+
+cpplox::Completion cpplox::Interpreter::executeBlock(const flat::Tree &tree, Span<flat::Index> statements, pEnv blockEnv) {
+    const Scope scope(environment, std::move(blockEnv));
+    for (const flat::Index statement: statements)
+        if (Completion completion = execute(tree, statement); completion.returned) return completion;
+    return {};
+}
+
+cpplox::Value cpplox::Interpreter::evaluate(const flat::Tree &tree, flat::Index expr) {
+    // the cases that need temporaries get functions of their own,
+    // which keeps this frame small on deep recursions
+    const flat::Expr &node = tree.expr(expr);
+    switch (node.kind) {
+        case flat::ExprKind::Assign:
+            return evalFlatAssign(tree, expr);
+        case flat::ExprKind::Binary:
+            return evalFlatBinary(tree, expr);
+        case flat::ExprKind::Call:
+            return evalFlatCall(tree, expr);
+        case flat::ExprKind::Grouping:
+            return evaluate(tree, node.a);
+        case flat::ExprKind::Nil:
+            return Value{};
+        case flat::ExprKind::True:
+            return true;
+        case flat::ExprKind::False:
+            return false;
+        case flat::ExprKind::Number:
+            return tree.number(node.a);
+        case flat::ExprKind::String:
+            return literal(tree.string(node.a));
+        case flat::ExprKind::Logical:
+            return evalFlatLogical(tree, expr);
+        case flat::ExprKind::Unary:
+            return unary(node.op, evaluate(tree, node.a), tree.exprLine(expr));
+        case flat::ExprKind::Variable:
+            return lookUp(tree.binding(node.a), static_cast<int>(tree.exprLine(expr)));
+    }
+    // Unreachable.
+    return Value{};
+}
+
+void cpplox::Interpreter::evalFlatFunction(const flat::Tree &tree, flat::Index stmt) {
+    const AST::Binding &binding = tree.binding(tree.stmt(stmt).a);
+    // see evalFunctionStmt
+    if (binding.boxed) define(binding, Value{});
+    std::vector<Value> captures;
+    for (const flat::Index capture: tree.list(tree.function(tree.stmt(stmt).b).captures))
+        captures.push_back(slot(tree.capture(capture).from));
+    FlatFunction *function = Heap::global().make<FlatFunction>(tree, stmt, std::move(captures));
+    if (binding.boxed) assign(binding, 0, function);
+    else define(binding, function);
+}
+
+cpplox::Value cpplox::Interpreter::evalFlatAssign(const flat::Tree &tree, flat::Index expr) {
+    const flat::Expr &node = tree.expr(expr);
+    const Value value = evaluate(tree, node.b);
+    assign(tree.binding(node.a), static_cast<int>(tree.exprLine(expr)), value);
+    return value;
+}
+
+cpplox::Value cpplox::Interpreter::evalFlatBinary(const flat::Tree &tree, flat::Index expr) {
+    const flat::Expr &node = tree.expr(expr);
+    const Pending pending(temporaries);
+    const Value left = evaluate(tree, node.a);
+    temporaries.push_back(left);
+    const Value right = evaluate(tree, node.b);
+    return binary(node.op, left, right, tree.exprLine(expr));
+}
+
+cpplox::Value cpplox::Interpreter::evalFlatCall(const flat::Tree &tree, flat::Index expr) {
+    const flat::Expr &node = tree.expr(expr);
+    const Pending pending(temporaries);
+    const Value callee = evaluate(tree, node.a);
+    temporaries.push_back(callee);
+    std::vector<Value> arguments;
+    for (const flat::Index argument: tree.list(node.b)) {
+        arguments.emplace_back(evaluate(tree, argument));
+        temporaries.push_back(arguments.back());
+    }
+    return checkCall(callee, arguments.size(), tree.exprLine(expr))->call(*this, arguments);
+}
+
+cpplox::Value cpplox::Interpreter::evalFlatLogical(const flat::Tree &tree, flat::Index expr) {
+    const flat::Expr &node = tree.expr(expr);
+    const Value left = evaluate(tree, node.a);
+    if (node.op == TokenType::OR ? isTruthy(left) : !isTruthy(left)) return left;
+    return evaluate(tree, node.b);
+}
@@ -1,6 +1,7 @@
 #ifndef CPPLOX_FUNCTION_H
 #define CPPLOX_FUNCTION_H
 
+#include "FlatAst.h"
 #include <vector>
 
 namespace cpplox {
@@ -11,7 +12,7 @@ namespace cpplox {
     public:
         int arity() override { return 0; }
 
-        Object call(Interpreter &interpreter, const std::vector<Object> &arguments) override {
+        Value call(Interpreter &interpreter, const std::vector<Value> &arguments) override {
             return static_cast<double>(
                 std::chrono::duration_cast<std::chrono::milliseconds>(
                         std::chrono::high_resolution_clock::now().time_since_epoch()).count());
@@ -20,25 +21,67 @@ namespace cpplox {
         std::string toString() override { return "<native fn>"; }
     };
 
+    // a closure: the declaration with the variables it captures, see AST::FuncStmt::captures
     class Function : public Callable {
     public:
-        explicit Function(const AST::pFunctionStmt &declaration)
-            : declaration(declaration) {}
+        // the declaration lives in an Arena that is kept until exit, see Runner::run
+        Function(AST::pFunctionStmt declaration, std::vector<Value> captures)
+            : declaration(declaration), captures(std::move(captures)) {}
 
         int arity() override { return static_cast<int>(declaration->params.size()); }
 
-        Object call(Interpreter &interpreter, const std::vector<Object> &arguments) override {
-            const pEnv env{interpreter.globals};
-            for (int i = 0; i < arity(); i++) { env->define(declaration->params[i].lexeme, arguments[i]); }
-            interpreter.executeBlock(declaration->body, env);
-            return Object{};
+        Value call(Interpreter &interpreter, const std::vector<Value> &arguments) override {
+            if (declaration->lazy) interpreter.parseBody(*declaration);
+            // the body refers to nothing but its own scopes and the globals, the captures are copied in
+            const pEnv env = std::make_shared<Environment>(nullptr, declaration->slots);
+            // the Resolver gives the parameters the first slots
+            for (int i = 0; i < arity(); i++) { env->at(0, i) = arguments[i]; }
+            for (std::size_t i = 0; i < captures.size(); i++) env->at(0, declaration->captures[i].slot) = captures[i];
+            for (const std::uint32_t slot: declaration->boxed) env->at(0, slot) = Heap::global().make<Box>(env->at(0, slot));
+            return interpreter.executeBlock(declaration->body, env).value;
         }
 
-        std::string toString() override { return "<fn " + declaration->name.lexeme + ">"; }
+        std::string toString() override { return "<fn " + std::string(declaration->name.lexeme()) + ">"; }
 
+        void trace(Heap &heap) const override {
+            for (const Value capture: captures) heap.mark(capture);
+        }
 
     private:
-        const AST::pFunctionStmt &declaration;
+        const AST::pFunctionStmt declaration;
+        const std::vector<Value> captures;
+    };
+
+    // a Function declared in a flat::Tree
+    class FlatFunction : public Callable {
+    public:
+        // the tree is kept until exit, see Runner::run
+        FlatFunction(const flat::Tree &tree, flat::Index declaration, std::vector<Value> captures)
+            : tree(tree), declaration(declaration), captures(std::move(captures)) {}
+
+        int arity() override { return static_cast<int>(function().arity); }
+
+        Value call(Interpreter &interpreter, const std::vector<Value> &arguments) override {
+            const pEnv env = std::make_shared<Environment>(nullptr, function().slots);
+            for (int i = 0; i < arity(); i++) { env->at(0, i) = arguments[i]; }
+            const Span<flat::Index> slots = tree.list(function().captures);
+            for (std::size_t i = 0; i < captures.size(); i++) env->at(0, tree.capture(slots[i]).slot) = captures[i];
+            for (const flat::Index slot: tree.list(function().boxed)) env->at(0, slot) = Heap::global().make<Box>(env->at(0, slot));
+            return interpreter.executeBlock(tree, tree.list(tree.stmt(declaration).c), env).value;
+        }
+
+        std::string toString() override { return "<fn " + std::string(SymbolTable::global().name(function().name)) + ">"; }
+
+        void trace(Heap &heap) const override {
+            for (const Value capture: captures) heap.mark(capture);
+        }
+
+    private:
+        const flat::Function &function() const { return tree.function(tree.stmt(declaration).b); }
+
+        const flat::Tree &tree;
+        const flat::Index declaration;
+        const std::vector<Value> captures;
     };
 
 
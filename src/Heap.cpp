@@ -0,0 +1,55 @@
+#include "Heap.h"
+
+#include <algorithm>
+
+cpplox::Heap &cpplox::Heap::global() {
+    static Heap heap;
+    return heap;
+}
+
+cpplox::Heap::~Heap() {
+    while (objects) {
+        Object *next = objects->next;
+        delete objects;
+        objects = next;
+    }
+}
+
+void cpplox::Heap::removeRoots(Roots *roots) { this->roots.erase(std::find(this->roots.begin(), this->roots.end(), roots)); }
+
+void cpplox::Heap::adopt(Object *object, std::size_t bytes) {
+    object->bytes = bytes;
+    object->next = objects;
+    objects = object;
+    objectCount++;
+    bytesAllocated += bytes;
+}
+
+void cpplox::Heap::mark(Object *object) {
+    if (object->marked) return;
+    object->marked = true;
+    gray.push_back(object);
+}
+
+void cpplox::Heap::collect() {
+    for (Roots *root: roots) root->markRoots(*this);
+    while (!gray.empty()) {
+        const Object *object = gray.back();
+        gray.pop_back();
+        object->trace(*this);
+    }
+
+    Object **link = &objects;
+    while (Object *object = *link) {
+        if (object->marked) {
+            object->marked = false;
+            link = &object->next;
+            continue;
+        }
+        *link = object->next;
+        objectCount--;
+        bytesAllocated -= object->bytes;
+        delete object;
+    }
+    nextCollection = std::max(minimumCollection, bytesAllocated * 2);
+}
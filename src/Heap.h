@@ -0,0 +1,84 @@
+#ifndef CPPLOX_HEAP_H
+#define CPPLOX_HEAP_H
+
+#include "Object.h"
+#include <cstddef>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace cpplox {
+
+    // Owns every Object a Value can point to, and frees those no Value
+    // refers to any more by mark and sweep.
+    // Values are plain bits, so the Heap can't find them on its own: whatever
+    // holds some registers as Roots and marks them when asked. A collection
+    // only happens where the caller knows every live Value sits in one of
+    // those, see wantsCollection; the engines check between statements and
+    // the VM at calls and backward jumps.
+    class Heap {
+    public:
+        // something that holds Values, e.g. an Interpreter's globals or a VM's stack
+        class Roots {
+        public:
+            virtual void markRoots(Heap &heap) = 0;
+
+        protected:
+            ~Roots() = default;
+        };
+
+        static Heap &global();
+        Heap() = default;
+        Heap(const Heap &) = delete;
+        Heap &operator=(const Heap &) = delete;
+        ~Heap();
+
+        template<class T, class... Args>
+        T *make(Args &&...args) {
+            T *object = new T(std::forward<Args>(args)...);
+            adopt(object, sizeof(T));
+            return object;
+        }
+
+        String *string(std::string chars) {
+            const std::size_t bytes = sizeof(String) + chars.capacity();
+            String *string = new String(std::move(chars));
+            adopt(string, bytes);
+            return string;
+        }
+
+        void addRoots(Roots *roots) { this->roots.push_back(roots); }
+        void removeRoots(Roots *roots);
+
+        void mark(Value value) {
+            if (value.isObject()) mark(value.asObject());
+        }
+        void mark(Object *object);
+
+        // true once enough has been allocated since the last collection
+        bool wantsCollection() const { return bytesAllocated >= nextCollection; }
+        void collect();
+
+        std::size_t liveObjects() const { return objectCount; }
+        std::size_t liveBytes() const { return bytesAllocated; }
+
+    private:
+        // collections are spaced out so each frees about as much as it keeps
+        static constexpr std::size_t minimumCollection = 1024 * 1024;
+
+        Object *objects = nullptr;
+        std::size_t objectCount = 0;
+        std::size_t bytesAllocated = 0;
+        std::size_t nextCollection = minimumCollection;
+        std::vector<Roots *> roots;
+        // marked, but not traced yet
+        std::vector<Object *> gray;
+
+        void adopt(Object *object, std::size_t bytes);
+    };
+
+    void Box::trace(Heap &heap) const { heap.mark(value); }
+
+}// namespace cpplox
+
+#endif// CPPLOX_HEAP_H
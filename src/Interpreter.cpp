@@ -1,11 +1,29 @@
 #include "Interpreter.h"
+#include "LoopHoister.h"
 #include "Meta.h"
+#include "Optimizer.h"
+#include "Parser.h"
+#include "Resolver.h"
+#include "Scanner.h"
+#include "SubexpressionEliminator.h"
 #include <iostream>
 #include <utility>
 #include <algorithm>
 #include "Function.h"
 
-cpplox::Interpreter::Interpreter() { globals->define("clock", std::make_shared<Clock>()); }
+cpplox::Interpreter::Interpreter() {
+    Heap::global().addRoots(this);
+    globals.define(globals.slot(intern("clock")), Heap::global().make<Clock>());
+}
+
+cpplox::Interpreter::~Interpreter() { Heap::global().removeRoots(this); }
+
+void cpplox::Interpreter::markRoots(Heap &heap) {
+    globals.mark(heap);
+    for (const Value value: temporaries) heap.mark(value);
+    for (const auto &[chars, value]: literals) heap.mark(value);
+    Environment::markAll(heap);
+}
 
 void cpplox::Interpreter::interpret(const std::vector<AST::pStmt> &statements) {
     try { for (const AST::pStmt &pStmt: statements) execute(pStmt); } catch (const InterpretErr &error) {
@@ -14,46 +32,73 @@ void cpplox::Interpreter::interpret(const std::vector<AST::pStmt> &statements) {
     }
 }
 
-void cpplox::Interpreter::execute(const AST::pStmt &pStmt) {
+cpplox::Completion cpplox::Interpreter::execute(const AST::pStmt &pStmt) {
+    safePoint();
     return std::visit(
-            [this](auto &&pStmt) -> void {
+            [this](auto &&pStmt) -> Completion {
                 using T = std::decay_t<decltype(pStmt)>;
                 if constexpr (std::is_same_v<T, AST::pBlockStmt>) return evalBlockStmt(pStmt);
-                if constexpr (std::is_same_v<T, AST::pExpressionStmt>) return evalExpressionStmt(pStmt);
-                if constexpr (std::is_same_v<T, AST::pFunctionStmt>) return evalFunctionStmt(pStmt);
+                if constexpr (std::is_same_v<T, AST::pExpressionStmt>) evalExpressionStmt(pStmt);
+                if constexpr (std::is_same_v<T, AST::pFunctionStmt>) evalFunctionStmt(pStmt);
                 if constexpr (std::is_same_v<T, AST::pIfStmt>) return evalIfStmt(pStmt);
-                if constexpr (std::is_same_v<T, AST::pPrintStmt>) return evalPrintStmt(pStmt);
-                if constexpr (std::is_same_v<T, AST::pVarStmt>) return evalVarStmt(pStmt);
+                if constexpr (std::is_same_v<T, AST::pPrintStmt>) evalPrintStmt(pStmt);
+                if constexpr (std::is_same_v<T, AST::pReturnStmt>) return evalReturnStmt(pStmt);
+                if constexpr (std::is_same_v<T, AST::pVarStmt>) evalVarStmt(pStmt);
                 if constexpr (std::is_same_v<T, AST::pWhileStmt>) return evalWhileStmt(pStmt);
+                return {};
             },
             pStmt);
 }
 
-void cpplox::Interpreter::evalBlockStmt(const AST::pBlockStmt &pStmt) { executeBlock(pStmt->statements, std::make_shared<Environment>(environment)); }
+cpplox::Completion cpplox::Interpreter::evalBlockStmt(const AST::pBlockStmt &pStmt) {
+    return executeBlock(pStmt->statements, std::make_shared<Environment>(environment, pStmt->slots));
+}
+
+cpplox::Completion cpplox::Interpreter::executeBlock(Span<AST::pStmt> statements, pEnv blockEnv) {
+    const Scope scope(environment, std::move(blockEnv));
+    for (const AST::pStmt &statement: statements)
+        if (Completion completion = execute(statement); completion.returned) return completion;
+    return {};
+}
 
-void cpplox::Interpreter::executeBlock(const std::vector<AST::pStmt> &statements, pEnv blockEnv) {
-    const pEnv previous = this->environment;
-    try {
-        this->environment = std::move(blockEnv);
-        for (const AST::pStmt &statement: statements) { execute(statement); }
-    } catch (...) {
-        this->environment = previous;
-        // throw;
+void cpplox::Interpreter::parseBody(const AST::FuncStmt &function) {
+    const AST::LazyBody &lazy = *function.lazy;
+    // the body's errors are its own: they fail this call, not the run, which has long since been accepted
+    Diagnostics diagnostics;
+    Scanner scanner(lazy.text, static_cast<int>(lazy.line), diagnostics);
+    // the functions nested in the body are parsed along with it
+    std::vector<AST::pStmt> body = Parser(scanner, *lazy.arena, false, diagnostics).parseBody();
+    // checked as written, see Resolver::check
+    if (!diagnostics.hadError() && (lazy.optimize || lazy.eliminateSubexpressions)) {
+        function.body = lazy.arena->copy(body);
+        Resolver::checkBody(&function, diagnostics);
+    }
+    if (!diagnostics.hadError() && lazy.optimize) body = LoopHoister(*lazy.arena).hoistBody(function.params, Optimizer(*lazy.arena).optimize(body));
+    if (!diagnostics.hadError() && lazy.eliminateSubexpressions) body = SubexpressionEliminator(*lazy.arena).eliminateBody(function.params, body);
+    function.body = lazy.arena->copy(body);
+    if (!diagnostics.hadError()) Resolver(*lazy.arena, globals, diagnostics).resolveBody(&function);
+    if (diagnostics.hadError()) {
+        for (const Diagnostic &diagnostic: diagnostics.errors()) logger::error(diagnostic);
+        throw InterpretErr(Meta::sourceFile, function.name.line, "Can't call '" + std::string(function.name.lexeme()) + "', its body has errors.");
     }
-    this->environment = previous;
+    function.lazy = nullptr;
 }
 
 void cpplox::Interpreter::evalVarStmt(const AST::pVarStmt &pStmt) {
-    Object value = Object{};
+    Value value;
     if (!std::holds_alternative<std::nullptr_t>(pStmt->initializer)) value = evaluate(pStmt->initializer);
-    environment->define((pStmt->name).lexeme, value);
+    define(pStmt->binding, value);
 }
 
-void cpplox::Interpreter::evalWhileStmt(const AST::pWhileStmt &pStmt) { while (isTruthy(evaluate(pStmt->condition))) execute(pStmt->body); }
+cpplox::Completion cpplox::Interpreter::evalWhileStmt(const AST::pWhileStmt &pStmt) {
+    while (isTruthy(evaluate(pStmt->condition)))
+        if (Completion completion = execute(pStmt->body); completion.returned) return completion;
+    return {};
+}
 
-cpplox::Object cpplox::Interpreter::evaluate(const AST::pExpr &pExpr) {
+cpplox::Value cpplox::Interpreter::evaluate(const AST::pExpr &pExpr) {
     return std::visit(
-            [this](auto &&pExpr) -> Object {
+            [this](auto &&pExpr) -> Value {
                 using T = std::decay_t<decltype(pExpr)>;
                 if constexpr (std::is_same_v<T, AST::pAssignExpr>) return evalAssignExpr(pExpr);
                 if constexpr (std::is_same_v<T, AST::pBinaryExpr>) return evalBinaryExpr(pExpr);
@@ -63,7 +108,7 @@ cpplox::Object cpplox::Interpreter::evaluate(const AST::pExpr &pExpr) {
                 if constexpr (std::is_same_v<T, AST::pLogicalExpr>) return evalLogicalExpr(pExpr);
                 if constexpr (std::is_same_v<T, AST::pUnaryExpr>) return evalUnaryExpr(pExpr);
                 if constexpr (std::is_same_v<T, AST::pVariableExpr>) return evalVariableExpr(pExpr);
-                return Object{};
+                return Value{};
             },
             pExpr);
 }
@@ -71,125 +116,177 @@ cpplox::Object cpplox::Interpreter::evaluate(const AST::pExpr &pExpr) {
 void cpplox::Interpreter::evalExpressionStmt(const AST::pExpressionStmt &pStmt) { evaluate(pStmt->expression); }
 
 void cpplox::Interpreter::evalFunctionStmt(const AST::pFunctionStmt &pStmt) {
-    //FIXME const unique_ptr
-    const std::string name = pStmt->name.lexeme;
-    pFunction function = std::make_shared<Function>(pStmt);
-    environment->define(name, std::move(function));
+    // a function that calls itself captures its own Box, so that comes first
+    if (pStmt->binding.boxed) define(pStmt->binding, Value{});
+    std::vector<Value> captures;
+    captures.reserve(pStmt->captures.size());
+    for (const AST::Capture &capture: pStmt->captures) captures.push_back(slot(capture.from));
+    Function *function = Heap::global().make<Function>(pStmt, std::move(captures));
+    if (pStmt->binding.boxed) assign(pStmt->binding, pStmt->name.line, function);
+    else define(pStmt->binding, function);
 }
 
-void cpplox::Interpreter::evalIfStmt(const AST::pIfStmt &pStmt) {
-    if (isTruthy(evaluate(pStmt->condition))) execute(pStmt->thenBranch);
-    else if (!std::holds_alternative<std::nullptr_t>(pStmt->elseBranch)) execute(pStmt->elseBranch);
+cpplox::Completion cpplox::Interpreter::evalIfStmt(const AST::pIfStmt &pStmt) {
+    if (isTruthy(evaluate(pStmt->condition))) return execute(pStmt->thenBranch);
+    if (!std::holds_alternative<std::nullptr_t>(pStmt->elseBranch)) return execute(pStmt->elseBranch);
+    return {};
 }
 
 void cpplox::Interpreter::evalPrintStmt(const AST::pPrintStmt &pStmt) {
-    const Object value = evaluate(pStmt->expression);
+    const Value value = evaluate(pStmt->expression);
     std::cout << value << std::endl;
 }
 
-cpplox::Object cpplox::Interpreter::evalAssignExpr(const AST::pAssignExpr &pExpr) {
-    Object value = evaluate(pExpr->value);
-    environment->assign(pExpr->name, value);
+cpplox::Completion cpplox::Interpreter::evalReturnStmt(const AST::pReturnStmt &pStmt) {
+    if (std::holds_alternative<std::nullptr_t>(pStmt->value)) return {true, Value{}};
+    return {true, evaluate(pStmt->value)};
+}
+
+cpplox::Value cpplox::Interpreter::evalAssignExpr(const AST::pAssignExpr &pExpr) {
+    const Value value = evaluate(pExpr->value);
+    assign(pExpr->binding, pExpr->name.line, value);
     return value;
 }
 
-cpplox::Object cpplox::Interpreter::evalLiteralExpr(const AST::pLiteralExpr &pExpr) { return pExpr->value; }
+cpplox::Value cpplox::Interpreter::literal(std::string_view chars) {
+    if (const auto it = literals.find(chars); it != literals.end()) return it->second;
+    String *string = Heap::global().string(std::string(chars));
+    // the key views the String's own characters, which live as long as the entry
+    literals.emplace(string->chars, string);
+    return string;
+}
+
+cpplox::Value cpplox::Interpreter::evalLiteralExpr(const AST::pLiteralExpr &pExpr) {
+    if (const auto *chars = std::get_if<std::string_view>(&pExpr->value)) return literal(*chars);
+    return AST::toValue(pExpr->value);
+}
 
-cpplox::Object cpplox::Interpreter::evalLogicalExpr(const AST::pLogicalExpr &pExpr) {
-    Object left = evaluate(pExpr->left);
+cpplox::Value cpplox::Interpreter::evalLogicalExpr(const AST::pLogicalExpr &pExpr) {
+    const Value left = evaluate(pExpr->left);
 
     if (pExpr->op.type == TokenType::OR) { if (isTruthy(left)) return left; } else { if (!isTruthy(left)) return left; }
 
     return evaluate(pExpr->right);
 }
 
-cpplox::Object cpplox::Interpreter::evalGroupingExpr(const AST::pGroupingExpr &pExpr) { return evaluate(pExpr->expression); }
+cpplox::Value cpplox::Interpreter::evalGroupingExpr(const AST::pGroupingExpr &pExpr) { return evaluate(pExpr->expression); }
+
+cpplox::Value cpplox::Interpreter::evalUnaryExpr(const AST::pUnaryExpr &pExpr) {
+    return unary(pExpr->op.type, evaluate(pExpr->right), pExpr->op.line);
+}
+
+cpplox::Value cpplox::Interpreter::evalBinaryExpr(const AST::pBinaryExpr &pExpr) {
+    const Pending pending(temporaries);
+    const Value left = evaluate(pExpr->left);
+    temporaries.push_back(left);
+    const Value right = evaluate(pExpr->right);
+    return binary(pExpr->op.type, left, right, pExpr->op.line);
+}
 
-cpplox::Object cpplox::Interpreter::evalUnaryExpr(const AST::pUnaryExpr &pExpr) {
-    const Object right = evaluate(pExpr->right);
-    switch (pExpr->op.type) {
+cpplox::Value cpplox::Interpreter::unary(TokenType op, Value right, std::uint32_t line) {
+    switch (op) {
         case TokenType::BANG:
             return !isTruthy(right);
         case TokenType::MINUS:
-            checkNumberOperand(pExpr->op, right);
-            return -std::get<double>(right);
+            checkNumberOperand(line, right);
+            return -right.asNumber();
         // Unreachable
         default:
-            return Object{};
+            return Value{};
     }
 }
 
-cpplox::Object cpplox::Interpreter::evalBinaryExpr(const AST::pBinaryExpr &pExpr) {
-    const Object left = evaluate(pExpr->left);
-    const Object right = evaluate(pExpr->right);
-    switch (pExpr->op.type) {
+cpplox::Value cpplox::Interpreter::binary(TokenType op, Value left, Value right, std::uint32_t line) {
+    switch (op) {
         case TokenType::EQUAL_EQUAL:
             return left == right;
         case TokenType::BANG_EQUAL:
             return left != right;
         case TokenType::GREATER:
-            checkNumberOperands(pExpr->op, left, right);
-            return std::get<double>(left) > std::get<double>(right);
+            checkNumberOperands(line, left, right);
+            return left.asNumber() > right.asNumber();
         case TokenType::GREATER_EQUAL:
-            checkNumberOperands(pExpr->op, left, right);
-            return std::get<double>(left) >= std::get<double>(right);
+            checkNumberOperands(line, left, right);
+            return left.asNumber() >= right.asNumber();
         case TokenType::LESS:
-            checkNumberOperands(pExpr->op, left, right);
-            return std::get<double>(left) < std::get<double>(right);
+            checkNumberOperands(line, left, right);
+            return left.asNumber() < right.asNumber();
         case TokenType::LESS_EQUAL:
-            checkNumberOperands(pExpr->op, left, right);
-            return std::get<double>(left) <= std::get<double>(right);
+            checkNumberOperands(line, left, right);
+            return left.asNumber() <= right.asNumber();
         case TokenType::MINUS:
-            checkNumberOperands(pExpr->op, left, right);
-            return std::get<double>(left) - std::get<double>(right);
+            checkNumberOperands(line, left, right);
+            return left.asNumber() - right.asNumber();
         case TokenType::SLASH:
-            checkNumberOperands(pExpr->op, left, right);
-            return std::get<double>(left) / std::get<double>(right);
+            checkNumberOperands(line, left, right);
+            return left.asNumber() / right.asNumber();
         case TokenType::STAR:
-            checkNumberOperands(pExpr->op, left, right);
-            return std::get<double>(left) * std::get<double>(right);
+            checkNumberOperands(line, left, right);
+            return left.asNumber() * right.asNumber();
         case TokenType::PLUS:
-            if (std::holds_alternative<double>(left) &&
-                std::holds_alternative<double>(right))
-                return std::get<double>(left) + std::get<double>(right);
-            if (std::holds_alternative<std::string>(left) &&
-                std::holds_alternative<std::string>(right))
-                return std::get<std::string>(left) + std::get<std::string>(right);
-            throw InterpretErr(Meta::sourceFile, pExpr->op.line, "Operands must be two numbers or two strings.");
+            if (left.isNumber() && right.isNumber())
+                return left.asNumber() + right.asNumber();
+            if (left.isString() && right.isString())
+                return Heap::global().string(left.asString()->chars + right.asString()->chars);
+            throw InterpretErr(Meta::sourceFile, static_cast<int>(line), "Operands must be two numbers or two strings.");
 
         // Unreachable.
         default:
-            return Object{};
+            return Value{};
     }
 }
 
-cpplox::Object cpplox::Interpreter::evalCallExpr(const AST::pCallExpr &pExpr) {
-    const Object callee = evaluate(pExpr->callee);
+cpplox::Value cpplox::Interpreter::evalCallExpr(const AST::pCallExpr &pExpr) {
+    // the callee and the arguments evaluated so far stay reachable while the others run
+    const Pending pending(temporaries);
+    const Value callee = evaluate(pExpr->callee);
+    temporaries.push_back(callee);
 
-    std::vector<Object> arguments;
+    std::vector<Value> arguments;
 
-    std::for_each(pExpr->arguments.begin(), pExpr->arguments.end(), [this, &arguments](const AST::pExpr &p)-> void { arguments.emplace_back(evaluate(p)); });
-    // TODO
-    const pCallable func = std::get<pCallable>(callee);
-    return func->call(*this, arguments);
+    std::for_each(pExpr->arguments.begin(), pExpr->arguments.end(), [this, &arguments](const AST::pExpr &p)-> void {
+        arguments.emplace_back(evaluate(p));
+        temporaries.push_back(arguments.back());
+    });
+    return checkCall(callee, arguments.size(), pExpr->paren.line)->call(*this, arguments);
 }
 
-cpplox::Object cpplox::Interpreter::evalVariableExpr(const AST::pVariableExpr &pExpr) { return environment->get(pExpr->name); }
+cpplox::Value cpplox::Interpreter::evalVariableExpr(const AST::pVariableExpr &pExpr) { return lookUp(pExpr->binding, pExpr->name.line); }
+
+cpplox::Value cpplox::Interpreter::lookUp(const AST::Binding &binding, int line) {
+    if (binding.isGlobal()) return globals.get(binding.slot, line);
+    const Value value = slot(binding);
+    return binding.boxed ? value.asBox()->value : value;
+}
+
+void cpplox::Interpreter::define(const AST::Binding &binding, Value value) {
+    if (binding.isGlobal()) globals.define(binding.slot, value);
+    else if (binding.boxed) slot(binding) = Heap::global().make<Box>(value);
+    else slot(binding) = value;
+}
+
+void cpplox::Interpreter::assign(const AST::Binding &binding, int line, Value value) {
+    if (binding.isGlobal()) globals.assign(binding.slot, line, value);
+    else if (binding.boxed) slot(binding).asBox()->value = value;
+    else slot(binding) = value;
+}
 
-bool cpplox::Interpreter::isTruthy(const Object &obj) const {
-    if (std::holds_alternative<std::monostate>(obj)) return false;
-    if (std::holds_alternative<bool>(obj)) { return std::get<bool>(obj); }
-    return true;
+cpplox::Callable *cpplox::Interpreter::checkCall(Value callee, std::size_t count, std::uint32_t line) {
+    if (!callee.isCallable()) throw InterpretErr(Meta::sourceFile, static_cast<int>(line), "Can only call functions and classes.");
+    Callable *callable = callee.asCallable();
+    if (static_cast<std::size_t>(callable->arity()) != count)
+        throw InterpretErr(Meta::sourceFile, static_cast<int>(line),
+                           "Expected " + std::to_string(callable->arity()) + " arguments but got " + std::to_string(count) + ".");
+    return callable;
 }
 
-void cpplox::Interpreter::checkNumberOperand(const Token &op, const Object &operand) {
-    if (std::holds_alternative<double>(operand)) return;
-    throw InterpretErr(Meta::sourceFile, op.line, "Operand must be a number.");
+void cpplox::Interpreter::checkNumberOperand(std::uint32_t line, Value operand) {
+    if (operand.isNumber()) return;
+    throw InterpretErr(Meta::sourceFile, static_cast<int>(line), "Operand must be a number.");
 }
 
-void cpplox::Interpreter::checkNumberOperands(const Token &op, const Object &left, const Object &right) {
-    if (std::holds_alternative<double>(left) &&
-        std::holds_alternative<double>(right))
+void cpplox::Interpreter::checkNumberOperands(std::uint32_t line, Value left, Value right) {
+    if (left.isNumber() && right.isNumber())
         return;
-    throw InterpretErr(Meta::sourceFile, op.line, "Operands must be numbers.");
+    throw InterpretErr(Meta::sourceFile, static_cast<int>(line), "Operands must be numbers.");
 }
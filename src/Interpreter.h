@@ -3,50 +3,137 @@
 
 #include "Errors.h"
 #include "Expr.h"
+#include "FlatAst.h"
+#include "Heap.h"
 #include "Logger.h"
 #include "Object.h"
 #include "Stmt.h"
 #include "Environment.h"
+#include <cstdint>
 #include <memory>
 #include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
 #include <vector>
 
 namespace cpplox {
     using InterpretErr = Errors::Err;
 
-    class Interpreter {
+    // How a statement finished. A return ends every statement around it up
+    // to the function body, each handing its Completion on to the one that
+    // ran it: nothing is thrown, so a call pays no stack unwinding.
+    struct Completion {
+        bool returned = false;
+        // what was returned, nil for a bare `return;`
+        Value value;
+    };
+
+    class Interpreter : private Heap::Roots {
     public:
         Interpreter();
+        Interpreter(const Interpreter &) = delete;
+        Interpreter &operator=(const Interpreter &) = delete;
+        ~Interpreter();
         void interpret(const std::vector<AST::pStmt> &statements);
-        Object evaluate(const AST::pExpr &pExpr);
-        void execute(const AST::pStmt &pStmt);
-        pEnv globals{new Environment()};
+        Value evaluate(const AST::pExpr &pExpr);
+        Completion execute(const AST::pStmt &pStmt);
+        Globals globals;
 
-        void executeBlock(const std::vector<AST::pStmt> &statements, pEnv blockEnv);
+        Completion executeBlock(Span<AST::pStmt> statements, pEnv blockEnv);
+        // parses, optimizes and resolves the body of a function on its first call,
+        // see AST::LazyBody; throws an InterpretErr if that reports an error
+        void parseBody(const AST::FuncStmt &function);
+
+        // the same walk over the flat form of a program, see FlatInterpreter.cpp
+        void interpret(const flat::Tree &tree);
+        Value evaluate(const flat::Tree &tree, flat::Index expr);
+        Completion execute(const flat::Tree &tree, flat::Index stmt);
+        Completion executeBlock(const flat::Tree &tree, Span<flat::Index> statements, pEnv blockEnv);
 
     private:
-        pEnv environment = globals;
+        // the innermost local scope; none at the top level
+        pEnv environment;
+        // values an expression still needs while a call in it runs, which may collect
+        std::vector<Value> temporaries;
+        // the String of every string literal evaluated so far, by its characters;
+        // made on the first evaluation and kept as long as the Interpreter
+        std::unordered_map<std::string_view, Value> literals;
+
+        // drops what was pushed on temporaries since it was made
+        class Pending {
+        public:
+            explicit Pending(std::vector<Value> &temporaries) : temporaries(temporaries), size(temporaries.size()) {}
+            ~Pending() { temporaries.resize(size); }
+
+        private:
+            std::vector<Value> &temporaries;
+            const std::size_t size;
+        };
+
+        // makes a block's Environment the innermost one until the block is left, however it is
+        class Scope {
+        public:
+            Scope(pEnv &environment, pEnv blockEnv) : environment(environment), previous(std::exchange(environment, std::move(blockEnv))) {}
+            ~Scope() { environment = std::move(previous); }
+
+        private:
+            pEnv &environment;
+            pEnv previous;
+        };
+
+        void markRoots(Heap &heap) override;
+        // a statement boundary, where nothing but the roots hold Values
+        void safePoint() {
+            if (Heap::global().wantsCollection()) Heap::global().collect();
+        }
 
-        void evalBlockStmt(const AST::pBlockStmt &pStmt);
+        // the String for a string literal, shared by every evaluation of it
+        Value literal(std::string_view chars);
+
+        // the slot of a local, which holds its Box if it has one
+        Value &slot(const AST::Binding &binding) { return environment->at(binding.depth, binding.slot); }
+        // the variable a resolved name refers to
+        Value lookUp(const AST::Binding &binding, int line);
+        void define(const AST::Binding &binding, Value value);
+        void assign(const AST::Binding &binding, int line, Value value);
+
+        Completion evalBlockStmt(const AST::pBlockStmt &pStmt);
         void evalExpressionStmt(const AST::pExpressionStmt &pStmt);
         void evalFunctionStmt(const AST::pFunctionStmt &pStmt);
-        void evalIfStmt(const AST::pIfStmt &pStmt);
+        Completion evalIfStmt(const AST::pIfStmt &pStmt);
         void evalPrintStmt(const AST::pPrintStmt &pStmt);
+        Completion evalReturnStmt(const AST::pReturnStmt &pStmt);
         void evalVarStmt(const AST::pVarStmt &pStmt);
-        void evalWhileStmt(const AST::pWhileStmt &pStmt);
-
-        Object evalAssignExpr(const AST::pAssignExpr &pExpr);
-        Object evalBinaryExpr(const AST::pBinaryExpr &pExpr);
-        Object evalCallExpr(const AST::pCallExpr &pExpr);
-        Object evalGroupingExpr(const AST::pGroupingExpr &pExpr);
-        Object evalLiteralExpr(const AST::pLiteralExpr &pExpr);
-        Object evalUnaryExpr(const AST::pUnaryExpr &pExpr);
-        Object evalVariableExpr(const AST::pVariableExpr &pExpr);
-        Object evalLogicalExpr(const AST::pLogicalExpr &pExpr);
-
-        bool isTruthy(const Object &obj) const;
-        void checkNumberOperand(const Token &op, const Object &operand);
-        void checkNumberOperands(const Token &op, const Object &left, const Object &right);
+        Completion evalWhileStmt(const AST::pWhileStmt &pStmt);
+
+        Value evalAssignExpr(const AST::pAssignExpr &pExpr);
+        Value evalBinaryExpr(const AST::pBinaryExpr &pExpr);
+        Value evalCallExpr(const AST::pCallExpr &pExpr);
+        Value evalGroupingExpr(const AST::pGroupingExpr &pExpr);
+        Value evalLiteralExpr(const AST::pLiteralExpr &pExpr);
+        Value evalUnaryExpr(const AST::pUnaryExpr &pExpr);
+        Value evalVariableExpr(const AST::pVariableExpr &pExpr);
+        Value evalLogicalExpr(const AST::pLogicalExpr &pExpr);
+
+        void evalFlatFunction(const flat::Tree &tree, flat::Index stmt);
+        Value evalFlatAssign(const flat::Tree &tree, flat::Index expr);
+        Value evalFlatBinary(const flat::Tree &tree, flat::Index expr);
+        Value evalFlatCall(const flat::Tree &tree, flat::Index expr);
+        Value evalFlatLogical(const flat::Tree &tree, flat::Index expr);
+
+    public:
+        // operators shared by both walks and the Optimizer; they throw an
+        // InterpretErr at line when the operands have the wrong types
+        static Value unary(TokenType op, Value right, std::uint32_t line);
+        static Value binary(TokenType op, Value left, Value right, std::uint32_t line);
+        static bool isTruthy(Value value) { return value.isTruthy(); }
+        // the callable to call with count arguments, or a runtime error at line
+        static Callable *checkCall(Value callee, std::size_t count, std::uint32_t line);
+
+    private:
+        static void checkNumberOperand(std::uint32_t line, Value operand);
+        static void checkNumberOperands(std::uint32_t line, Value left, Value right);
     };
 }// namespace cpplox
 
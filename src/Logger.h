@@ -2,6 +2,7 @@
 #define CPPLOX_LOGGER_H
 
 #include "Errors.h"
+#include <array>
 #include <iostream>
 #include <mutex>
 #include <sstream>
@@ -0,0 +1,356 @@
+#include "LoopHoister.h"
+
+#include <type_traits>
+
+namespace {
+
+    // arithmetic yields a number or a string, so its cached value is never falsy
+    bool isArithmetic(cpplox::TokenType type) {
+        return type == cpplox::TokenType::PLUS || type == cpplox::TokenType::MINUS || type == cpplox::TokenType::STAR ||
+               type == cpplox::TokenType::SLASH;
+    }
+
+    // worth a temporary: arithmetic, but not the negation of a single variable,
+    // whose cached value would cost as much to read as to recompute
+    bool isWorthCaching(const cpplox::AST::pExpr &pExpr) {
+        if (const auto *grouping = std::get_if<cpplox::AST::pGroupingExpr>(&pExpr)) return isWorthCaching((*grouping)->expression);
+        if (const auto *binary = std::get_if<cpplox::AST::pBinaryExpr>(&pExpr)) return isArithmetic((*binary)->op.type);
+        if (const auto *unary = std::get_if<cpplox::AST::pUnaryExpr>(&pExpr))
+            return (*unary)->op.type == cpplox::TokenType::MINUS && !std::holds_alternative<cpplox::AST::pVariableExpr>((*unary)->right);
+        return false;
+    }
+
+    // structural equality of the pure expressions a loop may cache
+    bool same(const cpplox::AST::pExpr &a, const cpplox::AST::pExpr &b) {
+        if (a.index() != b.index()) return false;
+        return std::visit(
+                [&b](auto &&a) -> bool {
+                    using T = std::decay_t<decltype(a)>;
+                    const T &other = std::get<T>(b);
+                    if constexpr (std::is_same_v<T, cpplox::AST::pBinaryExpr> || std::is_same_v<T, cpplox::AST::pLogicalExpr>)
+                        return a->op.type == other->op.type && same(a->left, other->left) && same(a->right, other->right);
+                    if constexpr (std::is_same_v<T, cpplox::AST::pGroupingExpr>) return same(a->expression, other->expression);
+                    if constexpr (std::is_same_v<T, cpplox::AST::pLiteralExpr>) return a->value == other->value;
+                    if constexpr (std::is_same_v<T, cpplox::AST::pUnaryExpr>) return a->op.type == other->op.type && same(a->right, other->right);
+                    if constexpr (std::is_same_v<T, cpplox::AST::pVariableExpr>) return a->name.symbol == other->name.symbol;
+                    return false;
+                },
+                a);
+    }
+
+}// namespace
+
+auto cpplox::LoopHoister::hoist(const std::vector<AST::pStmt> &program) -> std::vector<AST::pStmt> {
+    scopes = AST::Scopes(program);
+    return hoistAll(program);
+}
+
+auto cpplox::LoopHoister::hoistBody(Span<Name> params, const std::vector<AST::pStmt> &body) -> std::vector<AST::pStmt> {
+    scopes = AST::Scopes(params, body);
+    return hoistAll(body);
+}
+
+auto cpplox::LoopHoister::hoistAll(const std::vector<AST::pStmt> &statements) -> std::vector<AST::pStmt> {
+    std::vector<AST::pStmt> hoisted;
+    hoisted.reserve(statements.size());
+    for (const AST::pStmt &statement: statements) hoistInto(hoisted, statement);
+    return hoisted;
+}
+
+auto cpplox::LoopHoister::hoist(Span<AST::pStmt> statements) -> Span<AST::pStmt> {
+    std::vector<AST::pStmt> hoisted;
+    hoisted.reserve(statements.size());
+    bool changed = false;
+    for (const AST::pStmt &statement: statements) changed |= hoistInto(hoisted, statement);
+    return changed ? arena.copy(hoisted) : statements;
+}
+
+bool cpplox::LoopHoister::hoistInto(std::vector<AST::pStmt> &statements, const AST::pStmt &pStmt) {
+    const std::size_t before = statements.size();
+    // the temporaries of a loop are declared right before it, in the same scope
+    if (const auto *loop = std::get_if<AST::pWhileStmt>(&pStmt)) statements.push_back(hoistLoop(*loop, statements));
+    else statements.push_back(hoist(pStmt));
+    return statements.size() != before + 1 || statements.back() != pStmt;
+}
+
+auto cpplox::LoopHoister::hoist(const AST::pStmt &pStmt) -> AST::pStmt {
+    return std::visit(
+            [this](auto &&pStmt) -> AST::pStmt {
+                using T = std::decay_t<decltype(pStmt)>;
+                if constexpr (std::is_same_v<T, AST::pBlockStmt>) {
+                    scopes.enterBlock();
+                    const Span<AST::pStmt> statements = hoist(pStmt->statements);
+                    scopes.leaveBlock();
+                    if (statements.begin() == pStmt->statements.begin()) return pStmt;
+                    return arena.make<AST::BlockStmt>(statements);
+                }
+                if constexpr (std::is_same_v<T, AST::pFunctionStmt>) {
+                    scopes.declare(pStmt->name.symbol);
+                    // a lazy body is hoisted when it is parsed, see Interpreter::parseBody
+                    if (pStmt->lazy) return pStmt;
+                    auto enclosing = scopes.enterFunction(pStmt->params);
+                    const Span<AST::pStmt> body = hoist(pStmt->body);
+                    scopes.leaveFunction(std::move(enclosing));
+                    if (body.begin() == pStmt->body.begin()) return pStmt;
+                    return arena.make<AST::FuncStmt>(pStmt->name, pStmt->params, body);
+                }
+                if constexpr (std::is_same_v<T, AST::pIfStmt>) {
+                    const AST::pStmt thenBranch = hoist(pStmt->thenBranch);
+                    const AST::pStmt elseBranch = hoist(pStmt->elseBranch);
+                    if (thenBranch == pStmt->thenBranch && elseBranch == pStmt->elseBranch) return pStmt;
+                    return arena.make<AST::IfStmt>(pStmt->condition, thenBranch, elseBranch);
+                }
+                if constexpr (std::is_same_v<T, AST::pVarStmt>) scopes.declare(pStmt->name.symbol);
+                if constexpr (std::is_same_v<T, AST::pWhileStmt>) {
+                    // a loop that is the branch or the body of another statement
+                    // gets a block of its own for the temporaries
+                    std::vector<AST::pStmt> statements;
+                    const AST::pStmt loop = hoistLoop(pStmt, statements);
+                    if (statements.empty()) return loop;
+                    statements.push_back(loop);
+                    return arena.make<AST::BlockStmt>(arena.copy(statements));
+                }
+                return pStmt;
+            },
+            pStmt);
+}
+
+auto cpplox::LoopHoister::hoistLoop(const AST::pWhileStmt &pStmt, std::vector<AST::pStmt> &declarations) -> AST::pStmt {
+    Loop loop;
+    effects(pStmt->condition, loop);
+    effects(pStmt->body, loop);
+
+    // outer loops go first, so an expression invariant in several nested loops
+    // is cached by the outermost of them
+    const AST::pExpr condition = settle(rewrite(pStmt->condition, loop), loop);
+    AST::pStmt body = rewrite(pStmt->body, loop);
+
+    // `var $t;` runs on every entry into the loop and so forgets what the last one cached
+    for (const auto &[expr, temporary]: loop.hoisted) {
+        scopes.declare(temporary);
+        declarations.emplace_back(arena.make<AST::VarStmt>(Name{temporary, AST::lineOf(expr)}, nullptr));
+    }
+    body = hoist(body);
+    if (condition == pStmt->condition && body == pStmt->body) return pStmt;
+    return arena.make<AST::WhileStmt>(condition, body);
+}
+
+void cpplox::LoopHoister::effects(const AST::pStmt &pStmt, Loop &loop) const {
+    std::visit(
+            [this, &loop](auto &&pStmt) {
+                using T = std::decay_t<decltype(pStmt)>;
+                if constexpr (std::is_same_v<T, AST::pBlockStmt>)
+                    for (const AST::pStmt &statement: pStmt->statements) effects(statement, loop);
+                if constexpr (std::is_same_v<T, AST::pExpressionStmt> || std::is_same_v<T, AST::pPrintStmt>) effects(pStmt->expression, loop);
+                if constexpr (std::is_same_v<T, AST::pReturnStmt>) effects(pStmt->value, loop);
+                if constexpr (std::is_same_v<T, AST::pFunctionStmt>) {
+                    loop.written.insert(pStmt->name.symbol);
+                    // more than a body can reach, but harmless
+                    for (const AST::pStmt &statement: pStmt->body) effects(statement, loop);
+                }
+                if constexpr (std::is_same_v<T, AST::pIfStmt>) {
+                    effects(pStmt->condition, loop);
+                    effects(pStmt->thenBranch, loop);
+                    effects(pStmt->elseBranch, loop);
+                }
+                if constexpr (std::is_same_v<T, AST::pVarStmt>) {
+                    // declared afresh on every iteration
+                    loop.written.insert(pStmt->name.symbol);
+                    effects(pStmt->initializer, loop);
+                }
+                if constexpr (std::is_same_v<T, AST::pWhileStmt>) {
+                    effects(pStmt->condition, loop);
+                    effects(pStmt->body, loop);
+                }
+            },
+            pStmt);
+}
+
+void cpplox::LoopHoister::effects(const AST::pExpr &pExpr, Loop &loop) const {
+    std::visit(
+            [this, &loop](auto &&pExpr) {
+                using T = std::decay_t<decltype(pExpr)>;
+                if constexpr (std::is_same_v<T, AST::pAssignExpr>) {
+                    loop.written.insert(pExpr->name.symbol);
+                    effects(pExpr->value, loop);
+                }
+                if constexpr (std::is_same_v<T, AST::pBinaryExpr> || std::is_same_v<T, AST::pLogicalExpr>) {
+                    effects(pExpr->left, loop);
+                    effects(pExpr->right, loop);
+                }
+                if constexpr (std::is_same_v<T, AST::pCallExpr>) {
+                    // user functions as well as natives: clock() differs from call to call
+                    loop.calls = true;
+                    effects(pExpr->callee, loop);
+                    for (const AST::pExpr &argument: pExpr->arguments) effects(argument, loop);
+                }
+                if constexpr (std::is_same_v<T, AST::pGroupingExpr>) effects(pExpr->expression, loop);
+                if constexpr (std::is_same_v<T, AST::pUnaryExpr>) effects(pExpr->right, loop);
+            },
+            pExpr);
+}
+
+auto cpplox::LoopHoister::rewrite(Span<AST::pStmt> statements, Loop &loop) -> Span<AST::pStmt> {
+    std::vector<AST::pStmt> rewritten;
+    rewritten.reserve(statements.size());
+    bool changed = false;
+    for (const AST::pStmt &statement: statements) {
+        rewritten.push_back(rewrite(statement, loop));
+        changed |= rewritten.back() != statement;
+    }
+    return changed ? arena.copy(rewritten) : statements;
+}
+
+auto cpplox::LoopHoister::rewrite(const AST::pStmt &pStmt, Loop &loop) -> AST::pStmt {
+    return std::visit(
+            [this, &loop](auto &&pStmt) -> AST::pStmt {
+                using T = std::decay_t<decltype(pStmt)>;
+                if constexpr (std::is_same_v<T, AST::pBlockStmt>) {
+                    const Span<AST::pStmt> statements = rewrite(pStmt->statements, loop);
+                    if (statements.begin() == pStmt->statements.begin()) return pStmt;
+                    return arena.make<AST::BlockStmt>(statements);
+                }
+                if constexpr (std::is_same_v<T, AST::pExpressionStmt>) {
+                    const AST::pExpr expression = settle(rewrite(pStmt->expression, loop), loop);
+                    if (expression == pStmt->expression) return pStmt;
+                    return arena.make<AST::ExprStmt>(expression);
+                }
+                if constexpr (std::is_same_v<T, AST::pIfStmt>) {
+                    const AST::pExpr condition = settle(rewrite(pStmt->condition, loop), loop);
+                    const AST::pStmt thenBranch = rewrite(pStmt->thenBranch, loop);
+                    const AST::pStmt elseBranch = rewrite(pStmt->elseBranch, loop);
+                    if (condition == pStmt->condition && thenBranch == pStmt->thenBranch && elseBranch == pStmt->elseBranch) return pStmt;
+                    return arena.make<AST::IfStmt>(condition, thenBranch, elseBranch);
+                }
+                if constexpr (std::is_same_v<T, AST::pPrintStmt>) {
+                    const AST::pExpr expression = settle(rewrite(pStmt->expression, loop), loop);
+                    if (expression == pStmt->expression) return pStmt;
+                    return arena.make<AST::PrintStmt>(expression);
+                }
+                if constexpr (std::is_same_v<T, AST::pReturnStmt>) {
+                    const AST::pExpr value = settle(rewrite(pStmt->value, loop), loop);
+                    if (value == pStmt->value) return pStmt;
+                    return arena.make<AST::ReturnStmt>(pStmt->keyword, value);
+                }
+                if constexpr (std::is_same_v<T, AST::pVarStmt>) {
+                    const AST::pExpr initializer = settle(rewrite(pStmt->initializer, loop), loop);
+                    if (initializer == pStmt->initializer) return pStmt;
+                    return arena.make<AST::VarStmt>(pStmt->name, initializer);
+                }
+                if constexpr (std::is_same_v<T, AST::pWhileStmt>) {
+                    const AST::pExpr condition = settle(rewrite(pStmt->condition, loop), loop);
+                    const AST::pStmt body = rewrite(pStmt->body, loop);
+                    if (condition == pStmt->condition && body == pStmt->body) return pStmt;
+                    return arena.make<AST::WhileStmt>(condition, body);
+                }
+                // a function body runs in scopes of its own
+                return pStmt;
+            },
+            pStmt);
+}
+
+auto cpplox::LoopHoister::rewrite(const AST::pExpr &pExpr, Loop &loop) -> Rewritten {
+    return std::visit(
+            [this, &loop, &pExpr](auto &&expr) -> Rewritten {
+                using T = std::decay_t<decltype(expr)>;
+                if constexpr (std::is_same_v<T, AST::pAssignExpr>) {
+                    // an outer loop's cache, which is computed once anyway
+                    if (AST::isTemporary(expr->name.symbol)) return {pExpr, false};
+                    const AST::pExpr value = settle(rewrite(expr->value, loop), loop);
+                    if (value == expr->value) return {pExpr, false};
+                    return {arena.make<AST::AssignExpr>(expr->name, value), false};
+                }
+                if constexpr (std::is_same_v<T, AST::pBinaryExpr> || std::is_same_v<T, AST::pLogicalExpr>) {
+                    const Rewritten left = rewrite(expr->left, loop);
+                    const Rewritten right = rewrite(expr->right, loop);
+                    // an invariant subtree comes back as it was, for the caller to cache whole
+                    if (left.invariant && right.invariant) return {pExpr, true};
+                    const AST::pExpr settledLeft = settle(left, loop);
+                    const AST::pExpr settledRight = settle(right, loop);
+                    if (settledLeft == expr->left && settledRight == expr->right) return {pExpr, false};
+                    using Node = std::remove_const_t<std::remove_pointer_t<T>>;
+                    return {arena.make<Node>(settledLeft, expr->op, settledRight), false};
+                }
+                if constexpr (std::is_same_v<T, AST::pCallExpr>) {
+                    const AST::pExpr callee = settle(rewrite(expr->callee, loop), loop);
+                    std::vector<AST::pExpr> arguments;
+                    arguments.reserve(expr->arguments.size());
+                    bool changed = callee != expr->callee;
+                    for (const AST::pExpr &argument: expr->arguments) {
+                        arguments.push_back(settle(rewrite(argument, loop), loop));
+                        changed |= arguments.back() != argument;
+                    }
+                    if (!changed) return {pExpr, false};
+                    return {arena.make<AST::CallExpr>(callee, expr->paren, arena.copy(arguments)), false};
+                }
+                if constexpr (std::is_same_v<T, AST::pGroupingExpr>) {
+                    const Rewritten inner = rewrite(expr->expression, loop);
+                    if (inner.invariant || inner.expr == expr->expression) return {pExpr, inner.invariant};
+                    return {arena.make<AST::GroupingExpr>(inner.expr), false};
+                }
+                if constexpr (std::is_same_v<T, AST::pUnaryExpr>) {
+                    const Rewritten right = rewrite(expr->right, loop);
+                    if (right.invariant || right.expr == expr->right) return {pExpr, right.invariant};
+                    return {arena.make<AST::UnaryExpr>(expr->op, right.expr), false};
+                }
+                if constexpr (std::is_same_v<T, AST::pVariableExpr>) {
+                    // A call can reach the globals, and the locals around the loop only
+                    // through a closure that assigns them.
+                    const Symbol name = expr->name.symbol;
+                    return {pExpr, !loop.written.count(name) && (!loop.calls || scopes.isKeptFromCalls(name))};
+                }
+                // literals, and the missing expression of a bare `var x;`
+                return {pExpr, true};
+            },
+            pExpr);
+}
+
+auto cpplox::LoopHoister::settle(const Rewritten &rewritten, Loop &loop) -> AST::pExpr {
+    return rewritten.invariant ? settleInvariant(rewritten.expr, loop) : rewritten.expr;
+}
+
+auto cpplox::LoopHoister::settleInvariant(const AST::pExpr &pExpr, Loop &loop) -> AST::pExpr {
+    if (isWorthCaching(pExpr)) return cached(pExpr, AST::lineOf(pExpr), loop);
+    // a comparison or a logical operator, whose operands may still be worth it
+    return std::visit(
+            [this, &loop, &pExpr](auto &&expr) -> AST::pExpr {
+                using T = std::decay_t<decltype(expr)>;
+                if constexpr (std::is_same_v<T, AST::pBinaryExpr> || std::is_same_v<T, AST::pLogicalExpr>) {
+                    const AST::pExpr left = settleInvariant(expr->left, loop);
+                    const AST::pExpr right = settleInvariant(expr->right, loop);
+                    if (left == expr->left && right == expr->right) return pExpr;
+                    using Node = std::remove_const_t<std::remove_pointer_t<T>>;
+                    return arena.make<Node>(left, expr->op, right);
+                }
+                if constexpr (std::is_same_v<T, AST::pGroupingExpr>) {
+                    const AST::pExpr inner = settleInvariant(expr->expression, loop);
+                    if (inner == expr->expression) return pExpr;
+                    return arena.make<AST::GroupingExpr>(inner);
+                }
+                if constexpr (std::is_same_v<T, AST::pUnaryExpr>) {
+                    const AST::pExpr right = settleInvariant(expr->right, loop);
+                    if (right == expr->right) return pExpr;
+                    return arena.make<AST::UnaryExpr>(expr->op, right);
+                }
+                return pExpr;
+            },
+            pExpr);
+}
+
+auto cpplox::LoopHoister::cached(const AST::pExpr &pExpr, int line, Loop &loop) -> AST::pExpr {
+    Symbol temporary = 0;
+    bool found = false;
+    for (const auto &[expr, symbol]: loop.hoisted) {
+        if (same(expr, pExpr)) {
+            temporary = symbol;
+            found = true;
+            break;
+        }
+    }
+    if (!found) {
+        temporary = AST::temporary("hoisted", temporaries++);
+        loop.hoisted.emplace_back(pExpr, temporary);
+        exprsHoisted++;
+    }
+    return AST::cached(arena, temporary, pExpr, line);
+}
@@ -0,0 +1,82 @@
+#ifndef CPPLOX_LOOPHOISTER_H
+#define CPPLOX_LOOPHOISTER_H
+
+#include "Arena.h"
+#include "Expr.h"
+#include "Stmt.h"
+#include "Symbol.h"
+#include <cstddef>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+namespace cpplox {
+
+    // Loop-invariant code motion. Arithmetic whose operands no statement of a
+    // loop can change is computed once per entry into the loop instead of once
+    // per iteration: each such expression e becomes
+    //     $t or ($t = e)
+    // with `var $t;` declared right before the while. The first
+    // evaluation still happens where e stood, so a runtime error it raises
+    // comes at the same point as before, and a loop that never reaches e never
+    // computes it. Arithmetic yields numbers and strings, which are always
+    // truthy, so later iterations read $t.
+    // Runs after the Optimizer and before the Resolver; for loops come out of
+    // the Parser as whiles and are covered alike.
+    class LoopHoister {
+    public:
+        explicit LoopHoister(Arena &arena) : arena(arena) {}
+
+        auto hoist(const std::vector<AST::pStmt> &program) -> std::vector<AST::pStmt>;
+        // a function body parsed on its first call, see AST::LazyBody
+        auto hoistBody(Span<Name> params, const std::vector<AST::pStmt> &body) -> std::vector<AST::pStmt>;
+
+        // distinct expressions moved out of a loop
+        std::size_t hoistedExprs() const { return exprsHoisted; }
+
+    private:
+        // what a loop's condition and body may change
+        struct Loop {
+            // assigned or declared anywhere in the loop
+            std::unordered_set<Symbol> written;
+            // a call may run any function, which may assign any global or a local a closure assigns
+            bool calls = false;
+            // the expressions cached so far, with the temporary holding each
+            std::vector<std::pair<AST::pExpr, Symbol>> hoisted;
+        };
+
+        // an expression rewritten for a loop, and whether it is invariant in it
+        struct Rewritten {
+            AST::pExpr expr;
+            bool invariant;
+        };
+
+        Arena &arena;
+        std::size_t exprsHoisted = 0;
+        std::size_t temporaries = 0;
+        AST::Scopes scopes;
+
+        auto hoistAll(const std::vector<AST::pStmt> &statements) -> std::vector<AST::pStmt>;
+        auto hoist(const AST::pStmt &pStmt) -> AST::pStmt;
+        auto hoist(Span<AST::pStmt> statements) -> Span<AST::pStmt>;
+        // appends pStmt hoisted to statements, after the declarations of its
+        // temporaries if it is a loop; false if that is pStmt alone, unchanged
+        bool hoistInto(std::vector<AST::pStmt> &statements, const AST::pStmt &pStmt);
+        auto hoistLoop(const AST::pWhileStmt &pStmt, std::vector<AST::pStmt> &declarations) -> AST::pStmt;
+
+        void effects(const AST::pStmt &pStmt, Loop &loop) const;
+        void effects(const AST::pExpr &pExpr, Loop &loop) const;
+
+        auto rewrite(const AST::pStmt &pStmt, Loop &loop) -> AST::pStmt;
+        auto rewrite(Span<AST::pStmt> statements, Loop &loop) -> Span<AST::pStmt>;
+        auto rewrite(const AST::pExpr &pExpr, Loop &loop) -> Rewritten;
+        // an expression in a position where it stops growing: if it is invariant,
+        // it is cached whole or else its largest parts that are worth it
+        auto settle(const Rewritten &rewritten, Loop &loop) -> AST::pExpr;
+        auto settleInvariant(const AST::pExpr &pExpr, Loop &loop) -> AST::pExpr;
+        auto cached(const AST::pExpr &pExpr, int line, Loop &loop) -> AST::pExpr;
+    };
+
+}// namespace cpplox
+
+#endif// CPPLOX_LOOPHOISTER_H
@@ -5,7 +5,7 @@
 
 namespace Meta {
 
-    static std::string sourceFile;
+    inline std::string sourceFile;
 
 }// namespace Meta
 
@@ -1,29 +1,148 @@
 #ifndef CPPLOX_OBJECT_H
 #define CPPLOX_OBJECT_H
 
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
 #include <iostream>
+#include <limits>
 #include <string>
-#include <variant>
-#include <memory>
+#include <type_traits>
+#include <utility>
 #include <vector>
 
 namespace cpplox {
     class Interpreter;
-    class Function;
+    class Heap;
+    class Object;
+    class String;
     class Callable;
+    class Box;
 
-    using pCallable = std::shared_ptr<Callable>;
-    using pFunction = std::shared_ptr<Function>;
+    // A Lox value in 64 bits. A number is its own double; everything else
+    // hides in the payload of a quiet NaN, which no arithmetic produces:
+    // nil, false and true as small constants, and strings and callables as a
+    // pointer to their Object with the sign bit set. Values are trivially
+    // copyable, the Heap frees the Objects nothing refers to any more.
+    class Value {
+    public:
+        Value() = default;
+        Value(double number) {
+            // NaNs all get the one bit pattern, which can't be mistaken for a boxed value
+            if (number != number) number = std::numeric_limits<double>::quiet_NaN();
+            std::memcpy(&bits, &number, sizeof(bits));
+        }
+        Value(bool boolean) : bits(boolean ? trueBits : falseBits) {}
+        Value(Object *object) : bits(signBit | quietNaN | reinterpret_cast<std::uintptr_t>(object)) {}
+        // any other pointer, a string literal most of all, would convert to bool
+        Value(const void *) = delete;
+
+        bool isNil() const { return bits == nilBits; }
+        bool isBool() const { return (bits | 1) == trueBits; }
+        bool isNumber() const { return (bits & quietNaN) != quietNaN; }
+        bool isObject() const { return (bits & (signBit | quietNaN)) == (signBit | quietNaN); }
+        inline bool isString() const;
+        inline bool isCallable() const;
+
+        bool asBool() const { return bits == trueBits; }
+        double asNumber() const {
+            double number;
+            std::memcpy(&number, &bits, sizeof(number));
+            return number;
+        }
+        Object *asObject() const { return reinterpret_cast<Object *>(bits & ~(signBit | quietNaN)); }
+        inline String *asString() const;
+        inline Callable *asCallable() const;
+        inline Box *asBox() const;
+
+        // nil and false are falsey, everything else is truthy
+        bool isTruthy() const { return bits != nilBits && bits != falseBits; }
+
+        // numbers compare as doubles and strings by their characters, the rest by identity
+        inline bool operator==(const Value &other) const;
+        bool operator!=(const Value &other) const { return !(*this == other); }
+
+    private:
+        static constexpr std::uint64_t signBit = 0x8000000000000000;
+        static constexpr std::uint64_t quietNaN = 0x7ffc000000000000;
+        static constexpr std::uint64_t nilBits = quietNaN | 1;
+        static constexpr std::uint64_t falseBits = quietNaN | 2;
+        static constexpr std::uint64_t trueBits = quietNaN | 3;
+
+        std::uint64_t bits = nilBits;
+    };
+
+    static_assert(sizeof(Value) == 8 && std::is_trivially_copyable_v<Value>);
+    static_assert(!std::is_convertible_v<const char *, Value>);
+
+    // what a Value points to, allocated and freed by the Heap
+    class Object {
+    public:
+        enum class Kind : std::uint8_t {
+            String,
+            Callable,
+            Box,
+        };
+
+        const Kind kind;
+
+        explicit Object(Kind kind) : kind(kind) {}
+        Object(const Object &) = delete;
+        Object &operator=(const Object &) = delete;
+        virtual ~Object() = default;
+
+        // marks the Values this object refers to, see Heap::collect
+        virtual void trace(Heap &) const {}
 
-    using Object = std::variant<std::monostate, std::string, double, bool, pCallable>;
+    private:
+        friend class Heap;
+        bool marked = false;
+        // what the Heap counts against its next collection
+        std::size_t bytes = 0;
+        // every Object of a Heap is on its list
+        Object *next = nullptr;
+    };
 
-    class Callable {
+    class String final : public Object {
     public:
+        const std::string chars;
+
+        explicit String(std::string chars) : Object(Kind::String), chars(std::move(chars)) {}
+    };
+
+    class Callable : public Object {
+    public:
+        Callable() : Object(Kind::Callable) {}
+
         virtual int arity() = 0;
-        virtual Object call(Interpreter &interpreter, const std::vector<Object> &arguments) = 0;
+        virtual Value call(Interpreter &interpreter, const std::vector<Value> &arguments) = 0;
         virtual std::string toString() = 0;
     };
 
+    // A local variable that closures capture and some code assigns, kept out
+    // of the frame so the frame and every closure share it, see
+    // AST::Binding::boxed. A Value only holds one in a variable's slot.
+    class Box final : public Object {
+    public:
+        Value value;
+
+        explicit Box(Value value) : Object(Kind::Box), value(value) {}
+
+        inline void trace(Heap &heap) const override;
+    };
+
+    bool Value::isString() const { return isObject() && asObject()->kind == Object::Kind::String; }
+    bool Value::isCallable() const { return isObject() && asObject()->kind == Object::Kind::Callable; }
+    String *Value::asString() const { return static_cast<String *>(asObject()); }
+    Callable *Value::asCallable() const { return static_cast<Callable *>(asObject()); }
+    Box *Value::asBox() const { return static_cast<Box *>(asObject()); }
+
+    bool Value::operator==(const Value &other) const {
+        if (isNumber() && other.isNumber()) return asNumber() == other.asNumber();
+        if (isString() && other.isString()) return asString()->chars == other.asString()->chars;
+        return bits == other.bits;
+    }
+
     template<class... Ts>
     struct overloaded : Ts... {
         using Ts::operator()...;
@@ -32,15 +151,12 @@ namespace cpplox {
     template<class... Ts>
     overloaded(Ts ...) -> overloaded<Ts...>;
 
-    template<typename T, typename... Ts>
-    std::ostream &operator<<(std::ostream &os, const std::variant<T, Ts...> &v) {
-        std::visit(
-                overloaded{
-                        [&os](std::monostate) { os << "NULL"; },
-                        [&os](const pCallable &p) { os << p->toString(); },
-                        [&os](bool arg) { os << (arg ? "TRUE" : "FALSE"); },
-                        [&os](auto &&arg) { os << arg; }},
-                v);
+    inline std::ostream &operator<<(std::ostream &os, const Value &value) {
+        if (value.isNil()) os << "NULL";
+        else if (value.isBool()) os << (value.asBool() ? "TRUE" : "FALSE");
+        else if (value.isNumber()) os << value.asNumber();
+        else if (value.isString()) os << value.asString()->chars;
+        else os << value.asCallable()->toString();
         return os;
     }
 }// namespace cpplox
@@ -0,0 +1,197 @@
+#include "Optimizer.h"
+#include "Interpreter.h"
+
+#include <cmath>
+#include <type_traits>
+
+namespace {
+
+    const cpplox::AST::LiteralExpr *asLiteral(const cpplox::AST::pExpr &pExpr) {
+        const auto *literal = std::get_if<cpplox::AST::pLiteralExpr>(&pExpr);
+        return literal ? *literal : nullptr;
+    }
+
+    // mirrors Token::EXACT_INTEGER for values computed at compile time
+    bool isExactInteger(double value) { return std::trunc(value) == value && std::fabs(value) < 9007199254740992.0; }
+
+}// namespace
+
+auto cpplox::Optimizer::optimize(const std::vector<AST::pStmt> &program) -> std::vector<AST::pStmt> {
+    std::vector<AST::pStmt> statements;
+    statements.reserve(program.size());
+    for (const AST::pStmt &statement: program) {
+        AST::pStmt optimized = optimize(statement);
+        if (!std::holds_alternative<std::nullptr_t>(optimized)) statements.push_back(optimized);
+    }
+    return statements;
+}
+
+auto cpplox::Optimizer::optimize(Span<AST::pStmt> statements) -> Span<AST::pStmt> {
+    std::vector<AST::pStmt> optimized;
+    optimized.reserve(statements.size());
+    bool changed = false;
+    for (const AST::pStmt &statement: statements) {
+        AST::pStmt result = optimize(statement);
+        changed |= result != statement;
+        if (!std::holds_alternative<std::nullptr_t>(result)) optimized.push_back(result);
+        // nothing after a return in the same list can run
+        if (std::holds_alternative<AST::pReturnStmt>(result) && &statement + 1 != statements.end()) {
+            stmtsPruned += static_cast<std::size_t>(statements.end() - &statement - 1);
+            changed = true;
+            break;
+        }
+    }
+    return changed ? arena.copy(optimized) : statements;
+}
+
+auto cpplox::Optimizer::optimize(const AST::pStmt &pStmt) -> AST::pStmt {
+    return std::visit(
+            [this](auto &&pStmt) -> AST::pStmt {
+                using T = std::decay_t<decltype(pStmt)>;
+                if constexpr (std::is_same_v<T, AST::pBlockStmt>) {
+                    const Span<AST::pStmt> statements = optimize(pStmt->statements);
+                    if (statements.begin() == pStmt->statements.begin()) return pStmt;
+                    return arena.make<AST::BlockStmt>(statements);
+                }
+                if constexpr (std::is_same_v<T, AST::pExpressionStmt>) {
+                    const AST::pExpr expression = optimize(pStmt->expression);
+                    // a constant on its own does nothing
+                    if (asLiteral(expression)) {
+                        stmtsPruned++;
+                        return nullptr;
+                    }
+                    if (expression == pStmt->expression) return pStmt;
+                    return arena.make<AST::ExprStmt>(expression);
+                }
+                if constexpr (std::is_same_v<T, AST::pFunctionStmt>) {
+                    if (pStmt->lazy) {
+                        pStmt->lazy->optimize = true;
+                        return pStmt;
+                    }
+                    const Span<AST::pStmt> body = optimize(pStmt->body);
+                    if (body.begin() == pStmt->body.begin()) return pStmt;
+                    return arena.make<AST::FuncStmt>(pStmt->name, pStmt->params, body);
+                }
+                if constexpr (std::is_same_v<T, AST::pIfStmt>) {
+                    const AST::pExpr condition = optimize(pStmt->condition);
+                    // a branch that isn't a block runs in the enclosing scope anyway,
+                    // so it can take the place of the whole if
+                    if (const AST::LiteralExpr *literal = asLiteral(condition)) {
+                        stmtsPruned++;
+                        return optimize(Interpreter::isTruthy(AST::toValue(literal->value)) ? pStmt->thenBranch : pStmt->elseBranch);
+                    }
+                    const AST::pStmt thenBranch = optimize(pStmt->thenBranch);
+                    const AST::pStmt elseBranch = optimize(pStmt->elseBranch);
+                    if (condition == pStmt->condition && thenBranch == pStmt->thenBranch && elseBranch == pStmt->elseBranch) return pStmt;
+                    return arena.make<AST::IfStmt>(condition, thenBranch, elseBranch);
+                }
+                if constexpr (std::is_same_v<T, AST::pPrintStmt>) {
+                    const AST::pExpr expression = optimize(pStmt->expression);
+                    if (expression == pStmt->expression) return pStmt;
+                    return arena.make<AST::PrintStmt>(expression);
+                }
+                if constexpr (std::is_same_v<T, AST::pReturnStmt>) {
+                    const AST::pExpr value = optimize(pStmt->value);
+                    if (value == pStmt->value) return pStmt;
+                    return arena.make<AST::ReturnStmt>(pStmt->keyword, value);
+                }
+                if constexpr (std::is_same_v<T, AST::pVarStmt>) {
+                    const AST::pExpr initializer = optimize(pStmt->initializer);
+                    if (initializer == pStmt->initializer) return pStmt;
+                    return arena.make<AST::VarStmt>(pStmt->name, initializer);
+                }
+                if constexpr (std::is_same_v<T, AST::pWhileStmt>) {
+                    const AST::pExpr condition = optimize(pStmt->condition);
+                    const AST::LiteralExpr *literal = asLiteral(condition);
+                    if (literal && !Interpreter::isTruthy(AST::toValue(literal->value))) {
+                        stmtsPruned++;
+                        return nullptr;
+                    }
+                    const AST::pStmt body = optimize(pStmt->body);
+                    if (condition == pStmt->condition && body == pStmt->body) return pStmt;
+                    return arena.make<AST::WhileStmt>(condition, body);
+                }
+                return nullptr;
+            },
+            pStmt);
+}
+
+auto cpplox::Optimizer::optimize(const AST::pExpr &pExpr) -> AST::pExpr {
+    return std::visit(
+            [this](auto &&pExpr) -> AST::pExpr {
+                using T = std::decay_t<decltype(pExpr)>;
+                if constexpr (std::is_same_v<T, AST::pAssignExpr>) {
+                    const AST::pExpr value = optimize(pExpr->value);
+                    if (value == pExpr->value) return pExpr;
+                    return arena.make<AST::AssignExpr>(pExpr->name, value);
+                }
+                if constexpr (std::is_same_v<T, AST::pBinaryExpr>) {
+                    const AST::pExpr left = optimize(pExpr->left);
+                    const AST::pExpr right = optimize(pExpr->right);
+                    const AST::LiteralExpr *leftLiteral = asLiteral(left);
+                    const AST::LiteralExpr *rightLiteral = asLiteral(right);
+                    if (leftLiteral && rightLiteral) {
+                        try {
+                            const Value value = Interpreter::binary(pExpr->op.type, AST::toValue(leftLiteral->value),
+                                                                     AST::toValue(rightLiteral->value), pExpr->op.line);
+                            if (AST::pExpr folded = literal(value); !std::holds_alternative<std::nullptr_t>(folded)) return folded;
+                        } catch (const InterpretErr &) {
+                            // left for the interpreter to report at run time
+                        }
+                    }
+                    if (left == pExpr->left && right == pExpr->right) return pExpr;
+                    return arena.make<AST::BinaryExpr>(left, pExpr->op, right);
+                }
+                if constexpr (std::is_same_v<T, AST::pCallExpr>) {
+                    const AST::pExpr callee = optimize(pExpr->callee);
+                    std::vector<AST::pExpr> arguments;
+                    arguments.reserve(pExpr->arguments.size());
+                    bool changed = callee != pExpr->callee;
+                    for (const AST::pExpr &argument: pExpr->arguments) {
+                        arguments.push_back(optimize(argument));
+                        changed |= arguments.back() != argument;
+                    }
+                    if (!changed) return pExpr;
+                    return arena.make<AST::CallExpr>(callee, pExpr->paren, arena.copy(arguments));
+                }
+                // the parser has already checked assignment targets, so a grouping means nothing any more
+                if constexpr (std::is_same_v<T, AST::pGroupingExpr>) return optimize(pExpr->expression);
+                if constexpr (std::is_same_v<T, AST::pLogicalExpr>) {
+                    const AST::pExpr left = optimize(pExpr->left);
+                    if (const AST::LiteralExpr *literal = asLiteral(left)) {
+                        // the operator yields one of its operands as it is
+                        exprsFolded++;
+                        const bool truthy = Interpreter::isTruthy(AST::toValue(literal->value));
+                        if (pExpr->op.type == TokenType::OR ? truthy : !truthy) return left;
+                        return optimize(pExpr->right);
+                    }
+                    const AST::pExpr right = optimize(pExpr->right);
+                    if (left == pExpr->left && right == pExpr->right) return pExpr;
+                    return arena.make<AST::LogicalExpr>(left, pExpr->op, right);
+                }
+                if constexpr (std::is_same_v<T, AST::pUnaryExpr>) {
+                    const AST::pExpr right = optimize(pExpr->right);
+                    if (const AST::LiteralExpr *operand = asLiteral(right)) {
+                        try {
+                            const Value value = Interpreter::unary(pExpr->op.type, AST::toValue(operand->value), pExpr->op.line);
+                            if (AST::pExpr folded = literal(value); !std::holds_alternative<std::nullptr_t>(folded)) return folded;
+                        } catch (const InterpretErr &) {
+                            // left for the interpreter to report at run time
+                        }
+                    }
+                    if (right == pExpr->right) return pExpr;
+                    return arena.make<AST::UnaryExpr>(pExpr->op, right);
+                }
+                return pExpr;
+            },
+            pExpr);
+}
+
+auto cpplox::Optimizer::literal(Value value) -> AST::pExpr {
+    if (value.isCallable()) return nullptr;
+    exprsFolded++;
+    if (value.isNil()) return arena.make<AST::LiteralExpr>(std::monostate{});
+    if (value.isString()) return arena.make<AST::LiteralExpr>(arena.copy(value.asString()->chars));
+    if (value.isNumber()) return arena.make<AST::LiteralExpr>(value.asNumber(), isExactInteger(value.asNumber()));
+    return arena.make<AST::LiteralExpr>(value.asBool());
+}
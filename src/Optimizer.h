@@ -0,0 +1,42 @@
+#ifndef CPPLOX_OPTIMIZER_H
+#define CPPLOX_OPTIMIZER_H
+
+#include "Arena.h"
+#include "Expr.h"
+#include "Stmt.h"
+#include <cstddef>
+#include <vector>
+
+namespace cpplox {
+
+    // Folds constant subexpressions into literals and prunes ifs and whiles whose
+    // conditions are constant, and statements that follow a return. Whatever
+    // would raise a runtime error is left as it was, so the error still comes
+    // from the original node at the original line.
+    // Rewritten nodes are allocated in the arena of the parse; untouched subtrees
+    // are shared with the input.
+    class Optimizer {
+    public:
+        explicit Optimizer(Arena &arena) : arena(arena) {}
+
+        auto optimize(const std::vector<AST::pStmt> &program) -> std::vector<AST::pStmt>;
+
+        // expressions replaced by a literal, and statements removed or replaced by a branch
+        std::size_t foldedExprs() const { return exprsFolded; }
+        std::size_t prunedStmts() const { return stmtsPruned; }
+
+    private:
+        Arena &arena;
+        std::size_t exprsFolded = 0;
+        std::size_t stmtsPruned = 0;
+
+        auto optimize(const AST::pStmt &pStmt) -> AST::pStmt;
+        auto optimize(const AST::pExpr &pExpr) -> AST::pExpr;
+        auto optimize(Span<AST::pStmt> statements) -> Span<AST::pStmt>;
+        // nullptr when the value has no literal form
+        auto literal(Value value) -> AST::pExpr;
+    };
+
+}// namespace cpplox
+
+#endif// CPPLOX_OPTIMIZER_H
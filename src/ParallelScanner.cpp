@@ -0,0 +1,119 @@
+#include "Scanner.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <optional>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+namespace cpplox {
+
+    // Lexes a large source as independent pieces that start right after a '\n'.
+    // Comments, numbers and identifiers can't cross a line break, so a piece
+    // boundary is a lexeme boundary unless a string literal spans it. Each piece
+    // is scanned speculatively as if it started outside a string; stitching
+    // then re-scans, in order, the pieces whose guess was wrong.
+    class ParallelScanner {
+    public:
+        struct Piece {
+            Piece(std::string_view source, std::size_t begin, std::size_t end)
+                : begin(begin), end(end), tokens(source) {}
+
+            const std::size_t begin;
+            const std::size_t end;
+            // where the kept scan started; the speculative scan starts at begin
+            std::size_t from = 0;
+            // where the next piece has to start, see Scanner::scanUntil
+            std::size_t resume = 0;
+            // lines in [begin, end), which don't depend on how the piece is lexed
+            std::uint32_t newlines = 0;
+            // rebuilt along with tokens when the piece is re-scanned
+            std::optional<SymbolTable> symbols;
+            TokenList tokens;
+            // held back until the piece is known to be kept
+            Diagnostics errors;
+        };
+
+        static void scan(std::string_view source, Piece &piece, std::size_t from) {
+            piece.tokens = TokenList(source);
+            piece.errors.clear();
+            Scanner scanner(source, from, piece.symbols.emplace(), piece.errors);
+            piece.from = from;
+            piece.resume = scanner.scanUntil(piece.end, piece.tokens);
+        }
+
+        static auto run(std::string_view source, unsigned threads) -> TokenList {
+            std::deque<Piece> pieces;
+            // a few pieces per thread, so one slow piece doesn't hold up the rest
+            const std::size_t target = std::max<std::size_t>(source.length() / (threads * 4), 64 * 1024);
+            for (std::size_t begin = 0; begin < source.length();) {
+                std::size_t end = std::min(begin + target, source.length());
+                if (const void *newline = std::memchr(source.data() + end, '\n', source.length() - end))
+                    end = static_cast<std::size_t>(static_cast<const char *>(newline) - source.data()) + 1;
+                else
+                    end = source.length();
+                pieces.emplace_back(source, begin, end);
+                begin = end;
+            }
+
+            std::atomic<std::size_t> next{0};
+            const auto work = [&] {
+                for (std::size_t i = next++; i < pieces.size(); i = next++) {
+                    Piece &piece = pieces[i];
+                    piece.newlines = static_cast<std::uint32_t>(std::count(source.begin() + piece.begin, source.begin() + piece.end, '\n'));
+                    scan(source, piece, piece.begin);
+                }
+            };
+            std::vector<std::thread> workers;
+            for (unsigned i = 1; i < std::min<std::size_t>(threads, pieces.size()); i++) workers.emplace_back(work);
+            work();
+            for (std::thread &worker: workers) worker.join();
+
+            return stitch(source, pieces);
+        }
+
+    private:
+        static auto stitch(std::string_view source, std::deque<Piece> &pieces) -> TokenList {
+            TokenList tokens(source);
+            std::size_t count = 1;
+            for (const Piece &piece: pieces) count += piece.tokens.size();
+            tokens.reserve(count);
+
+            // the first byte no kept piece has lexed yet
+            std::size_t expected = 0;
+            // '\n' before the current piece's begin
+            std::uint32_t lines = 0;
+            for (Piece &piece: pieces) {
+                // swallowed whole by a string literal from an earlier piece
+                if (expected >= piece.end) {
+                    lines += piece.newlines;
+                    continue;
+                }
+                if (expected != piece.begin) scan(source, piece, expected);
+
+                const auto lineOffset = lines + static_cast<std::uint32_t>(std::count(source.begin() + piece.begin, source.begin() + piece.from, '\n'));
+                std::vector<Symbol> symbolMap(piece.symbols->size());
+                for (Symbol local = 0; local < symbolMap.size(); local++) symbolMap[local] = intern(piece.symbols->name(local));
+                tokens.append(piece.tokens, lineOffset, symbolMap);
+                for (const Diagnostic &error: piece.errors.errors())
+                    Diagnostics::global().error(error.line + static_cast<int>(lineOffset), error.message);
+
+                expected = piece.resume;
+                lines += piece.newlines;
+            }
+            tokens.push(Token(TokenType::EOF_TOKEN, static_cast<std::uint32_t>(source.length()), 0, lines + 1));
+            return tokens;
+        }
+    };
+
+}// namespace cpplox
+
+auto cpplox::Scanner::scanTokensParallel(std::string_view source, unsigned threads, std::size_t threshold) -> TokenList {
+    if (threads < 2 || source.length() < threshold) return Scanner(source).scanTokens();
+    if (source.length() > UINT32_MAX) throw std::length_error("source files are limited to 4 GiB");
+    return ParallelScanner::run(source, threads);
+}
@@ -1,6 +1,36 @@
 #include "Parser.h"
-#include "Logger.h"
-#include "Meta.h"
+#include <array>
+#include <utility>
+
+namespace {
+
+    using Precedence = cpplox::Parser::Precedence;
+
+    constexpr std::size_t tokenTypes = static_cast<std::size_t>(cpplox::TokenType::EOF_TOKEN) + 1;
+
+    // how tightly each token binds as an infix operator; None for everything else
+    constexpr std::array<Precedence, tokenTypes> infixPrecedences = [] {
+        std::array<Precedence, tokenTypes> table{};
+        const auto set = [&table](cpplox::TokenType type, Precedence precedence) { table[static_cast<std::size_t>(type)] = precedence; };
+        set(cpplox::TokenType::OR, Precedence::Or);
+        set(cpplox::TokenType::AND, Precedence::And);
+        set(cpplox::TokenType::BANG_EQUAL, Precedence::Equality);
+        set(cpplox::TokenType::EQUAL_EQUAL, Precedence::Equality);
+        set(cpplox::TokenType::GREATER, Precedence::Comparison);
+        set(cpplox::TokenType::GREATER_EQUAL, Precedence::Comparison);
+        set(cpplox::TokenType::LESS, Precedence::Comparison);
+        set(cpplox::TokenType::LESS_EQUAL, Precedence::Comparison);
+        set(cpplox::TokenType::MINUS, Precedence::Term);
+        set(cpplox::TokenType::PLUS, Precedence::Term);
+        set(cpplox::TokenType::SLASH, Precedence::Factor);
+        set(cpplox::TokenType::STAR, Precedence::Factor);
+        set(cpplox::TokenType::LEFT_PAREN, Precedence::Call);
+        return table;
+    }();
+
+    Precedence infixPrecedence(cpplox::TokenType type) { return infixPrecedences[static_cast<std::size_t>(type)]; }
+
+}// namespace
 
 // program -> declaration* EOF
 auto cpplox::Parser::parse() -> std::vector<AST::pStmt> {
@@ -11,92 +41,125 @@ auto cpplox::Parser::parse() -> std::vector<AST::pStmt> {
 
 // declaration -> funDecl | varDecl | statement
 auto cpplox::Parser::declaration() -> AST::pStmt {
-    try {
-        if (match(TokenType::FUN)) return function("function");
-        if (match(TokenType::VAR)) return varDeclaration();
-        return statement();
-    } catch (const ParseErr &err) {
-        logger::error(err);
-        synchronize();
-        return nullptr;
-    }
+    Result<AST::pStmt> result;
+    if (match(TokenType::FUN)) result = function("function");
+    else if (match(TokenType::VAR)) result = varDeclaration();
+    else result = statement();
+    if (result) return *result;
+    synchronize();
+    return nullptr;
 }
 
 // funDecl -> "fun" function
 // function -> IDENTIFIER "(" parameters? ")" block
 // parameters -> IDENTIFIER ( "," IDENTIFIER )*
-auto cpplox::Parser::function(const std::string &kind) -> AST::pStmt {
-    Token name = consumeOrError(TokenType::IDENTIFIER, "Expect " + kind + " name.");
-
-    consumeOrError(TokenType::LEFT_PAREN, "Expect '(' after " + kind + " name.");
-    std::vector<Token> parameters;
+auto cpplox::Parser::function(const std::string &kind) -> Result<AST::pStmt> {
+    const Result<Name> name = identifier("Expect " + kind + " name.");
+    if (!name || !consume(TokenType::LEFT_PAREN, "Expect '(' after " + kind + " name.")) return std::nullopt;
+    std::vector<Name> parameters;
     if (!check(TokenType::RIGHT_PAREN)) {
         do {
             if (parameters.size() >= 255) error(peek(), "Can't have more than 255 parameters.");
-            parameters.emplace_back(consumeOrError(TokenType::IDENTIFIER, "Expect parameter name."));
+            const Result<Name> parameter = identifier("Expect parameter name.");
+            if (!parameter) return std::nullopt;
+            parameters.push_back(*parameter);
         } while (match(TokenType::COMMA));
     }
-    consumeOrError(TokenType::RIGHT_PAREN, "Expect ')' after parameters.");
-    consumeOrError(TokenType::LEFT_BRACE, "Expect '{' before " + kind + " body.");
-    std::vector<AST::pStmt> body = block();
-    return std::make_unique<AST::FuncStmt>(std::move(name), std::move(parameters), std::move(body));
+    if (!consume(TokenType::RIGHT_PAREN, "Expect ')' after parameters.") ||
+        !consume(TokenType::LEFT_BRACE, "Expect '{' before " + kind + " body."))
+        return std::nullopt;
+    // a nested function's captures are resolved along with the body around it, so it is parsed with it
+    if (lazyBodies && blocks == 0) {
+        AST::LazyBody *lazy = skipBody();
+        if (!lazy) return std::nullopt;
+        AST::FuncStmt *function = arena.make<AST::FuncStmt>(*name, arena.copy(parameters), Span<AST::pStmt>());
+        function->lazy = lazy;
+        return function;
+    }
+    const Result<std::vector<AST::pStmt>> body = block();
+    if (!body) return std::nullopt;
+    return arena.make<AST::FuncStmt>(*name, arena.copy(parameters), arena.copy(*body));
+}
+
+auto cpplox::Parser::skipBody() -> AST::LazyBody * {
+    const Token open = previous();
+    for (int depth = 1; depth > 0;) {
+        if (isAtEnd()) {
+            error(peek(), "Expect '}' after block.");
+            return nullptr;
+        }
+        const TokenType type = advance().type;
+        if (type == TokenType::LEFT_BRACE) depth++;
+        else if (type == TokenType::RIGHT_BRACE) depth--;
+    }
+    const char *first = tokens.lexeme(open).data();
+    const char *last = tokens.lexeme(previous()).data();
+    return arena.make<AST::LazyBody>(AST::LazyBody{std::string_view(first, static_cast<std::size_t>(last - first) + 1), open.line, &arena});
+}
+
+auto cpplox::Parser::parseBody() -> std::vector<AST::pStmt> {
+    if (!consume(TokenType::LEFT_BRACE, "Expect '{' before function body.")) return {};
+    Result<std::vector<AST::pStmt>> body = block();
+    return body ? std::move(*body) : std::vector<AST::pStmt>();
 }
 
 // varDecl -> "var" IDENTIFIER ( "=" expression )? ";"
-auto cpplox::Parser::varDeclaration() -> AST::pStmt {
-    Token name = consumeOrError(TokenType::IDENTIFIER, "Expect variable name.");
-    AST::pExpr initializer = nullptr;
+auto cpplox::Parser::varDeclaration() -> Result<AST::pStmt> {
+    const Result<Name> name = identifier("Expect variable name.");
+    if (!name) return std::nullopt;
+    Result<AST::pExpr> initializer = AST::pExpr(nullptr);
     if (match(TokenType::EQUAL)) initializer = expression();
-    consumeOrError(TokenType::SEMICOLON, "Expect ';' after variable declaration.");
-    return std::make_unique<AST::VarStmt>(std::move(name), std::move(initializer));
+    if (!initializer || !consume(TokenType::SEMICOLON, "Expect ';' after variable declaration.")) return std::nullopt;
+    return arena.make<AST::VarStmt>(*name, *initializer);
 }
 
-// statement -> exprStmt | forStmt | ifStmt | printStmt | whileStmt | block
-auto cpplox::Parser::statement() -> AST::pStmt {
+// statement -> exprStmt | forStmt | ifStmt | printStmt | returnStmt | whileStmt | block
+auto cpplox::Parser::statement() -> Result<AST::pStmt> {
     if (match(TokenType::FOR)) return forStatement();
     if (match(TokenType::IF)) return ifStatement();
     if (match(TokenType::PRINT)) return printStatement();
+    if (match(TokenType::RETURN)) return returnStatement();
     if (match(TokenType::WHILE)) return whileStatement();
     if (match(TokenType::LEFT_BRACE)) return blockStatement();
     return expressionStatement();
 }
 
 // forStmt -> "for" "(" ( varDecl | exprStmt | ";" ) expression? ";" expression? ")" statement
-auto cpplox::Parser::forStatement() -> AST::pStmt {
-    consumeOrError(TokenType::LEFT_PAREN, "Expect '(' after 'for'.");
+auto cpplox::Parser::forStatement() -> Result<AST::pStmt> {
+    if (!consume(TokenType::LEFT_PAREN, "Expect '(' after 'for'.")) return std::nullopt;
 
-    AST::pStmt initializer;
-    if (match(TokenType::SEMICOLON)) initializer = nullptr;
+    Result<AST::pStmt> initializer;
+    if (match(TokenType::SEMICOLON)) initializer = AST::pStmt(nullptr);
     else if (match(TokenType::VAR)) initializer = varDeclaration();
     else initializer = expressionStatement();
+    if (!initializer) return std::nullopt;
 
-    AST::pExpr condition = nullptr;
+    Result<AST::pExpr> condition = AST::pExpr(nullptr);
     if (!check(TokenType::SEMICOLON)) condition = expression();
+    if (!condition || !consume(TokenType::SEMICOLON, "Expect ';' after loop condition.")) return std::nullopt;
 
-    consumeOrError(TokenType::SEMICOLON, "Expect ';' after loop condition.");
-
-    AST::pExpr increment = nullptr;
+    Result<AST::pExpr> increment = AST::pExpr(nullptr);
     if (!check(TokenType::RIGHT_PAREN)) increment = expression();
+    if (!increment || !consume(TokenType::RIGHT_PAREN, "Expect ')' after for clauses.")) return std::nullopt;
 
-    consumeOrError(TokenType::RIGHT_PAREN, "Expect ')' after for clauses.");
+    Result<AST::pStmt> body = statement();
+    if (!body) return std::nullopt;
 
-    AST::pStmt body = statement();
-
-    if (!std::holds_alternative<std::nullptr_t>(increment)) {
+    if (!std::holds_alternative<std::nullptr_t>(*increment)) {
         std::vector<AST::pStmt> stmts;
-        stmts.push_back(std::move(body));
-        stmts.emplace_back(std::make_unique<AST::ExprStmt>(std::move(increment)));
-        body = std::make_unique<AST::BlockStmt>(std::move(stmts));
+        stmts.push_back(*body);
+        stmts.emplace_back(arena.make<AST::ExprStmt>(*increment));
+        body = arena.make<AST::BlockStmt>(arena.copy(stmts));
     }
 
-    if (std::holds_alternative<std::nullptr_t>(condition)) condition = std::make_unique<AST::LiteralExpr>(true);
-    body = std::make_unique<AST::WhileStmt>(std::move(condition), std::move(body));
+    if (std::holds_alternative<std::nullptr_t>(*condition)) condition = arena.make<AST::LiteralExpr>(true);
+    body = arena.make<AST::WhileStmt>(*condition, *body);
 
-    if (!std::holds_alternative<std::nullptr_t>(initializer)) {
+    if (!std::holds_alternative<std::nullptr_t>(*initializer)) {
         std::vector<AST::pStmt> stmts;
-        stmts.push_back(std::move(initializer));
-        stmts.push_back(std::move(body));
-        body = std::make_unique<AST::BlockStmt>(std::move(stmts));
+        stmts.push_back(*initializer);
+        stmts.push_back(*body);
+        body = arena.make<AST::BlockStmt>(arena.copy(stmts));
     }
 
     return body;
@@ -105,207 +168,206 @@ auto cpplox::Parser::forStatement() -> AST::pStmt {
 // ifStmt -> "if" "(" expression ")" statement ( "else" statement )?
 // the else is bound to the nearest if that precedes it
 // to handle the dangling else problem
-auto cpplox::Parser::ifStatement() -> AST::pStmt {
-    consumeOrError(TokenType::LEFT_PAREN, "Expect '(' after 'if'.");
-    AST::pExpr condition = expression();
-    consumeOrError(TokenType::RIGHT_PAREN, "Expect ')' after if condition.");
-
-    AST::pStmt thenBranch = statement();
-    AST::pStmt elseBranch = nullptr;
+auto cpplox::Parser::ifStatement() -> Result<AST::pStmt> {
+    if (!consume(TokenType::LEFT_PAREN, "Expect '(' after 'if'.")) return std::nullopt;
+    const Result<AST::pExpr> condition = expression();
+    if (!condition || !consume(TokenType::RIGHT_PAREN, "Expect ')' after if condition.")) return std::nullopt;
+
+    const Result<AST::pStmt> thenBranch = statement();
+    if (!thenBranch) return std::nullopt;
+    Result<AST::pStmt> elseBranch = AST::pStmt(nullptr);
     if (match(TokenType::ELSE)) elseBranch = statement();
-    return std::make_unique<AST::IfStmt>(std::move(condition), std::move(thenBranch), std::move(elseBranch));
+    if (!elseBranch) return std::nullopt;
+    return arena.make<AST::IfStmt>(*condition, *thenBranch, *elseBranch);
 }
 
 // printStmt -> "print" expression ";"
-auto cpplox::Parser::printStatement() -> AST::pStmt {
-    AST::pExpr value = expression();
-    consumeOrError(TokenType::SEMICOLON, "Expect ';' after value.");
-    return std::make_unique<AST::PrintStmt>(std::move(value));
+auto cpplox::Parser::printStatement() -> Result<AST::pStmt> {
+    const Result<AST::pExpr> value = expression();
+    if (!value || !consume(TokenType::SEMICOLON, "Expect ';' after value.")) return std::nullopt;
+    return arena.make<AST::PrintStmt>(*value);
 }
 
-// whileStmt -> "while" "(" expression ")" statement
-auto cpplox::Parser::whileStatement() -> AST::pStmt {
-    consumeOrError(TokenType::LEFT_PAREN, "Expect '(' after 'while'.");
-    AST::pExpr condition = expression();
-    consumeOrError(TokenType::RIGHT_PAREN, "Expect ')' after condition.");
-    AST::pStmt body = statement();
+// returnStmt -> "return" expression? ";"
+auto cpplox::Parser::returnStatement() -> Result<AST::pStmt> {
+    const Token keyword = previous();
+    Result<AST::pExpr> value = AST::pExpr(nullptr);
+    if (!check(TokenType::SEMICOLON)) value = expression();
+    if (!value || !consume(TokenType::SEMICOLON, "Expect ';' after return value.")) return std::nullopt;
+    return arena.make<AST::ReturnStmt>(keyword, *value);
+}
 
-    return std::make_unique<AST::WhileStmt>(std::move(condition), std::move(body));
+// whileStmt -> "while" "(" expression ")" statement
+auto cpplox::Parser::whileStatement() -> Result<AST::pStmt> {
+    if (!consume(TokenType::LEFT_PAREN, "Expect '(' after 'while'.")) return std::nullopt;
+    const Result<AST::pExpr> condition = expression();
+    if (!condition || !consume(TokenType::RIGHT_PAREN, "Expect ')' after condition.")) return std::nullopt;
+    const Result<AST::pStmt> body = statement();
+    if (!body) return std::nullopt;
+
+    return arena.make<AST::WhileStmt>(*condition, *body);
 }
 
 // block -> "{" declaration* "}"
-auto cpplox::Parser::blockStatement() -> AST::pStmt { return std::make_unique<AST::BlockStmt>(block()); }
+auto cpplox::Parser::blockStatement() -> Result<AST::pStmt> {
+    const Result<std::vector<AST::pStmt>> statements = block();
+    if (!statements) return std::nullopt;
+    return arena.make<AST::BlockStmt>(arena.copy(*statements));
+}
 
-auto cpplox::Parser::block() -> std::vector<AST::pStmt> {
+// the declarations recover from their own errors; only a missing '}' fails the block
+auto cpplox::Parser::block() -> Result<std::vector<AST::pStmt>> {
     std::vector<AST::pStmt> statements;
+    blocks++;
     while (!check(TokenType::RIGHT_BRACE) && !isAtEnd()) { statements.emplace_back(declaration()); }
-    consumeOrError(TokenType::RIGHT_BRACE, "Expect '}' after block.");
+    blocks--;
+    if (!consume(TokenType::RIGHT_BRACE, "Expect '}' after block.")) return std::nullopt;
     return statements;
 }
 
 // exprStmt -> expression ";"
-auto cpplox::Parser::expressionStatement() -> AST::pStmt {
-    AST::pExpr expr = expression();
-    consumeOrError(TokenType::SEMICOLON, "Expect ';' after expression.");
-    return std::make_unique<AST::ExprStmt>(std::move(expr));
+auto cpplox::Parser::expressionStatement() -> Result<AST::pStmt> {
+    const Result<AST::pExpr> expr = expression();
+    if (!expr || !consume(TokenType::SEMICOLON, "Expect ';' after expression.")) return std::nullopt;
+    return arena.make<AST::ExprStmt>(*expr);
 }
 
 // expression -> assignment
-auto cpplox::Parser::expression() -> AST::pExpr { return assignment(); }
+auto cpplox::Parser::expression() -> Result<AST::pExpr> { return assignment(); }
 
 // assignment -> IDENTIFIER "=" assignment | logic_or
-auto cpplox::Parser::assignment() -> AST::pExpr {
-    AST::pExpr expr = logical_or();
+auto cpplox::Parser::assignment() -> Result<AST::pExpr> {
+    const Result<AST::pExpr> expr = infix(Precedence::Or);
+    if (!expr) return std::nullopt;
 
     if (match(TokenType::EQUAL)) {
         const Token equals = previous();
-        AST::pExpr value = assignment();
+        const Result<AST::pExpr> value = assignment();
+        if (!value) return std::nullopt;
 
-        if (std::holds_alternative<AST::pVariableExpr>(expr)) {
-            Token name = std::get<AST::pVariableExpr>(expr)->name;
-            return std::make_unique<AST::AssignExpr>(std::move(name), std::move(value));
+        if (std::holds_alternative<AST::pVariableExpr>(*expr)) {
+            Name name = std::get<AST::pVariableExpr>(*expr)->name;
+            return arena.make<AST::AssignExpr>(std::move(name), *value);
         }
 
-        auto _ = error(equals, "Invalid assignment target.");
+        // reported, but the parse goes on from here
+        error(equals, "Invalid assignment target.");
     }
 
     return expr;
 }
 
+// The binary levels of the grammar, parsed by precedence climbing:
 // logic_or -> logic_and ( "or" logic_and )*
-auto cpplox::Parser::logical_or() -> AST::pExpr {
-    AST::pExpr expr = logical_and();
-
-    while (match(TokenType::OR)) {
-        const Token op = previous();
-        AST::pExpr right = logical_and();
-        expr = std::make_unique<AST::LogicalExpr>(std::move(expr), op, std::move(right));
-    }
-
-    return expr;
-}
-
 // logic_and -> equality ( "and" equality )*
-auto cpplox::Parser::logical_and() -> AST::pExpr {
-    AST::pExpr expr = equality();
-
-    while (match(TokenType::AND)) {
-        const Token op = previous();
-        AST::pExpr right = equality();
-        expr = std::make_unique<AST::LogicalExpr>(std::move(expr), op, std::move(right));
-    }
-
-    return expr;
-}
-
 // equality -> comparison ( ( "!=" | "==" ) comparison )*
-auto cpplox::Parser::equality() -> AST::pExpr {
-    AST::pExpr expr = comparison();
-    while (match(TokenType::BANG_EQUAL, TokenType::EQUAL_EQUAL)) {
-        Token op = previous();
-        AST::pExpr right = comparison();
-        expr = std::make_unique<AST::BinaryExpr>(std::move(expr), op, std::move(right));
-    }
-    return expr;
-}
-
 // comparison -> term ( ( ">" | ">=" | "<" | "<=" ) term )*
-auto cpplox::Parser::comparison() -> AST::pExpr {
-    AST::pExpr expr = term();
-    while (match(TokenType::GREATER, TokenType::GREATER_EQUAL, TokenType::LESS,
-                 TokenType::LESS_EQUAL)) {
-        Token op = previous();
-        AST::pExpr right = term();
-        expr = std::make_unique<AST::BinaryExpr>(std::move(expr), op, std::move(right));
-    }
-    return expr;
-}
-
 // term -> factor ( ( "-" | "+" ) factor )*
-auto cpplox::Parser::term() -> AST::pExpr {
-    AST::pExpr expr = factor();
-    while (match(TokenType::MINUS, TokenType::PLUS)) {
-        Token op = previous();
-        AST::pExpr right = factor();
-        expr = std::make_unique<AST::BinaryExpr>(std::move(expr), op, std::move(right));
-    }
-    return expr;
-}
-
 // factor -> unary ( ( "/" | "*" ) unary )*
-auto cpplox::Parser::factor() -> AST::pExpr {
-    AST::pExpr expr = unary();
-    while (match(TokenType::SLASH, TokenType::STAR)) {
-        Token op = previous();
-        AST::pExpr right = unary();
-        expr = std::make_unique<AST::BinaryExpr>(std::move(expr), op, std::move(right));
+// call -> primary ( "(" arguments? ")" )*
+// All of them are left-associative, so the right operand binds one level tighter.
+auto cpplox::Parser::infix(Precedence minimum) -> Result<AST::pExpr> {
+    Result<AST::pExpr> expr = unary();
+    while (expr) {
+        const Precedence precedence = infixPrecedence(peek().type);
+        if (precedence == Precedence::None || precedence < minimum) return expr;
+        const Token op = advance();
+        if (precedence == Precedence::Call) {
+            expr = finishCall(*expr);
+            continue;
+        }
+        const Result<AST::pExpr> right = infix(static_cast<Precedence>(static_cast<std::uint8_t>(precedence) + 1));
+        if (!right) return std::nullopt;
+        if (precedence <= Precedence::And) expr = arena.make<AST::LogicalExpr>(*expr, op, *right);
+        else expr = arena.make<AST::BinaryExpr>(*expr, op, *right);
     }
-    return expr;
+    return std::nullopt;
 }
 
 // unary -> ( "!" | "-" ) unary | call
-auto cpplox::Parser::unary() -> AST::pExpr {
-    if (match(TokenType::BANG, TokenType::MINUS)) {
-        Token op = previous();
-        AST::pExpr right = unary();
-        return std::make_unique<AST::UnaryExpr>(op, std::move(right));
-    }
-    return call();
+auto cpplox::Parser::unary() -> Result<AST::pExpr> {
+    const TokenType type = peek().type;
+    if (type != TokenType::BANG && type != TokenType::MINUS) return primary();
+    const Token op = advance();
+    // the operand takes only the calls that follow it
+    const Result<AST::pExpr> right = infix(Precedence::Unary);
+    if (!right) return std::nullopt;
+    return arena.make<AST::UnaryExpr>(op, *right);
 }
 
-// call -> primary ( "(" arguments? ")" )*
 // arguments -> expression ( "," expression )*
-auto cpplox::Parser::call() -> AST::pExpr {
-    AST::pExpr expr = primary();
-    while (true) {
-        if (!match(TokenType::LEFT_PAREN)) break;
-
-        std::vector<AST::pExpr> arguments;
-        if (!check(TokenType::RIGHT_PAREN)) {
-            do {
-                // maximum argument counts
-                if (arguments.size() >= MAX_ARG_LIMIT) { auto _ = error(peek(), "Can't have more than " STRINGIFY(MAX_ARG_LIMIT) " arguments."); }
-                arguments.push_back(expression());
-            } while (match(TokenType::COMMA));
-        }
-        Token paren = consumeOrError(TokenType::RIGHT_PAREN, "Expect ')' after arguments.");
-        expr = std::make_unique<AST::CallExpr>(std::move(expr), std::move(paren), std::move(arguments));
+auto cpplox::Parser::finishCall(AST::pExpr callee) -> Result<AST::pExpr> {
+    std::vector<AST::pExpr> arguments;
+    if (!check(TokenType::RIGHT_PAREN)) {
+        do {
+            // maximum argument counts
+            if (arguments.size() >= MAX_ARG_LIMIT) error(peek(), "Can't have more than " STRINGIFY(MAX_ARG_LIMIT) " arguments.");
+            const Result<AST::pExpr> argument = expression();
+            if (!argument) return std::nullopt;
+            arguments.push_back(*argument);
+        } while (match(TokenType::COMMA));
     }
-    return expr;
+    if (!consume(TokenType::RIGHT_PAREN, "Expect ')' after arguments.")) return std::nullopt;
+    return arena.make<AST::CallExpr>(callee, previous(), arena.copy(arguments));
 }
 
-// the argument list
-
-
 // primary -> NUMBER | STRING | "true" | "false" | "nil" | "(" expression ")" | IDENTIFIER
-auto cpplox::Parser::primary() -> AST::pExpr {
-    if (match(TokenType::FALSE_TOKEN)) return std::make_unique<AST::LiteralExpr>(false);
-    if (match(TokenType::TRUE_TOKEN)) return std::make_unique<AST::LiteralExpr>(true);
-    if (match(TokenType::NIL)) return std::make_unique<AST::LiteralExpr>(std::monostate{});
-    if (match(TokenType::NUMBER, TokenType::STRING)) return std::make_unique<AST::LiteralExpr>(previous().literal);
-    if (match(TokenType::IDENTIFIER)) return std::make_unique<AST::VariableExpr>(previous());
-    if (match(TokenType::LEFT_PAREN)) {
-        AST::pExpr expr = expression();
-        consumeOrError(TokenType::RIGHT_PAREN, "Expect ')' after expression.");
-        return std::make_unique<AST::GroupingExpr>(std::move(expr));
+auto cpplox::Parser::primary() -> Result<AST::pExpr> {
+    switch (peek().type) {
+        case TokenType::FALSE_TOKEN:
+            advance();
+            return arena.make<AST::LiteralExpr>(false);
+        case TokenType::TRUE_TOKEN:
+            advance();
+            return arena.make<AST::LiteralExpr>(true);
+        case TokenType::NIL:
+            advance();
+            return arena.make<AST::LiteralExpr>(std::monostate{});
+        case TokenType::NUMBER:
+            advance();
+            return arena.make<AST::LiteralExpr>(tokens.previousNumber(), previous().isExactInteger());
+        case TokenType::STRING: {
+            // the lexeme still carries its quotes and Lox has no escape sequences
+            const std::string_view lexeme = tokens.lexeme(advance());
+            return arena.make<AST::LiteralExpr>(lexeme.substr(1, lexeme.length() - 2));
+        }
+        case TokenType::IDENTIFIER:
+            advance();
+            return arena.make<AST::VariableExpr>(previousName());
+        case TokenType::LEFT_PAREN: {
+            advance();
+            const Result<AST::pExpr> expr = expression();
+            if (!expr || !consume(TokenType::RIGHT_PAREN, "Expect ')' after expression.")) return std::nullopt;
+            return arena.make<AST::GroupingExpr>(*expr);
+        }
+        default:
+            // does not match any terminals
+            error(peek(), "Expect expression.");
+            return std::nullopt;
     }
-    // does not match any terminals
-    throw error(peek(), "Expect expression.");
 }
 
-cpplox::Token cpplox::Parser::consumeOrError(TokenType type, const std::string &message) {
-    if (check(type)) return advance();
-    throw error(peek(), message);
+bool cpplox::Parser::consume(TokenType type, const std::string &message) {
+    if (check(type)) {
+        advance();
+        return true;
+    }
+    error(peek(), message);
+    return false;
 }
 
-auto cpplox::Parser::error(const Token &token, const std::string &msg) const -> ParseErr {
-    Errors::hadError = true;
-    std::string error = msg;
-    if (token.type == TokenType::EOF_TOKEN) error = " at end: " + error;
-    else error = " at '" + token.lexeme + "': " + error;
-    return ParseErr{Meta::sourceFile, token.line, error};
+void cpplox::Parser::error(const Token &token, const std::string &msg) {
+    if (token.type == TokenType::EOF_TOKEN) diagnostics.error(static_cast<int>(token.line), " at end: " + msg);
+    else diagnostics.error(static_cast<int>(token.line), " at '" + std::string(tokens.lexeme(token)) + "': " + msg);
 }
 
+auto cpplox::Parser::identifier(const std::string &message) -> Result<Name> {
+    if (!consume(TokenType::IDENTIFIER, message)) return std::nullopt;
+    return previousName();
+}
+
+cpplox::Name cpplox::Parser::previousName() { return Name{tokens.previousSymbol(), static_cast<int>(previous().line)}; }
+
 void cpplox::Parser::synchronize() {
     advance();
     // It discard tokens until it thinks it has found a statement boundary.
@@ -348,13 +410,13 @@ bool cpplox::Parser::check(TokenType type) {
     return peek().type == type;
 }
 
-cpplox::Token cpplox::Parser::advance() {
-    if (!isAtEnd()) { ++current; }
+const cpplox::Token &cpplox::Parser::advance() {
+    tokens.advance();
     return previous();
 }
 
 bool cpplox::Parser::isAtEnd() { return peek().type == TokenType::EOF_TOKEN; }
 
-cpplox::Token cpplox::Parser::peek() { return tokens[current]; }
+const cpplox::Token &cpplox::Parser::peek() { return tokens.peek(); }
 
-cpplox::Token cpplox::Parser::previous() { return tokens[current - 1]; }
+const cpplox::Token &cpplox::Parser::previous() { return tokens.previous(); }
@@ -1,10 +1,14 @@
 #ifndef CPPLOX_PARSER_H
 #define CPPLOX_PARSER_H
 
-#include "Errors.h"
+#include "Arena.h"
+#include "Diagnostics.h"
 #include "Expr.h"
 #include "Stmt.h"
 #include "Token.h"
+#include "TokenStream.h"
+#include <cstdint>
+#include <optional>
 #include <string>
 #include <vector>
 
@@ -13,19 +17,46 @@
 
 namespace cpplox {
 
-    using ParseErr = Errors::Err;
-
     class Parser {
     public:
-        explicit Parser(std::vector<Token> tokens)
-            : tokens(std::move(tokens)) {}
+        // Every node of the parse is allocated in arena, which must outlive the
+        // statements. With lazyBodies, the bodies of top-level functions are only
+        // brace-matched and kept as text, see AST::LazyBody; the walk over a
+        // flat::Tree needs them parsed up front.
+        // Syntax errors go to diagnostics, and the statements they occur in come
+        // back as nullptr.
+        Parser(TokenSource &source, Arena &arena, bool lazyBodies = false, Diagnostics &diagnostics = Diagnostics::global())
+            : tokens(source), arena(arena), lazyBodies(lazyBodies), diagnostics(diagnostics) {}
 
         auto parse() -> std::vector<AST::pStmt>;
+        // the statements of a LazyBody's text, braces included
+        auto parseBody() -> std::vector<AST::pStmt>;
+
+        // binding power of the infix operators, loosest first
+        enum class Precedence : std::uint8_t {
+            None,
+            Or,
+            And,
+            Equality,
+            Comparison,
+            Term,
+            Factor,
+            Unary,
+            Call,
+        };
 
     private:
-        std::vector<Token> tokens;
-        // the next token waiting to be parsed
-        int current = 0;
+        // tokens are pulled on demand as parsing goes
+        TokenStream tokens;
+        Arena &arena;
+        const bool lazyBodies;
+        Diagnostics &diagnostics;
+        // how many blocks and function bodies the parse is inside
+        std::uint32_t blocks = 0;
+
+        // empty once the error has been reported; declaration() then synchronizes
+        template<class T>
+        using Result = std::optional<T>;
 
         template<class... T>
         bool match(T ... types);
@@ -33,36 +64,39 @@ namespace cpplox {
         bool isAtEnd();
         void synchronize();
 
-        Token peek();
-        Token previous();
-        Token advance();
-        Token consumeOrError(TokenType type, const std::string &message);
+        const Token &peek();
+        const Token &previous();
+        const Token &advance();
+        // reports message unless the next token is of type
+        bool consume(TokenType type, const std::string &message);
 
         auto declaration() -> AST::pStmt;
-        auto varDeclaration() -> AST::pStmt;
-        auto statement() -> AST::pStmt;
-        auto forStatement() -> AST::pStmt;
-        auto ifStatement() -> AST::pStmt;
-        auto printStatement() -> AST::pStmt;
-        auto whileStatement() -> AST::pStmt;
-        auto expressionStatement() -> AST::pStmt;
-        auto blockStatement() -> AST::pStmt;
-        auto block() -> std::vector<AST::pStmt>;
-        auto function(const std::string &kind) -> AST::pStmt;
+        auto varDeclaration() -> Result<AST::pStmt>;
+        auto statement() -> Result<AST::pStmt>;
+        auto forStatement() -> Result<AST::pStmt>;
+        auto ifStatement() -> Result<AST::pStmt>;
+        auto printStatement() -> Result<AST::pStmt>;
+        auto returnStatement() -> Result<AST::pStmt>;
+        auto whileStatement() -> Result<AST::pStmt>;
+        auto expressionStatement() -> Result<AST::pStmt>;
+        auto blockStatement() -> Result<AST::pStmt>;
+        auto block() -> Result<std::vector<AST::pStmt>>;
+        auto function(const std::string &kind) -> Result<AST::pStmt>;
+        // skips to the brace that closes the one just consumed
+        auto skipBody() -> AST::LazyBody *;
 
-        auto assignment() -> AST::pExpr;
-        auto expression() -> AST::pExpr;
-        auto equality() -> AST::pExpr;
-        auto comparison() -> AST::pExpr;
-        auto term() -> AST::pExpr;
-        auto factor() -> AST::pExpr;
-        auto unary() -> AST::pExpr;
-        auto call() -> AST::pExpr;
-        auto primary() -> AST::pExpr;
-        auto logical_or() -> AST::pExpr;
-        auto logical_and() -> AST::pExpr;
+        auto expression() -> Result<AST::pExpr>;
+        auto assignment() -> Result<AST::pExpr>;
+        // parses operators that bind at least as tightly as minimum
+        auto infix(Precedence minimum) -> Result<AST::pExpr>;
+        auto unary() -> Result<AST::pExpr>;
+        auto finishCall(AST::pExpr callee) -> Result<AST::pExpr>;
+        auto primary() -> Result<AST::pExpr>;
 
-        auto error(const Token &token, const std::string &msg) const -> ParseErr;
+        void error(const Token &token, const std::string &msg);
+        // identifiers leave the token stream as their interned Symbol
+        auto identifier(const std::string &message) -> Result<Name>;
+        auto previousName() -> Name;
     };
 
 }// namespace cpplox
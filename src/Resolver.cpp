@@ -0,0 +1,202 @@
+#include "Resolver.h"
+
+#include <type_traits>
+
+bool cpplox::Resolver::resolve(const std::vector<AST::pStmt> &program) {
+    for (const AST::pStmt &statement: program) resolve(statement);
+    return !hadError;
+}
+
+bool cpplox::Resolver::check(const std::vector<AST::pStmt> &program, Diagnostics &diagnostics) {
+    Arena scratch;
+    Globals globals;
+    return Resolver(scratch, globals, diagnostics).resolve(program);
+}
+
+bool cpplox::Resolver::checkBody(const AST::pFunctionStmt &pStmt, Diagnostics &diagnostics) {
+    Arena scratch;
+    Globals globals;
+    return Resolver(scratch, globals, diagnostics).resolveBody(pStmt);
+}
+
+void cpplox::Resolver::resolve(Span<AST::pStmt> statements) {
+    for (const AST::pStmt &statement: statements) resolve(statement);
+}
+
+void cpplox::Resolver::resolve(const AST::pStmt &pStmt) {
+    std::visit(
+            [this](auto &&pStmt) {
+                using T = std::decay_t<decltype(pStmt)>;
+                if constexpr (std::is_same_v<T, AST::pBlockStmt>) {
+                    beginScope();
+                    resolve(pStmt->statements);
+                    pStmt->slots = endScope();
+                }
+                if constexpr (std::is_same_v<T, AST::pExpressionStmt> || std::is_same_v<T, AST::pPrintStmt>) resolve(pStmt->expression);
+                if constexpr (std::is_same_v<T, AST::pFunctionStmt>) resolveFunction(pStmt);
+                if constexpr (std::is_same_v<T, AST::pIfStmt>) {
+                    resolve(pStmt->condition);
+                    resolve(pStmt->thenBranch);
+                    resolve(pStmt->elseBranch);
+                }
+                if constexpr (std::is_same_v<T, AST::pReturnStmt>) {
+                    if (functions.size() == 1) error(static_cast<int>(pStmt->keyword.line), "Can't return from top-level code.");
+                    resolve(pStmt->value);
+                }
+                if constexpr (std::is_same_v<T, AST::pVarStmt>) {
+                    declare(pStmt->name, pStmt->binding);
+                    resolve(pStmt->initializer);
+                    define(pStmt->name);
+                }
+                if constexpr (std::is_same_v<T, AST::pWhileStmt>) {
+                    resolve(pStmt->condition);
+                    resolve(pStmt->body);
+                }
+            },
+            pStmt);
+}
+
+void cpplox::Resolver::resolveFunction(const AST::pFunctionStmt &pStmt) {
+    // defined before the body, so the function can call itself
+    const std::size_t variable = variables.size();
+    declare(pStmt->name, pStmt->binding);
+    define(pStmt->name);
+    // a lazy body is resolved once it is parsed; only top-level functions have one, with nothing to capture
+    if (!pStmt->lazy) resolveParamsAndBody(pStmt);
+    // the closure is made before the variable holds it, so one that calls itself needs the Box
+    if (variable < variables.size() && variables[variable].captured) variables[variable].mutated = true;
+}
+
+bool cpplox::Resolver::resolveBody(const AST::pFunctionStmt &pStmt) {
+    resolveParamsAndBody(pStmt);
+    return !hadError;
+}
+
+void cpplox::Resolver::resolveParamsAndBody(const AST::pFunctionStmt &pStmt) {
+    functions.emplace_back();
+    beginScope();
+    for (const Name &param: pStmt->params) {
+        declare(param);
+        define(param);
+    }
+    resolve(pStmt->body);
+    const Scope &scope = functions.back().scopes.back();
+    std::vector<std::uint32_t> boxed;
+    for (const Name &param: pStmt->params)
+        if (const Local &local = scope.locals.at(param.symbol); variables[local.variable].boxed()) boxed.push_back(local.slot);
+    pStmt->boxed = arena.copy(boxed);
+    pStmt->slots = endScope();
+    pStmt->captures = arena.copy(functions.back().captures);
+    functions.pop_back();
+}
+
+void cpplox::Resolver::resolve(const AST::pExpr &pExpr) {
+    std::visit(
+            [this](auto &&pExpr) {
+                using T = std::decay_t<decltype(pExpr)>;
+                if constexpr (std::is_same_v<T, AST::pAssignExpr>) {
+                    resolve(pExpr->value);
+                    if (Variable *variable = lookUp(pExpr->name, pExpr->binding)) variable->mutated = true;
+                }
+                if constexpr (std::is_same_v<T, AST::pBinaryExpr> || std::is_same_v<T, AST::pLogicalExpr>) {
+                    resolve(pExpr->left);
+                    resolve(pExpr->right);
+                }
+                if constexpr (std::is_same_v<T, AST::pCallExpr>) {
+                    resolve(pExpr->callee);
+                    for (const AST::pExpr &argument: pExpr->arguments) resolve(argument);
+                }
+                if constexpr (std::is_same_v<T, AST::pGroupingExpr>) resolve(pExpr->expression);
+                if constexpr (std::is_same_v<T, AST::pUnaryExpr>) resolve(pExpr->right);
+                if constexpr (std::is_same_v<T, AST::pVariableExpr>) {
+                    const std::vector<Scope> &scopes = functions.back().scopes;
+                    if (!scopes.empty())
+                        if (const auto local = scopes.back().locals.find(pExpr->name.symbol);
+                            local != scopes.back().locals.end() && !local->second.defined)
+                            error(pExpr->name, "Can't read local variable in its own initializer.");
+                    lookUp(pExpr->name, pExpr->binding);
+                }
+            },
+            pExpr);
+}
+
+void cpplox::Resolver::beginScope() {
+    functions.back().scopes.push_back({{}, 0, static_cast<std::uint32_t>(variables.size())});
+}
+
+std::uint32_t cpplox::Resolver::endScope() {
+    std::vector<Scope> &scopes = functions.back().scopes;
+    const std::uint32_t first = scopes.back().firstVariable;
+    // nothing can refer to these variables any more, so whether they need a Box is settled
+    for (std::size_t i = first; i < variables.size(); i++)
+        if (variables[i].boxed())
+            for (AST::Binding *use: variables[i].uses) use->boxed = true;
+    variables.resize(first);
+    const std::uint32_t slots = scopes.back().slots;
+    scopes.pop_back();
+    return slots;
+}
+
+auto cpplox::Resolver::declare(const Name &name) -> AST::Binding {
+    std::vector<Scope> &scopes = functions.back().scopes;
+    if (scopes.empty()) return {AST::Binding::global, globals.slot(name.symbol)};
+    Scope &scope = scopes.back();
+    const auto [local, added] = scope.locals.try_emplace(name.symbol, Local{scope.slots, false, static_cast<std::uint32_t>(variables.size())});
+    if (!added) {
+        error(name, "Already a variable with this name in this scope.");
+        return {0, local->second.slot};
+    }
+    variables.emplace_back();
+    return {0, scope.slots++};
+}
+
+void cpplox::Resolver::declare(const Name &name, AST::Binding &binding) {
+    binding = declare(name);
+    if (!binding.isGlobal()) variables[functions.back().scopes.back().locals.at(name.symbol).variable].uses.push_back(&binding);
+}
+
+void cpplox::Resolver::define(const Name &name) {
+    std::vector<Scope> &scopes = functions.back().scopes;
+    if (!scopes.empty()) scopes.back().locals[name.symbol].defined = true;
+}
+
+auto cpplox::Resolver::lookUp(const Name &name, AST::Binding &binding) -> Variable * {
+    const std::optional<Found> found = find(name.symbol, functions.size() - 1);
+    if (!found) {
+        binding = {AST::Binding::global, globals.slot(name.symbol)};
+        return nullptr;
+    }
+    binding = found->binding;
+    variables[found->variable].uses.push_back(&binding);
+    return &variables[found->variable];
+}
+
+auto cpplox::Resolver::find(Symbol name, std::size_t function) -> std::optional<Found> {
+    Function &current = functions[function];
+    const std::vector<Scope> &scopes = current.scopes;
+    for (std::size_t i = scopes.size(); i > 0; i--) {
+        const auto &locals = scopes[i - 1].locals;
+        if (const auto local = locals.find(name); local != locals.end())
+            return Found{{static_cast<std::uint32_t>(scopes.size() - i), local->second.slot}, local->second.variable};
+    }
+    // the top level has no function around it
+    if (function == 0) return std::nullopt;
+    const auto outermost = static_cast<std::uint32_t>(scopes.size() - 1);
+    if (const auto captured = current.captured.find(name); captured != current.captured.end())
+        return Found{{outermost, captured->second.slot}, captured->second.variable};
+    const std::optional<Found> enclosing = find(name, function - 1);
+    if (!enclosing) return std::nullopt;
+    // the closure brings it along in a slot of the body's outermost scope
+    variables[enclosing->variable].captured = true;
+    const Local local{current.scopes.front().slots++, true, enclosing->variable};
+    current.captured.emplace(name, local);
+    current.captures.push_back({enclosing->binding, local.slot});
+    return Found{{outermost, local.slot}, local.variable};
+}
+
+void cpplox::Resolver::error(const Name &name, const std::string &message) { error(name.line, message); }
+
+void cpplox::Resolver::error(int line, const std::string &message) {
+    hadError = true;
+    diagnostics.error(line, message);
+}
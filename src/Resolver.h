@@ -0,0 +1,117 @@
+#ifndef CPPLOX_RESOLVER_H
+#define CPPLOX_RESOLVER_H
+
+#include "Arena.h"
+#include "Diagnostics.h"
+#include "Environment.h"
+#include "Expr.h"
+#include "Stmt.h"
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace cpplox {
+
+    // Binds every variable reference and declaration to a (depth, slot) pair,
+    // see AST::Binding, and counts the slots each block and function body needs.
+    // Names found in no enclosing scope are globals and get a slot in globals.
+    // A name a function body finds in an enclosing function becomes one of its
+    // captures, see AST::FuncStmt::captures, and so do those of the functions
+    // in between. A local that is captured and assigned gets boxed.
+    // Runs after the Optimizer, which rebuilds the nodes it rewrites; check
+    // runs before it, so code the passes prune is still checked.
+    class Resolver {
+    public:
+        // the captures of each function go in arena; scope errors go to diagnostics
+        Resolver(Arena &arena, Globals &globals, Diagnostics &diagnostics = Diagnostics::global())
+            : arena(arena), globals(globals), diagnostics(diagnostics) { functions.emplace_back(); }
+
+        // false if a scope error was reported
+        bool resolve(const std::vector<AST::pStmt> &program);
+        // a function body parsed after the rest of the program, see AST::LazyBody
+        bool resolveBody(const AST::pFunctionStmt &pStmt);
+
+        // Reports the scope errors of a program as parsed, before a pass drops
+        // the code they are in. What it leaves in the nodes is for resolve to
+        // overwrite, and no global gets a slot.
+        static bool check(const std::vector<AST::pStmt> &program, Diagnostics &diagnostics = Diagnostics::global());
+        static bool checkBody(const AST::pFunctionStmt &pStmt, Diagnostics &diagnostics = Diagnostics::global());
+
+    private:
+        struct Local {
+            std::uint32_t slot;
+            // false while its own initializer is resolved
+            bool defined;
+            // index into variables
+            std::uint32_t variable;
+        };
+
+        struct Scope {
+            std::unordered_map<Symbol, Local> locals;
+            std::uint32_t slots = 0;
+            // the Variables of its locals start here
+            std::uint32_t firstVariable = 0;
+        };
+
+        // a local, with what it takes to tell whether it needs a Box once its scope ends
+        struct Variable {
+            bool captured = false;
+            // assigned anywhere, or captured before it holds its value
+            bool mutated = false;
+            // every binding that refers to it, in its own function and in closures
+            std::vector<AST::Binding *> uses;
+
+            bool boxed() const { return captured && mutated; }
+        };
+
+        // a function whose body is being resolved, or the top level
+        struct Function {
+            // innermost last; the outermost one of a function holds its parameters
+            std::vector<Scope> scopes;
+            std::vector<AST::Capture> captures;
+            // the captured names, in the slot they got in the outermost scope
+            std::unordered_map<Symbol, Local> captured;
+        };
+
+        // what a name refers to, seen from one function
+        struct Found {
+            AST::Binding binding;
+            std::uint32_t variable;
+        };
+
+        Arena &arena;
+        Globals &globals;
+        Diagnostics &diagnostics;
+        // innermost last, the top level first
+        std::vector<Function> functions;
+        // those of the scopes still open, in the order they were declared
+        std::vector<Variable> variables;
+        bool hadError = false;
+
+        void resolve(const AST::pStmt &pStmt);
+        void resolve(const AST::pExpr &pExpr);
+        void resolve(Span<AST::pStmt> statements);
+        void resolveFunction(const AST::pFunctionStmt &pStmt);
+        void resolveParamsAndBody(const AST::pFunctionStmt &pStmt);
+
+        void beginScope();
+        // the number of slots the scope needed
+        std::uint32_t endScope();
+        // the binding of a new variable in the innermost scope
+        AST::Binding declare(const Name &name);
+        // the same, for a declaration that keeps it in binding
+        void declare(const Name &name, AST::Binding &binding);
+        void define(const Name &name);
+        // binds a reference to name; the Variable it refers to, none for a global
+        Variable *lookUp(const Name &name, AST::Binding &binding);
+        // name as seen from functions[function], capturing it from the ones around if need be
+        std::optional<Found> find(Symbol name, std::size_t function);
+        void error(const Name &name, const std::string &message);
+        void error(int line, const std::string &message);
+    };
+
+}// namespace cpplox
+
+#endif// CPPLOX_RESOLVER_H
@@ -1,29 +1,44 @@
 #include "Runner.h"
+#include "Arena.h"
+#include "Cache.h"
+#include "ClosureCompiler.h"
+#include "Diagnostics.h"
+#include "FlatAst.h"
 #include "Interpreter.h"
 #include "Logger.h"
+#include "LoopHoister.h"
 #include "Meta.h"
+#include "Optimizer.h"
 #include "Parser.h"
+#include "Resolver.h"
 #include "Scanner.h"
+#include "SourceBuffer.h"
+#include "SubexpressionEliminator.h"
+#include "VM.h"
 
 #include <chrono>
 #include <ctime>
-#include <fstream>
+#include <deque>
 #include <iomanip>
 #include <iostream>
+#include <optional>
 #include <string>
 #include <sysexits.h>
 
 static cpplox::Interpreter interpreter;
+// functions declared on one REPL line are called from later ones, so like the
+// SourceBuffers every program's nodes stay alive until exit
+static std::deque<cpplox::Arena> programs;
+static std::deque<cpplox::flat::Tree> flatPrograms;
+static std::deque<cpplox::vm::Program> compiledPrograms;
+static cpplox::vm::VM machine(interpreter);
+static cpplox::closure::Runtime closures(interpreter);
 
-int cpplox::Runner::runScript(const std::string &filename) {
+int cpplox::Runner::runScript(const std::string &filename, const Options &options) {
     Meta::sourceFile = filename;
-    const std::string source = [&]() -> std::string {
+    const std::string_view source = [&]() -> std::string_view {
         try {
-            std::ifstream f(filename, std::ios::in);
-            f.exceptions(std::ifstream::failbit | std::ifstream::badbit);
-            std::string content{std::istreambuf_iterator(f),
-                                std::istreambuf_iterator<char>()};
-            return content;
+            return SourceBuffer::load(filename).view();
         } catch (std::exception &e) {
             std::ostringstream stream;
             stream << "Couldn't open input source file (" << e.what() << ").";
@@ -35,7 +50,22 @@ int cpplox::Runner::runScript(const std::string &filename) {
     if (source.empty())
         return EX_DATAERR;
 
-    run(source);
+    // stdin has no place to keep a .loxc
+    if (options.cache && filename != "-") {
+        // the other engines compile bodies up front, and must not pick up a lazy .loxc
+        Runner::Options compiled = options;
+        compiled.lazyBodies = options.lazyBodies && (options.engine == Engine::Tree || options.engine == Engine::Closure);
+        Cache cache(filename, source, compiled);
+        run(source, options, &cache);
+        if (options.cacheStats) {
+            const Cache::Stats &stats = Cache::stats();
+            std::cerr << "cache " << cache.path() << ": " << stats.hits << " hits, " << stats.misses << " misses, "
+                      << stats.writeFailures << " write failures, " << stats.bytesRead << " bytes read, "
+                      << stats.bytesWritten << " bytes written" << std::endl;
+        }
+    } else {
+        run(source, options, nullptr);
+    }
 
     if (Errors::hadError)
         return EX_DATAERR;
@@ -44,7 +74,7 @@ int cpplox::Runner::runScript(const std::string &filename) {
     return 0;
 }
 
-int cpplox::Runner::runREPL() {
+int cpplox::Runner::runREPL(const Options &options) {
     std::string line;
     const auto in_time_t =
             std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
@@ -55,26 +85,46 @@ int cpplox::Runner::runREPL() {
     std::cout << R"(Type "help" for more information.)" << std::endl;
 
     while (std::cout << ">>> " && std::getline(std::cin, line)) {
-        run(line);
+        run(SourceBuffer::adopt(line).view(), options, nullptr);
         Errors::hadError = false;
+        Diagnostics::global().clear();
     }
     std::cout << std::endl
               << "Goodbye!" << std::endl;
     return 0;
 }
 
-void cpplox::Runner::run(const std::string &source) {
-    Scanner scanner(source);
-    const std::vector<Token> tokens = scanner.scanTokens();
-//    // For now, just print the tokens.
-//    for (const Token &token: tokens) {
-//        std::cout << token << std::endl;
-//    }
-
-    Parser parser(tokens);
-    const auto statements = parser.parse();
-    // Stop if there was a syntax error.
-    if (Errors::hadError)
-        return;
-    interpreter.interpret(statements);
+void cpplox::Runner::run(std::string_view source, const Options &options, Cache *cache) {
+    // a flat::Tree or vm::Program doesn't refer to the nodes it was made from, so those are freed right away
+    Arena scratch;
+    const bool keepNodes = options.engine == Engine::Tree || options.engine == Engine::Closure;
+    Arena &arena = keepNodes ? programs.emplace_back() : scratch;
+    std::vector<AST::pStmt> statements;
+    const bool lazyBodies = options.lazyBodies && keepNodes;
+    if (std::optional<std::vector<AST::pStmt>> cached = cache ? cache->load(arena, interpreter.globals) : std::nullopt) {
+        statements = std::move(*cached);
+    } else {
+        if (source.length() >= options.parallelLexThreshold && options.lexThreads > 1) {
+            // big scripts are lexed up front on all cores, then parsed from the list
+            const TokenList tokens = Scanner::scanTokensParallel(source, options.lexThreads, options.parallelLexThreshold);
+            TokenList::Reader reader(tokens);
+            statements = Parser(reader, arena, lazyBodies).parse();
+        } else {
+            Scanner scanner(source);
+            statements = Parser(scanner, arena, lazyBodies).parse();
+        }
+        // Stop if there was a syntax error.
+        if (Errors::hadError)
+            return;
+        // the passes drop dead code, which mustn't decide whether the program is accepted
+        if ((options.optimize || options.eliminateSubexpressions) && !Resolver::check(statements)) return;
+        if (options.optimize) statements = LoopHoister(arena).hoist(Optimizer(arena).optimize(statements));
+        if (options.eliminateSubexpressions) statements = SubexpressionEliminator(arena).eliminate(statements);
+        if (!Resolver(arena, interpreter.globals).resolve(statements)) return;
+        if (cache) cache->store(statements, interpreter.globals);
+    }
+    if (options.engine == Engine::Flat) interpreter.interpret(flatPrograms.emplace_back(statements));
+    else if (options.engine == Engine::Vm) machine.interpret(compiledPrograms.emplace_back(statements));
+    else if (options.engine == Engine::Closure) closures.interpret(statements);
+    else interpreter.interpret(statements);
 }
@@ -1,16 +1,55 @@
 #ifndef CPPLOX_RUNNER_H
 #define CPPLOX_RUNNER_H
 
+#include <cstddef>
 #include <string>
+#include <string_view>
+#include <thread>
 
 namespace cpplox {
+    class Cache;
+
     class Runner {
     public:
-        static int runScript(const std::string &filename);
-        static int runREPL();
+        // how a parsed program is executed
+        enum class Engine {
+            // walks the arena-allocated AST
+            Tree,
+            // lowers the AST to a flat::Tree and walks that
+            Flat,
+            // compiles the AST to bytecode and runs it on a stack machine, see vm::VM
+            Vm,
+            // compiles each function body to nested C++ closures on its first call, see closure::Compiler
+            Closure,
+        };
+
+        struct Options {
+            // scripts of at least this many bytes are lexed on several threads
+            std::size_t parallelLexThreshold = 16 * 1024 * 1024;
+            unsigned lexThreads = std::thread::hardware_concurrency();
+            Engine engine = Engine::Tree;
+            // fold constants, prune dead branches and hoist loop invariants before
+            // running, see Optimizer and LoopHoister
+            bool optimize = true;
+            // compute repeated subexpressions once, see SubexpressionEliminator
+            bool eliminateSubexpressions = false;
+            // parse function bodies on their first call, see AST::LazyBody;
+            // only the tree and closure engines do, the others parse them up front regardless
+            bool lazyBodies = false;
+            // reuse the compiled form of an unchanged script, see Cache
+            bool cache = true;
+            // where .loxc files go; next to the script when empty
+            std::string cacheDirectory;
+            // print Cache::stats to stderr after the script has run
+            bool cacheStats = false;
+        };
+
+        static int runScript(const std::string &filename, const Options &options);
+        static int runREPL(const Options &options);
 
     private:
-        static void run(const std::string &source);
+        // cache is null for REPL lines and for scripts run with --no-cache
+        static void run(std::string_view source, const Options &options, Cache *cache);
     };
 }// namespace cpplox
 
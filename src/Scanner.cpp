@@ -1,117 +1,142 @@
 #include "Scanner.h"
-#include "Logger.h"
-#include "Meta.h"
-
-cpplox::Scanner::Scanner(std::string source) : source(std::move(source)) {}
-
-auto cpplox::Scanner::scanTokens() -> std::vector<Token> {
-    while (!isAtEnd()) {
-        // We are at the beginning of the next lexeme.
-        start = current;
-        try {
-            scanToken();
-        } catch (const TokenizationErr &err) {
-            Errors::hadError = true;
-            logger::error(err);
+#include "Simd.h"
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <cstdint>
+#include <stdexcept>
+
+cpplox::Scanner::Scanner(std::string_view source, Diagnostics &diagnostics)
+    : source(source), kernels(simd::best()), symbols(SymbolTable::global()), diagnostics(diagnostics) {
+    // tokens address their lexemes with 32-bit offsets
+    if (source.length() > UINT32_MAX) throw std::length_error("source files are limited to 4 GiB");
+}
+
+cpplox::Scanner::Scanner(std::string_view source, int line, Diagnostics &diagnostics) : Scanner(source, diagnostics) { this->line = line; }
+
+cpplox::Scanner::Scanner(std::string_view source, std::size_t offset, SymbolTable &symbols, Diagnostics &diagnostics)
+    : source(source), kernels(simd::best()), current(offset), symbols(symbols), diagnostics(diagnostics) {}
+
+auto cpplox::Scanner::scanTokens() -> TokenList {
+    TokenList tokens(source);
+    Token token;
+    do {
+        token = nextToken();
+        tokens.push(token, literal, identifier);
+    } while (token.type != TokenType::EOF_TOKEN);
+    return tokens;
+}
+
+auto cpplox::Scanner::nextToken() -> Token {
+    while (!isAtEnd())
+        if (auto token = scanLexeme())
+            return *token;
+    return Token(TokenType::EOF_TOKEN, static_cast<std::uint32_t>(source.length()), 0, static_cast<std::uint32_t>(line));
+}
+
+// scans the tokens that start before end into tokens, without an EOF_TOKEN;
+// returns where the next piece has to start, which is past end when a string
+// literal runs over it
+auto cpplox::Scanner::scanUntil(std::size_t end, TokenList &tokens) -> std::size_t {
+    std::size_t resume = end;
+    while (!isAtEnd() && current < end) {
+        if (auto token = scanLexeme()) {
+            tokens.push(*token, literal, identifier);
+            resume = std::max(resume, current);
         }
     }
-    tokens.emplace_back(TokenType::EOF_TOKEN, "", std::monostate{}, line);
-    return tokens;
+    return resume;
+}
+
+auto cpplox::Scanner::scanLexeme() -> std::optional<Token> {
+    // We are at the beginning of the next lexeme.
+    start = current;
+    return scanToken();
 }
 
 bool cpplox::Scanner::isAtEnd() const {
-    return current >= static_cast<int>(source.length());
+    return current >= source.length();
 }
 
-void cpplox::Scanner::scanToken() {
+// returns nothing for whitespace, comments and lexemes with errors
+auto cpplox::Scanner::scanToken() -> std::optional<Token> {
     switch (const char c = advance()) {
         case '(':
-            addToken(TokenType::LEFT_PAREN);
-            break;
+            return makeToken(TokenType::LEFT_PAREN);
         case ')':
-            addToken(TokenType::RIGHT_PAREN);
-            break;
+            return makeToken(TokenType::RIGHT_PAREN);
         case '{':
-            addToken(TokenType::LEFT_BRACE);
-            break;
+            return makeToken(TokenType::LEFT_BRACE);
         case '}':
-            addToken(TokenType::RIGHT_BRACE);
-            break;
+            return makeToken(TokenType::RIGHT_BRACE);
         case ',':
-            addToken(TokenType::COMMA);
-            break;
+            return makeToken(TokenType::COMMA);
         case '.':
-            addToken(TokenType::DOT);
-            break;
+            return makeToken(TokenType::DOT);
         case '-':
-            addToken(TokenType::MINUS);
-            break;
+            return makeToken(TokenType::MINUS);
         case '+':
-            addToken(TokenType::PLUS);
-            break;
+            return makeToken(TokenType::PLUS);
         case ';':
-            addToken(TokenType::SEMICOLON);
-            break;
+            return makeToken(TokenType::SEMICOLON);
         case '*':
-            addToken(TokenType::STAR);
-            break;
+            return makeToken(TokenType::STAR);
 
         case '!':
-            addToken(match('=') ? TokenType::BANG_EQUAL : TokenType::BANG);
-            break;
+            return makeToken(match('=') ? TokenType::BANG_EQUAL : TokenType::BANG);
         case '=':
-            addToken(match('=') ? TokenType::EQUAL_EQUAL : TokenType::EQUAL);
-            break;
+            return makeToken(match('=') ? TokenType::EQUAL_EQUAL : TokenType::EQUAL);
         case '<':
-            addToken(match('=') ? TokenType::LESS_EQUAL : TokenType::LESS);
-            break;
+            return makeToken(match('=') ? TokenType::LESS_EQUAL : TokenType::LESS);
         case '>':
-            addToken(match('=') ? TokenType::GREATER_EQUAL : TokenType::GREATER);
-            break;
+            return makeToken(match('=') ? TokenType::GREATER_EQUAL : TokenType::GREATER);
 
         case '/':
             // A comment goes until the end of the line.
             if (match('/'))
-                while (peek() != '\n' && !isAtEnd())
-                    advance();
+                current = offsetOf(kernels.skipToNewline(at(current), at(source.length())));
             else
-                addToken(TokenType::SLASH);
+                return makeToken(TokenType::SLASH);
             break;
 
+        case '\n':
+            line++;
+            [[fallthrough]];
         case ' ':
         case '\r':
         case '\t':
-            // Ignore whitespace.
-            break;
-        case '\n':
-            line++;
+            // Ignore whitespace, the whole run at once.
+            current = offsetOf(kernels.skipWhitespace(at(current), at(source.length()), line));
             break;
 
         // parse strings
         case '"': {
-            if (auto value = parseStr())
-                addToken(TokenType::STRING, *value);
+            if (parseStr())
+                return makeToken(TokenType::STRING);
             break;
         }
 
         default: {
             // parse digits
             if (isDigit(c)) {
-                if (auto value = parseNum())
-                    addToken(TokenType::NUMBER, *value);
+                if (auto value = parseNum()) {
+                    literal = *value;
+                    return makeToken(TokenType::NUMBER);
+                }
             }
             // parse keywords or identifiers
             else if (isAlpha(c)) {
                 if (const auto type = parseKeywords())
-                    addToken(*type);
-                else
-                    addToken(TokenType::IDENTIFIER);
+                    return makeToken(*type);
+                identifier = symbols.intern(source.substr(start, current - start));
+                return makeToken(TokenType::IDENTIFIER);
             }
             // unknown lexemes
             else
-                throw TokenizationErr(Meta::sourceFile, line, "Unexpected character.");
+                diagnostics.error(line, "Unexpected character.");
         }
     }
+    return std::nullopt;
 }
 
 bool cpplox::Scanner::match(char expected) {
@@ -130,9 +155,9 @@ bool cpplox::Scanner::isAlpha(char c) {
     return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_';
 }
 
-bool cpplox::Scanner::isAlphaNumeric(char c) {
-    return isAlpha(c) || isDigit(c);
-}
+const char *cpplox::Scanner::at(std::size_t offset) const { return source.data() + offset; }
+
+std::size_t cpplox::Scanner::offsetOf(const char *p) const { return static_cast<std::size_t>(p - source.data()); }
 
 char cpplox::Scanner::peek() const {
     if (isAtEnd())
@@ -141,58 +166,61 @@ char cpplox::Scanner::peek() const {
 }
 
 char cpplox::Scanner::peekNext() const {
-    if (current + 1 >= static_cast<int>(source.length()))
+    if (current + 1 >= source.length())
         return '\0';
     return source[current + 1];
 }
 
-auto cpplox::Scanner::parseStr() -> std::optional<std::string> {
-    while (peek() != '"' && !isAtEnd()) {
-        if (peek() == '\n')
-            line++;
-        advance();
-    }
+// the literal keeps its quotes; Parser::primary strips them when it builds the LiteralExpr
+bool cpplox::Scanner::parseStr() {
+    current = offsetOf(kernels.skipToQuote(at(current), at(source.length()), line));
     if (isAtEnd()) {
-        logger::trace(line, source, "Unterminated string.");
-        return std::nullopt;
+        diagnostics.error(line, "Unterminated string.");
+        return false;
     }
 
     // The closing ".
     advance();
 
-    return source.substr(start + 1, current - start - 2);
+    return true;
 }
 
 auto cpplox::Scanner::parseNum() -> std::optional<double> {
     while (isDigit(peek()))
         advance();
+    bool fraction = false;
     // Look for a fractional part.
     if (peek() == '.' && isDigit(peekNext())) {
         // Consume the "."
         advance();
         while (isDigit(peek()))
-            advance();
+            fraction |= advance() != '0';
+    }
+
+    // the lexeme is plain digits with an optional fraction, which from_chars
+    // reads straight out of the source without a copy or the C locale
+    double value = 0;
+    const auto [end, error] = std::from_chars(at(start), at(current), value);
+    if (error == std::errc::result_out_of_range) value = HUGE_VAL;
+    else if (error != std::errc() || end != at(current)) {
+        diagnostics.error(line, "Invalid number.");
+        return std::nullopt;
     }
-    return std::stod(source.substr(start, current - start));
+
+    // every integer below 2^53 is a double; larger literals may have been rounded,
+    // and rounding never takes them below 2^53
+    exactInteger = !fraction && value < 9007199254740992.0;
+    return value;
 }
 
 auto cpplox::Scanner::parseKeywords() -> std::optional<TokenType> {
-    while (isAlphaNumeric(peek()))
-        advance();
-    const std::string text = source.substr(start, current - start);
-    auto type = keywords.find(text);
-    if (type != keywords.end())
-        return (*type).second;
-    return std::nullopt;
+    current = offsetOf(kernels.skipIdentifier(at(current), at(source.length())));
+    return keywords::find(source.substr(start, current - start));
 }
 
 char cpplox::Scanner::advance() { return source[current++]; }
 
-void cpplox::Scanner::addToken(TokenType type) {
-    addToken(type, std::monostate{});
-}
-
-void cpplox::Scanner::addToken(TokenType type, const Object &literal) {
-    std::string text = source.substr(start, current - start);
-    tokens.emplace_back(type, text, literal, line);
+auto cpplox::Scanner::makeToken(TokenType type) const -> Token {
+    const std::uint8_t flags = type == TokenType::NUMBER && exactInteger ? Token::EXACT_INTEGER : 0;
+    return Token(type, static_cast<std::uint32_t>(start), static_cast<std::uint32_t>(current - start), static_cast<std::uint32_t>(line), flags);
 }
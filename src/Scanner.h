@@ -1,50 +1,123 @@
 #ifndef CPPLOX_SCANNER_H
 #define CPPLOX_SCANNER_H
 
-#include "Errors.h"
-#include "Object.h"
+#include "Diagnostics.h"
+#include "Simd.h"
 #include "Token.h"
+#include "TokenList.h"
+#include "TokenSource.h"
+#include <array>
 #include <optional>
 #include <string>
-#include <unordered_map>
+#include <string_view>
 #include <vector>
 
 namespace cpplox {
 
-    using TokenizationErr = Errors::Err;
-
-    static const std::unordered_map<std::string, TokenType> keywords = {
-            {"and", TokenType::AND},
-            {"class", TokenType::CLASS},
-            {"else", TokenType::ELSE},
-            {"false", TokenType::FALSE_TOKEN},
-            {"for", TokenType::FOR},
-            {"fun", TokenType::FUN},
-            {"if", TokenType::IF},
-            {"nil", TokenType::NIL},
-            {"or", TokenType::OR},
-            {"print", TokenType::PRINT},
-            {"return", TokenType::RETURN},
-            {"super", TokenType::SUPER},
-            {"this", TokenType::THIS},
-            {"true", TokenType::TRUE_TOKEN},
-            {"var", TokenType::VAR},
-            {"while", TokenType::WHILE}};
-
-    class Scanner {
+    namespace keywords {
+
+        struct Keyword {
+            std::string_view text;
+            TokenType type = TokenType::IDENTIFIER;
+        };
+
+        constexpr std::array<Keyword, 16> list = {{
+                {"and", TokenType::AND},
+                {"class", TokenType::CLASS},
+                {"else", TokenType::ELSE},
+                {"false", TokenType::FALSE_TOKEN},
+                {"for", TokenType::FOR},
+                {"fun", TokenType::FUN},
+                {"if", TokenType::IF},
+                {"nil", TokenType::NIL},
+                {"or", TokenType::OR},
+                {"print", TokenType::PRINT},
+                {"return", TokenType::RETURN},
+                {"super", TokenType::SUPER},
+                {"this", TokenType::THIS},
+                {"true", TokenType::TRUE_TOKEN},
+                {"var", TokenType::VAR},
+                {"while", TokenType::WHILE}}};
+
+        constexpr std::size_t minLength = 2;
+        constexpr std::size_t maxLength = 6;
+        constexpr std::size_t tableSize = 32;
+
+        // first char, last char and length are enough to give every keyword its own slot
+        constexpr std::size_t hash(std::string_view text) {
+            return (static_cast<unsigned char>(text.front()) + 5u * static_cast<unsigned char>(text.back()) + text.length()) & (tableSize - 1);
+        }
+
+        constexpr bool isPerfect() {
+            for (std::size_t i = 0; i < list.size(); i++)
+                for (std::size_t j = i + 1; j < list.size(); j++)
+                    if (hash(list[i].text) == hash(list[j].text)) return false;
+            return true;
+        }
+
+        static_assert(isPerfect(), "keyword hash has a collision, pick new multipliers");
+
+        constexpr std::array<Keyword, tableSize> buildTable() {
+            std::array<Keyword, tableSize> table{};
+            for (const Keyword &keyword: list) table[hash(keyword.text)] = keyword;
+            return table;
+        }
+
+        constexpr std::array<Keyword, tableSize> table = buildTable();
+
+        // one hash and at most one compare, no allocation
+        constexpr std::optional<TokenType> find(std::string_view text) {
+            if (text.length() < minLength || text.length() > maxLength) return std::nullopt;
+            const Keyword &candidate = table[hash(text)];
+            if (candidate.text == text) return candidate.type;
+            return std::nullopt;
+        }
+
+        static_assert(find("while") == TokenType::WHILE && find("or") == TokenType::OR && !find("whale"));
+
+    }// namespace keywords
+
+    class Scanner : public TokenSource {
     public:
-        explicit Scanner(std::string source);
-        auto scanTokens() -> std::vector<Token>;
+        // the source must outlive the tokens, see SourceBuffer
+        explicit Scanner(std::string_view source, Diagnostics &diagnostics = Diagnostics::global());
+        // scans a piece cut out of a larger source, whose first line is line
+        Scanner(std::string_view source, int line, Diagnostics &diagnostics = Diagnostics::global());
+        // scans the whole source up front, ending with EOF_TOKEN
+        auto scanTokens() -> TokenList;
+        // scans just far enough for one more token; EOF_TOKEN once the source is exhausted
+        auto nextToken() -> Token override;
+        double number() const override { return literal; }
+        Symbol symbol() const override { return identifier; }
+        std::string_view lexeme(const Token &token) const override { return token.lexeme(source); }
+
+        // Splits sources of at least threshold bytes at line boundaries and lexes the
+        // pieces on up to `threads` threads; smaller sources are scanned in one go.
+        static auto scanTokensParallel(std::string_view source, unsigned threads, std::size_t threshold) -> TokenList;
 
     private:
-        std::string source;
-        std::vector<Token> tokens;
+        // lexes one piece of a parallel scan, see ParallelScanner.cpp
+        Scanner(std::string_view source, std::size_t offset, SymbolTable &symbols, Diagnostics &diagnostics);
+        auto scanUntil(std::size_t end, TokenList &tokens) -> std::size_t;
+        friend class ParallelScanner;
+
+        std::string_view source;
+        // the scan loops hand whole runs of bytes to the vectorized kernels
+        const simd::Kernels &kernels;
         // the first character in the lexeme being scanned
-        int start = 0;
+        std::size_t start = 0;
         // the character currently being considered
-        int current = 0;
+        std::size_t current = 0;
         // tracks what source line current is on
         int line = 1;
+        // side tables for the most recent NUMBER and IDENTIFIER tokens
+        double literal = 0;
+        bool exactInteger = false;
+        Symbol identifier = 0;
+        // the global table, or a private one while scanning on a worker thread
+        SymbolTable &symbols;
+        // a parallel piece may be thrown away, so its errors go to a sink of its own
+        Diagnostics &diagnostics;
 
         char advance();
         char peek() const;
@@ -53,11 +126,12 @@ namespace cpplox {
         bool match(char expected);
         bool isDigit(char c);
         bool isAlpha(char c);
-        bool isAlphaNumeric(char c);
-        void scanToken();
-        void addToken(TokenType type);
-        void addToken(TokenType type, const Object &literal);
-        auto parseStr() -> std::optional<std::string>;
+        const char *at(std::size_t offset) const;
+        std::size_t offsetOf(const char *p) const;
+        auto scanLexeme() -> std::optional<Token>;
+        auto scanToken() -> std::optional<Token>;
+        auto makeToken(TokenType type) const -> Token;
+        bool parseStr();
         auto parseNum() -> std::optional<double>;
         auto parseKeywords() -> std::optional<TokenType>;
     };
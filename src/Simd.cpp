@@ -0,0 +1,207 @@
+#include "Simd.h"
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define CPPLOX_SIMD_X86 1
+#include <immintrin.h>
+#endif
+
+namespace {
+
+    bool isIdentifierChar(char c) {
+        return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_';
+    }
+
+    const char *scalarSkipWhitespace(const char *p, const char *end, int &lines) {
+        for (; p < end; ++p) {
+            if (*p == '\n') lines++;
+            else if (*p != ' ' && *p != '\t' && *p != '\r') break;
+        }
+        return p;
+    }
+
+    const char *scalarSkipToNewline(const char *p, const char *end) {
+        while (p < end && *p != '\n') ++p;
+        return p;
+    }
+
+    const char *scalarSkipIdentifier(const char *p, const char *end) {
+        while (p < end && isIdentifierChar(*p)) ++p;
+        return p;
+    }
+
+    const char *scalarSkipToQuote(const char *p, const char *end, int &lines) {
+        for (; p < end && *p != '"'; ++p)
+            if (*p == '\n') lines++;
+        return p;
+    }
+
+#ifdef CPPLOX_SIMD_X86
+
+    // Each vector loop builds a bit mask of the bytes that end the run; the
+    // lowest set bit is the answer. The tail shorter than a vector goes scalar.
+
+    // SSE2 is part of the x86-64 baseline, so these need no target attribute
+
+    __m128i sse2IsIdentifier(__m128i v) {
+        // bytes >= 0x80 are negative as signed chars and fall outside every range
+        const __m128i lower = _mm_or_si128(v, _mm_set1_epi8(0x20));
+        const __m128i alpha = _mm_and_si128(_mm_cmpgt_epi8(lower, _mm_set1_epi8('a' - 1)),
+                                            _mm_cmplt_epi8(lower, _mm_set1_epi8('z' + 1)));
+        const __m128i digit = _mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8('0' - 1)),
+                                            _mm_cmplt_epi8(v, _mm_set1_epi8('9' + 1)));
+        const __m128i underscore = _mm_cmpeq_epi8(v, _mm_set1_epi8('_'));
+        return _mm_or_si128(_mm_or_si128(alpha, digit), underscore);
+    }
+
+    const char *sse2SkipWhitespace(const char *p, const char *end, int &lines) {
+        for (; end - p >= 16; p += 16) {
+            const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+            const __m128i newline = _mm_cmpeq_epi8(v, _mm_set1_epi8('\n'));
+            const __m128i blank = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(' ')),
+                                                            _mm_cmpeq_epi8(v, _mm_set1_epi8('\t'))),
+                                               _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('\r')), newline));
+            const unsigned stop = ~static_cast<unsigned>(_mm_movemask_epi8(blank)) & 0xFFFFu;
+            const unsigned newlines = static_cast<unsigned>(_mm_movemask_epi8(newline));
+            if (stop != 0) {
+                const int offset = __builtin_ctz(stop);
+                lines += __builtin_popcount(newlines & ((1u << offset) - 1));
+                return p + offset;
+            }
+            lines += __builtin_popcount(newlines);
+        }
+        return scalarSkipWhitespace(p, end, lines);
+    }
+
+    const char *sse2SkipToNewline(const char *p, const char *end) {
+        for (; end - p >= 16; p += 16) {
+            const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+            const unsigned stop = static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_set1_epi8('\n'))));
+            if (stop != 0) return p + __builtin_ctz(stop);
+        }
+        return scalarSkipToNewline(p, end);
+    }
+
+    const char *sse2SkipIdentifier(const char *p, const char *end) {
+        for (; end - p >= 16; p += 16) {
+            const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+            const unsigned stop = ~static_cast<unsigned>(_mm_movemask_epi8(sse2IsIdentifier(v))) & 0xFFFFu;
+            if (stop != 0) return p + __builtin_ctz(stop);
+        }
+        return scalarSkipIdentifier(p, end);
+    }
+
+    const char *sse2SkipToQuote(const char *p, const char *end, int &lines) {
+        for (; end - p >= 16; p += 16) {
+            const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+            const unsigned stop = static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_set1_epi8('"'))));
+            const unsigned newlines = static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_set1_epi8('\n'))));
+            if (stop != 0) {
+                const int offset = __builtin_ctz(stop);
+                lines += __builtin_popcount(newlines & ((1u << offset) - 1));
+                return p + offset;
+            }
+            lines += __builtin_popcount(newlines);
+        }
+        return scalarSkipToQuote(p, end, lines);
+    }
+
+#define CPPLOX_AVX2 __attribute__((target("avx2,popcnt,bmi")))
+
+    CPPLOX_AVX2 __m256i avx2IsIdentifier(__m256i v) {
+        const __m256i lower = _mm256_or_si256(v, _mm256_set1_epi8(0x20));
+        const __m256i alpha = _mm256_and_si256(_mm256_cmpgt_epi8(lower, _mm256_set1_epi8('a' - 1)),
+                                               _mm256_cmpgt_epi8(_mm256_set1_epi8('z' + 1), lower));
+        const __m256i digit = _mm256_and_si256(_mm256_cmpgt_epi8(v, _mm256_set1_epi8('0' - 1)),
+                                               _mm256_cmpgt_epi8(_mm256_set1_epi8('9' + 1), v));
+        const __m256i underscore = _mm256_cmpeq_epi8(v, _mm256_set1_epi8('_'));
+        return _mm256_or_si256(_mm256_or_si256(alpha, digit), underscore);
+    }
+
+    CPPLOX_AVX2 const char *avx2SkipWhitespace(const char *p, const char *end, int &lines) {
+        for (; end - p >= 32; p += 32) {
+            const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p));
+            const __m256i newline = _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\n'));
+            const __m256i blank = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8(' ')),
+                                                                  _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\t'))),
+                                                  _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('\r')), newline));
+            const unsigned stop = ~static_cast<unsigned>(_mm256_movemask_epi8(blank));
+            const unsigned newlines = static_cast<unsigned>(_mm256_movemask_epi8(newline));
+            if (stop != 0) {
+                const int offset = __builtin_ctz(stop);
+                lines += __builtin_popcount(newlines & ((1u << offset) - 1));
+                return p + offset;
+            }
+            lines += __builtin_popcount(newlines);
+        }
+        return sse2SkipWhitespace(p, end, lines);
+    }
+
+    CPPLOX_AVX2 const char *avx2SkipToNewline(const char *p, const char *end) {
+        for (; end - p >= 32; p += 32) {
+            const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p));
+            const unsigned stop = static_cast<unsigned>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('\n'))));
+            if (stop != 0) return p + __builtin_ctz(stop);
+        }
+        return sse2SkipToNewline(p, end);
+    }
+
+    CPPLOX_AVX2 const char *avx2SkipIdentifier(const char *p, const char *end) {
+        for (; end - p >= 32; p += 32) {
+            const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p));
+            const unsigned stop = ~static_cast<unsigned>(_mm256_movemask_epi8(avx2IsIdentifier(v)));
+            if (stop != 0) return p + __builtin_ctz(stop);
+        }
+        return sse2SkipIdentifier(p, end);
+    }
+
+    CPPLOX_AVX2 const char *avx2SkipToQuote(const char *p, const char *end, int &lines) {
+        for (; end - p >= 32; p += 32) {
+            const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p));
+            const unsigned stop = static_cast<unsigned>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('"'))));
+            const unsigned newlines = static_cast<unsigned>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('\n'))));
+            if (stop != 0) {
+                const int offset = __builtin_ctz(stop);
+                lines += __builtin_popcount(newlines & ((1u << offset) - 1));
+                return p + offset;
+            }
+            lines += __builtin_popcount(newlines);
+        }
+        return sse2SkipToQuote(p, end, lines);
+    }
+
+#undef CPPLOX_AVX2
+
+#endif// CPPLOX_SIMD_X86
+
+}// namespace
+
+const cpplox::simd::Kernels &cpplox::simd::scalar() {
+    static const Kernels kernels{"scalar", scalarSkipWhitespace, scalarSkipToNewline, scalarSkipIdentifier, scalarSkipToQuote};
+    return kernels;
+}
+
+const cpplox::simd::Kernels *cpplox::simd::sse2() {
+#ifdef CPPLOX_SIMD_X86
+    static const Kernels kernels{"sse2", sse2SkipWhitespace, sse2SkipToNewline, sse2SkipIdentifier, sse2SkipToQuote};
+    return &kernels;
+#else
+    return nullptr;
+#endif
+}
+
+const cpplox::simd::Kernels *cpplox::simd::avx2() {
+#ifdef CPPLOX_SIMD_X86
+    static const Kernels kernels{"avx2", avx2SkipWhitespace, avx2SkipToNewline, avx2SkipIdentifier, avx2SkipToQuote};
+    static const bool supported = __builtin_cpu_supports("avx2") && __builtin_cpu_supports("popcnt") && __builtin_cpu_supports("bmi");
+    return supported ? &kernels : nullptr;
+#else
+    return nullptr;
+#endif
+}
+
+const cpplox::simd::Kernels &cpplox::simd::best() {
+    static const Kernels &kernels = avx2()   ? *avx2()
+                                    : sse2() ? *sse2()
+                                             : scalar();
+    return kernels;
+}
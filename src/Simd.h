@@ -0,0 +1,30 @@
+#ifndef CPPLOX_SIMD_H
+#define CPPLOX_SIMD_H
+
+namespace cpplox::simd {
+
+    // Skip loops for the long runs the scanner sees in generated scripts.
+    // Every kernel scans [p, end) and returns the first byte that ends the run (or end).
+    struct Kernels {
+        const char *name;
+        // stops at the first byte that is not ' ', '\t', '\r' or '\n', counting the '\n's into lines
+        const char *(*skipWhitespace)(const char *p, const char *end, int &lines);
+        // stops at the next '\n', which is left for the caller so it can count the line
+        const char *(*skipToNewline)(const char *p, const char *end);
+        // stops at the first byte that is not [A-Za-z0-9_]
+        const char *(*skipIdentifier)(const char *p, const char *end);
+        // stops at the next '"', counting the '\n's into lines
+        const char *(*skipToQuote)(const char *p, const char *end, int &lines);
+    };
+
+    const Kernels &scalar();
+    // nullptr when the build target or the running CPU lacks the instruction set
+    const Kernels *sse2();
+    const Kernels *avx2();
+
+    // the widest kernels the CPU supports, picked once on first use
+    const Kernels &best();
+
+}// namespace cpplox::simd
+
+#endif// CPPLOX_SIMD_H
@@ -0,0 +1,81 @@
+#include "SourceBuffer.h"
+
+#include <cerrno>
+#include <fcntl.h>
+#include <memory>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <system_error>
+#include <unistd.h>
+#include <utility>
+#include <vector>
+
+namespace {
+
+    std::system_error systemError(const std::string &what) { return {errno, std::generic_category(), what}; }
+
+    // closes the descriptor on every exit path, but never stdin
+    struct FileDescriptor {
+        const int fd;
+        ~FileDescriptor() {
+            if (fd > STDIN_FILENO) close(fd);
+        }
+    };
+
+    std::string readAll(int fd, std::size_t sizeHint) {
+        std::string bytes;
+        bytes.resize(sizeHint > 0 ? sizeHint : 64 * 1024);
+        std::size_t used = 0;
+        while (true) {
+            if (used == bytes.size()) bytes.resize(bytes.size() * 2);
+            const ssize_t n = read(fd, bytes.data() + used, bytes.size() - used);
+            if (n == 0) break;
+            if (n < 0) {
+                if (errno == EINTR) continue;
+                throw systemError("read");
+            }
+            used += static_cast<std::size_t>(n);
+        }
+        bytes.resize(used);
+        return bytes;
+    }
+
+}// namespace
+
+cpplox::SourceBuffer::SourceBuffer(std::string bytes)
+    : bytes(std::move(bytes)), data(this->bytes.data()), size(this->bytes.size()), mapped(false) {}
+
+cpplox::SourceBuffer::SourceBuffer(const char *mapping, std::size_t size)
+    : data(mapping), size(size), mapped(true) {}
+
+cpplox::SourceBuffer::~SourceBuffer() {
+    if (mapped) munmap(const_cast<char *>(data), size);
+}
+
+const cpplox::SourceBuffer &cpplox::SourceBuffer::keep(SourceBuffer *buffer) {
+    // functions defined on one REPL line are still called on later lines,
+    // so every buffer stays alive until exit
+    static std::vector<std::unique_ptr<SourceBuffer>> buffers;
+    buffers.emplace_back(buffer);
+    return *buffers.back();
+}
+
+const cpplox::SourceBuffer &cpplox::SourceBuffer::adopt(std::string bytes) { return keep(new SourceBuffer(std::move(bytes))); }
+
+const cpplox::SourceBuffer &cpplox::SourceBuffer::load(const std::string &filename) {
+    const FileDescriptor file{filename == "-" ? STDIN_FILENO : open(filename.c_str(), O_RDONLY | O_CLOEXEC)};
+    if (file.fd < 0) throw systemError(filename);
+
+    struct stat info {};
+    if (fstat(file.fd, &info) < 0) throw systemError(filename);
+
+    // pipes, ttys and other streams can't be mapped, and mmap rejects empty files
+    if (!S_ISREG(info.st_mode) || info.st_size == 0) return adopt(readAll(file.fd, static_cast<std::size_t>(info.st_size)));
+
+    const auto size = static_cast<std::size_t>(info.st_size);
+    void *mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, file.fd, 0);
+    if (mapping == MAP_FAILED) return adopt(readAll(file.fd, size));
+    // the scanner reads the file front to back exactly once
+    madvise(mapping, size, MADV_SEQUENTIAL);
+    return keep(new SourceBuffer(static_cast<const char *>(mapping), size));
+}
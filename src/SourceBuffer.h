@@ -0,0 +1,42 @@
+#ifndef CPPLOX_SOURCEBUFFER_H
+#define CPPLOX_SOURCEBUFFER_H
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+namespace cpplox {
+
+    // Owns the bytes of a script (or of a REPL line) until the program exits.
+    // Tokens and AST nodes refer into it through std::string_view, so nothing
+    // downstream of the scanner has to copy a lexeme.
+    class SourceBuffer {
+    public:
+        // takes ownership of the bytes; the returned buffer is never freed
+        static const SourceBuffer &adopt(std::string bytes);
+        // maps a regular file read-only, or read()s pipes, ttys and "-" (stdin);
+        // throws std::system_error when the file can't be opened or read
+        static const SourceBuffer &load(const std::string &filename);
+
+        std::string_view view() const { return {data, size}; }
+
+        SourceBuffer(const SourceBuffer &) = delete;
+        SourceBuffer &operator=(const SourceBuffer &) = delete;
+        ~SourceBuffer();
+
+    private:
+        explicit SourceBuffer(std::string bytes);
+        SourceBuffer(const char *mapping, std::size_t size);
+
+        // empty when the bytes are a mapping
+        const std::string bytes;
+        const char *const data;
+        const std::size_t size;
+        const bool mapped;
+
+        static const SourceBuffer &keep(SourceBuffer *buffer);
+    };
+
+}// namespace cpplox
+
+#endif// CPPLOX_SOURCEBUFFER_H
@@ -1,15 +1,100 @@
 #include "Stmt.h"
 
+#include <algorithm>
+#include <string>
+#include <type_traits>
 #include <utility>
 
-cpplox::AST::BlockStmt::BlockStmt(std::vector<pStmt> &&statements)
-    : statements(std::move(statements)) {}
+namespace {
+
+    using namespace cpplox;
+
+    // the walk behind AST::assignedByFunctions
+    class Assignments {
+    public:
+        std::unordered_set<Symbol> names;
+
+        void visit(const AST::pStmt &pStmt) {
+            std::visit(
+                    [this](auto &&pStmt) {
+                        using T = std::decay_t<decltype(pStmt)>;
+                        if constexpr (std::is_same_v<T, AST::pBlockStmt>) {
+                            scopes.emplace_back();
+                            for (const AST::pStmt &statement: pStmt->statements) visit(statement);
+                            scopes.pop_back();
+                        }
+                        if constexpr (std::is_same_v<T, AST::pExpressionStmt> || std::is_same_v<T, AST::pPrintStmt>) visit(pStmt->expression);
+                        if constexpr (std::is_same_v<T, AST::pFunctionStmt>) {
+                            declare(pStmt->name.symbol);
+                            // what the body declares is its own, whatever encloses it
+                            std::vector<std::unordered_set<Symbol>> enclosing = std::move(scopes);
+                            const bool wasInFunction = std::exchange(inFunction, true);
+                            scopes.assign(1, {});
+                            for (const Name &param: pStmt->params) declare(param.symbol);
+                            for (const AST::pStmt &statement: pStmt->body) visit(statement);
+                            scopes = std::move(enclosing);
+                            inFunction = wasInFunction;
+                        }
+                        if constexpr (std::is_same_v<T, AST::pIfStmt>) {
+                            visit(pStmt->condition);
+                            visit(pStmt->thenBranch);
+                            visit(pStmt->elseBranch);
+                        }
+                        if constexpr (std::is_same_v<T, AST::pReturnStmt>) visit(pStmt->value);
+                        if constexpr (std::is_same_v<T, AST::pVarStmt>) {
+                            visit(pStmt->initializer);
+                            declare(pStmt->name.symbol);
+                        }
+                        if constexpr (std::is_same_v<T, AST::pWhileStmt>) {
+                            visit(pStmt->condition);
+                            visit(pStmt->body);
+                        }
+                    },
+                    pStmt);
+        }
+
+        void visit(const AST::pExpr &pExpr) {
+            std::visit(
+                    [this](auto &&pExpr) {
+                        using T = std::decay_t<decltype(pExpr)>;
+                        if constexpr (std::is_same_v<T, AST::pAssignExpr>) {
+                            visit(pExpr->value);
+                            const Symbol name = pExpr->name.symbol;
+                            const auto declares = [name](const std::unordered_set<Symbol> &scope) { return scope.count(name) != 0; };
+                            if (inFunction && std::none_of(scopes.begin(), scopes.end(), declares)) names.insert(name);
+                        }
+                        if constexpr (std::is_same_v<T, AST::pBinaryExpr> || std::is_same_v<T, AST::pLogicalExpr>) {
+                            visit(pExpr->left);
+                            visit(pExpr->right);
+                        }
+                        if constexpr (std::is_same_v<T, AST::pCallExpr>) {
+                            visit(pExpr->callee);
+                            for (const AST::pExpr &argument: pExpr->arguments) visit(argument);
+                        }
+                        if constexpr (std::is_same_v<T, AST::pGroupingExpr>) visit(pExpr->expression);
+                        if constexpr (std::is_same_v<T, AST::pUnaryExpr>) visit(pExpr->right);
+                    },
+                    pExpr);
+        }
+
+    private:
+        // the names declared in each block of the innermost function, or of the top level
+        std::vector<std::unordered_set<Symbol>> scopes{1};
+        bool inFunction = false;
+
+        void declare(Symbol name) { scopes.back().insert(name); }
+    };
+
+}// namespace
+
+cpplox::AST::BlockStmt::BlockStmt(Span<pStmt> statements)
+    : statements(statements) {}
 
 cpplox::AST::ExprStmt::ExprStmt(pExpr expression)
     : expression(std::move(expression)) {}
 
-cpplox::AST::FuncStmt::FuncStmt(Token name, std::vector<Token> params, std::vector<pStmt> body)
-    : name(std::move(name)), params(std::move(params)), body(std::move(body)) {}
+cpplox::AST::FuncStmt::FuncStmt(Name name, Span<Name> params, Span<pStmt> body)
+    : name(std::move(name)), params(params), body(body) {}
 
 cpplox::AST::IfStmt::IfStmt(pExpr condition, pStmt thenBranch, pStmt elseBranch)
     : condition(std::move(condition)), thenBranch(std::move(thenBranch)), elseBranch(std::move(elseBranch)) {}
@@ -17,8 +102,60 @@ cpplox::AST::IfStmt::IfStmt(pExpr condition, pStmt thenBranch, pStmt elseBranch)
 cpplox::AST::PrintStmt::PrintStmt(pExpr expression)
     : expression(std::move(expression)) {}
 
-cpplox::AST::VarStmt::VarStmt(Token name, pExpr initializer)
+cpplox::AST::ReturnStmt::ReturnStmt(Token keyword, pExpr value)
+    : keyword(keyword), value(std::move(value)) {}
+
+cpplox::AST::VarStmt::VarStmt(Name name, pExpr initializer)
     : name(std::move(name)), initializer(std::move(initializer)) {}
 
 cpplox::AST::WhileStmt::WhileStmt(pExpr condition, pStmt body)
     : condition(std::move(condition)), body(std::move(body)) {}
+
+std::unordered_set<cpplox::Symbol> cpplox::AST::assignedByFunctions(const std::vector<pStmt> &statements) {
+    Assignments assignments;
+    for (const pStmt &statement: statements) assignments.visit(statement);
+    return std::move(assignments.names);
+}
+
+cpplox::AST::Scopes::Scopes(Span<Name> params, const std::vector<pStmt> &body) : Scopes(body) {
+    enterBlock();
+    for (const Name &param: params) declare(param.symbol);
+}
+
+auto cpplox::AST::Scopes::enterFunction(Span<Name> params) -> std::vector<std::unordered_set<Symbol>> {
+    std::vector<std::unordered_set<Symbol>> enclosing = std::move(scopes);
+    scopes.assign(1, {});
+    for (const Name &param: params) declare(param.symbol);
+    return enclosing;
+}
+
+void cpplox::AST::Scopes::declare(Symbol name) {
+    if (!scopes.empty()) scopes.back().insert(name);
+}
+
+bool cpplox::AST::Scopes::isLocal(Symbol name) const {
+    for (const std::unordered_set<Symbol> &scope: scopes)
+        if (scope.count(name)) return true;
+    return false;
+}
+
+cpplox::Symbol cpplox::AST::temporary(std::string_view pass, std::size_t index) {
+    return intern("$" + std::string(pass) + std::to_string(index));
+}
+
+bool cpplox::AST::isTemporary(Symbol name) {
+    const std::string_view chars = SymbolTable::global().name(name);
+    return !chars.empty() && chars.front() == '$';
+}
+
+cpplox::AST::pExpr cpplox::AST::cached(Arena &arena, Symbol temporary, const pExpr &value, int line) {
+    const pExpr assign = arena.make<AssignExpr>(Name{temporary, line}, value);
+    return arena.make<LogicalExpr>(arena.make<VariableExpr>(Name{temporary, line}), Token(TokenType::OR, 0, 0, static_cast<std::uint32_t>(line)), assign);
+}
+
+int cpplox::AST::lineOf(const pExpr &pExpr) {
+    if (const auto *grouping = std::get_if<pGroupingExpr>(&pExpr)) return lineOf((*grouping)->expression);
+    if (const auto *binary = std::get_if<pBinaryExpr>(&pExpr)) return static_cast<int>((*binary)->op.line);
+    if (const auto *unary = std::get_if<pUnaryExpr>(&pExpr)) return static_cast<int>((*unary)->op.line);
+    return 0;
+}
@@ -1,8 +1,13 @@
 #ifndef CPPLOX_STMT_H
 #define CPPLOX_STMT_H
 
+#include "Arena.h"
 #include "Expr.h"
-#include <memory>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <unordered_set>
+#include <utility>
 #include <variant>
 #include <vector>
 
@@ -13,23 +18,28 @@ namespace cpplox::AST {
     class FuncStmt;
     class IfStmt;
     class PrintStmt;
+    class ReturnStmt;
     class VarStmt;
     class WhileStmt;
 
-    using pBlockStmt = std::unique_ptr<BlockStmt>;
-    using pExpressionStmt = std::unique_ptr<ExprStmt>;
-    using pFunctionStmt = std::unique_ptr<FuncStmt>;
-    using pIfStmt = std::unique_ptr<IfStmt>;
-    using pPrintStmt = std::unique_ptr<PrintStmt>;
-    using pVarStmt = std::unique_ptr<VarStmt>;
-    using pWhileStmt = std::unique_ptr<WhileStmt>;
+    using pBlockStmt = const BlockStmt *;
+    using pExpressionStmt = const ExprStmt *;
+    using pFunctionStmt = const FuncStmt *;
+    using pIfStmt = const IfStmt *;
+    using pPrintStmt = const PrintStmt *;
+    using pReturnStmt = const ReturnStmt *;
+    using pVarStmt = const VarStmt *;
+    using pWhileStmt = const WhileStmt *;
 
-    using pStmt = std::variant<std::nullptr_t, pBlockStmt, pExpressionStmt, pFunctionStmt, pIfStmt, pPrintStmt, pVarStmt, pWhileStmt>;
+    // new kinds go last: a .loxc stores the index, see Cache
+    using pStmt = std::variant<std::nullptr_t, pBlockStmt, pExpressionStmt, pFunctionStmt, pIfStmt, pPrintStmt, pVarStmt, pWhileStmt, pReturnStmt>;
 
     class BlockStmt {
     public:
-        const std::vector<pStmt> statements;
-        explicit BlockStmt(std::vector<pStmt> &&statements);
+        const Span<pStmt> statements;
+        // the locals declared directly in the block, counted by the Resolver
+        mutable std::uint32_t slots = 0;
+        explicit BlockStmt(Span<pStmt> statements);
     };
 
     class ExprStmt {
@@ -38,12 +48,46 @@ namespace cpplox::AST {
         explicit ExprStmt(pExpr expression);
     };
 
+    // The body of a top-level function the Parser only brace-matched, see
+    // Parser::Parser. It is parsed, optimized and resolved on the function's
+    // first call.
+    struct LazyBody {
+        // from the opening brace to the closing one, in the SourceBuffer
+        std::string_view text;
+        std::uint32_t line;
+        // where the body's nodes go
+        Arena *arena;
+        // set by the Optimizer and the SubexpressionEliminator, which can't see into the body yet
+        bool optimize = false;
+        bool eliminateSubexpressions = false;
+    };
+
+    // A variable of an enclosing function that a function refers to. The
+    // closure copies it when it is made, a Box if the variable has one, and
+    // puts it back in the given slot of each call's outermost scope.
+    struct Capture {
+        // where the variable is, seen from the declaration
+        Binding from;
+        std::uint32_t slot;
+    };
+
     class FuncStmt {
     public:
-        const Token name;
-        const std::vector<Token> params;
-        const std::vector<pStmt> body;
-        FuncStmt(Token name, std::vector<Token> params, std::vector<pStmt> body);
+        const Name name;
+        const Span<Name> params;
+        // empty until the first call while the body is lazy
+        mutable Span<pStmt> body;
+        // the unparsed body, null once it has been parsed
+        mutable LazyBody *lazy = nullptr;
+        // filled in by the Resolver: where the name is defined, and the
+        // parameters, captures and locals declared directly in the body
+        mutable Binding binding;
+        mutable std::uint32_t slots = 0;
+        // only the variables the body refers to, however deep the declaration is
+        mutable Span<Capture> captures;
+        // the slots of the parameters that go in a Box on entry, see Binding::boxed
+        mutable Span<std::uint32_t> boxed;
+        FuncStmt(Name name, Span<Name> params, Span<pStmt> body);
     };
 
     class IfStmt {
@@ -60,11 +104,21 @@ namespace cpplox::AST {
         explicit PrintStmt(pExpr expression);
     };
 
+    class ReturnStmt {
+    public:
+        const Token keyword;
+        // nullptr for a bare `return;`, which returns nil
+        const pExpr value;
+        ReturnStmt(Token keyword, pExpr value);
+    };
+
     class VarStmt {
     public:
-        const Token name;
+        const Name name;
         const pExpr initializer;
-        VarStmt(Token name, pExpr initializer);
+        // filled in by the Resolver
+        mutable Binding binding;
+        VarStmt(Name name, pExpr initializer);
     };
 
     class WhileStmt {
@@ -74,6 +128,50 @@ namespace cpplox::AST {
         WhileStmt(pExpr condition, pStmt body);
     };
 
+    // The names that functions declared among the statements, at any depth,
+    // assign without declaring them themselves: globals, and the locals of an
+    // enclosing function that a call to a closure may change. Bodies still
+    // to be parsed are skipped; they belong to top-level functions, which
+    // can only assign globals. For the passes that run before the Resolver.
+    std::unordered_set<Symbol> assignedByFunctions(const std::vector<pStmt> &statements);
+
+    // What a pass that runs before the Resolver knows of the names where it
+    // is: those declared in no enclosing block or function are globals. A
+    // call may assign any global, and the locals some closure assigns.
+    class Scopes {
+    public:
+        Scopes() = default;
+        // the statements of a program, or a function body with its parameters
+        explicit Scopes(const std::vector<pStmt> &statements) : assignedByCalls(assignedByFunctions(statements)) {}
+        Scopes(Span<Name> params, const std::vector<pStmt> &body);
+
+        void enterBlock() { scopes.emplace_back(); }
+        void leaveBlock() { scopes.pop_back(); }
+        // a function body starts afresh with its parameters: what it captures
+        // is left to calls, as are the globals; hands back the scopes around it
+        auto enterFunction(Span<Name> params) -> std::vector<std::unordered_set<Symbol>>;
+        void leaveFunction(std::vector<std::unordered_set<Symbol>> enclosing) { scopes = std::move(enclosing); }
+
+        void declare(Symbol name);
+        bool isLocal(Symbol name) const;
+        // a local no closure assigns, which only the code in sight can change
+        bool isKeptFromCalls(Symbol name) const { return isLocal(name) && !assignedByCalls.count(name); }
+
+    private:
+        std::vector<std::unordered_set<Symbol>> scopes;
+        std::unordered_set<Symbol> assignedByCalls;
+    };
+
+    // The passes hold values in variables of their own, named so that no name
+    // in the script can clash, as '$' can't start an identifier.
+    Symbol temporary(std::string_view pass, std::size_t index);
+    bool isTemporary(Symbol name);
+    // `temporary or (temporary = value)`: value is computed unless the
+    // temporary already holds something truthy
+    pExpr cached(Arena &arena, Symbol temporary, const pExpr &value, int line);
+    // the line of a binary or unary operator, seen through groupings; 0 for the rest
+    int lineOf(const pExpr &pExpr);
+
 }// namespace cpplox::AST
 
 #endif//CPPLOX_STMT_H
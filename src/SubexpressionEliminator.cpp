@@ -0,0 +1,355 @@
+#include "SubexpressionEliminator.h"
+
+#include <cstring>
+#include <type_traits>
+
+namespace {
+
+    enum class Kind : std::uint8_t { Literal, Variable, Binary, Logical, Unary };
+
+    // the literal kinds, in Key::op
+    enum class Constant : std::uint8_t { Nil, Number, String, Boolean };
+
+    bool isSimple(const cpplox::AST::pStmt &pStmt) {
+        return std::holds_alternative<cpplox::AST::pExpressionStmt>(pStmt) || std::holds_alternative<cpplox::AST::pPrintStmt>(pStmt) ||
+               std::holds_alternative<cpplox::AST::pVarStmt>(pStmt);
+    }
+
+}// namespace
+
+std::size_t cpplox::SubexpressionEliminator::KeyHash::operator()(const Key &key) const {
+    std::size_t hash = static_cast<std::size_t>(key.kind) << 8 | key.op;
+    for (const std::uint32_t part: {key.a, key.b, key.c}) hash = hash * 0x9e3779b97f4a7c15ULL + part;
+    return hash ^ hash >> 29;
+}
+
+auto cpplox::SubexpressionEliminator::eliminate(const std::vector<AST::pStmt> &program) -> std::vector<AST::pStmt> {
+    scopes = AST::Scopes(program);
+    return eliminateAll(program);
+}
+
+auto cpplox::SubexpressionEliminator::eliminateBody(Span<Name> params, const std::vector<AST::pStmt> &body) -> std::vector<AST::pStmt> {
+    scopes = AST::Scopes(params, body);
+    return eliminateAll(body);
+}
+
+auto cpplox::SubexpressionEliminator::eliminateAll(const std::vector<AST::pStmt> &statements) -> std::vector<AST::pStmt> {
+    std::vector<AST::pStmt> eliminated;
+    eliminated.reserve(statements.size());
+    eliminateInto(eliminated, Span<AST::pStmt>(statements.data(), static_cast<std::uint32_t>(statements.size())));
+    return eliminated;
+}
+
+auto cpplox::SubexpressionEliminator::eliminate(Span<AST::pStmt> statements) -> Span<AST::pStmt> {
+    std::vector<AST::pStmt> eliminated;
+    eliminated.reserve(statements.size());
+    return eliminateInto(eliminated, statements) ? arena.copy(eliminated) : statements;
+}
+
+bool cpplox::SubexpressionEliminator::eliminateInto(std::vector<AST::pStmt> &statements, Span<AST::pStmt> input) {
+    bool changed = false;
+    for (std::size_t first = 0; first < input.size();) {
+        std::size_t last = first;
+        while (last < input.size() && isSimple(input[last])) last++;
+        // an if or a return ends the run, but its expression is still part of it
+        if (last < input.size() && (std::holds_alternative<AST::pIfStmt>(input[last]) || std::holds_alternative<AST::pReturnStmt>(input[last]))) last++;
+        if (last == first) {
+            statements.push_back(eliminate(input[first]));
+            changed |= statements.back() != input[first];
+            first++;
+            continue;
+        }
+
+        numbers.clear();
+        values.clear();
+        visits.clear();
+        for (std::size_t i = first; i < last; i++) number(input[i]);
+        settleCounts();
+
+        cursor = 0;
+        declared.clear();
+        std::vector<AST::pStmt> run;
+        for (std::size_t i = first; i < last; i++) {
+            run.push_back(rewrite(input[i]));
+            changed |= run.back() != input[i];
+        }
+        for (const Symbol temporary: declared) statements.emplace_back(arena.make<AST::VarStmt>(Name{temporary, 0}, nullptr));
+        changed |= !declared.empty();
+
+        // the branches of the if are runs of their own, numbered only now that this one is done
+        if (const auto *branch = std::get_if<AST::pIfStmt>(&run.back())) {
+            const AST::pStmt thenBranch = eliminate((*branch)->thenBranch);
+            const AST::pStmt elseBranch = eliminate((*branch)->elseBranch);
+            if (thenBranch != (*branch)->thenBranch || elseBranch != (*branch)->elseBranch) {
+                run.back() = arena.make<AST::IfStmt>((*branch)->condition, thenBranch, elseBranch);
+                changed = true;
+            }
+        }
+        statements.insert(statements.end(), run.begin(), run.end());
+        first = last;
+    }
+    return changed;
+}
+
+auto cpplox::SubexpressionEliminator::eliminate(const AST::pStmt &pStmt) -> AST::pStmt {
+    return std::visit(
+            [this](auto &&pStmt) -> AST::pStmt {
+                using T = std::decay_t<decltype(pStmt)>;
+                if constexpr (std::is_same_v<T, AST::pBlockStmt>) {
+                    scopes.enterBlock();
+                    const Span<AST::pStmt> statements = eliminate(pStmt->statements);
+                    scopes.leaveBlock();
+                    if (statements.begin() == pStmt->statements.begin()) return pStmt;
+                    return arena.make<AST::BlockStmt>(statements);
+                }
+                if constexpr (std::is_same_v<T, AST::pFunctionStmt>) {
+                    scopes.declare(pStmt->name.symbol);
+                    if (pStmt->lazy) {
+                        pStmt->lazy->eliminateSubexpressions = true;
+                        return pStmt;
+                    }
+                    auto enclosing = scopes.enterFunction(pStmt->params);
+                    const Span<AST::pStmt> body = eliminate(pStmt->body);
+                    scopes.leaveFunction(std::move(enclosing));
+                    if (body.begin() == pStmt->body.begin()) return pStmt;
+                    return arena.make<AST::FuncStmt>(pStmt->name, pStmt->params, body);
+                }
+                if constexpr (std::is_same_v<T, AST::pIfStmt>) {
+                    const AST::pStmt thenBranch = eliminate(pStmt->thenBranch);
+                    const AST::pStmt elseBranch = eliminate(pStmt->elseBranch);
+                    if (thenBranch == pStmt->thenBranch && elseBranch == pStmt->elseBranch) return pStmt;
+                    return arena.make<AST::IfStmt>(pStmt->condition, thenBranch, elseBranch);
+                }
+                if constexpr (std::is_same_v<T, AST::pWhileStmt>) {
+                    // the condition is evaluated once per iteration, with nowhere to reset a temporary in between
+                    const AST::pStmt body = eliminate(pStmt->body);
+                    if (body == pStmt->body) return pStmt;
+                    return arena.make<AST::WhileStmt>(pStmt->condition, body);
+                }
+                // a statement on its own as a branch or a loop body has no list to declare temporaries in
+                return pStmt;
+            },
+            pStmt);
+}
+
+void cpplox::SubexpressionEliminator::define(Symbol name) { definitions[name] = ++nextDefinition; }
+
+
+void cpplox::SubexpressionEliminator::number(const AST::pStmt &pStmt) {
+    std::visit(
+            [this](auto &&pStmt) {
+                using T = std::decay_t<decltype(pStmt)>;
+                if constexpr (std::is_same_v<T, AST::pExpressionStmt> || std::is_same_v<T, AST::pPrintStmt>) number(pStmt->expression);
+                if constexpr (std::is_same_v<T, AST::pIfStmt>) number(pStmt->condition);
+                if constexpr (std::is_same_v<T, AST::pReturnStmt>) number(pStmt->value);
+                if constexpr (std::is_same_v<T, AST::pVarStmt>) {
+                    number(pStmt->initializer);
+                    scopes.declare(pStmt->name.symbol);
+                    define(pStmt->name.symbol);
+                }
+            },
+            pStmt);
+}
+
+auto cpplox::SubexpressionEliminator::number(const AST::pExpr &pExpr) -> Number {
+    const std::size_t visit = visits.size();
+    visits.push_back({none, 0});
+    const Number numbered = std::visit(
+            [this](auto &&pExpr) -> Number {
+                using T = std::decay_t<decltype(pExpr)>;
+                if constexpr (std::is_same_v<T, AST::pAssignExpr>) {
+                    // the LoopHoister's `$t = e`: e runs once per loop entry and is best left alone
+                    if (!AST::isTemporary(pExpr->name.symbol)) number(pExpr->value);
+                    define(pExpr->name.symbol);
+                    return fresh();
+                }
+                if constexpr (std::is_same_v<T, AST::pBinaryExpr> || std::is_same_v<T, AST::pLogicalExpr>) {
+                    const Number left = number(pExpr->left);
+                    const Number right = number(pExpr->right);
+                    const bool pure = values[left].pure && values[right].pure;
+                    const Kind kind = std::is_same_v<T, AST::pBinaryExpr> ? Kind::Binary : Kind::Logical;
+                    return valueOf({static_cast<std::uint8_t>(kind), static_cast<std::uint8_t>(pExpr->op.type), left, right, 0}, left, right, pure,
+                                   pure && kind == Kind::Binary);
+                }
+                if constexpr (std::is_same_v<T, AST::pCallExpr>) {
+                    number(pExpr->callee);
+                    for (const AST::pExpr &argument: pExpr->arguments) number(argument);
+                    // a call can reach the globals, and the caller's locals only through a closure
+                    calls++;
+                    return fresh();
+                }
+                if constexpr (std::is_same_v<T, AST::pGroupingExpr>) return number(pExpr->expression);
+                if constexpr (std::is_same_v<T, AST::pLiteralExpr>) {
+                    return std::visit(
+                            overloaded{
+                                    [this](std::monostate) { return valueOf({static_cast<std::uint8_t>(Kind::Literal), static_cast<std::uint8_t>(Constant::Nil), 0, 0, 0}); },
+                                    [this](bool value) {
+                                        return valueOf({static_cast<std::uint8_t>(Kind::Literal), static_cast<std::uint8_t>(Constant::Boolean), value, 0, 0});
+                                    },
+                                    [this](double value) {
+                                        std::uint64_t bits;
+                                        std::memcpy(&bits, &value, sizeof(bits));
+                                        return valueOf({static_cast<std::uint8_t>(Kind::Literal), static_cast<std::uint8_t>(Constant::Number),
+                                                        static_cast<std::uint32_t>(bits), static_cast<std::uint32_t>(bits >> 32), 0});
+                                    },
+                                    [this](std::string_view value) {
+                                        const std::uint32_t string = strings.emplace(value, static_cast<std::uint32_t>(strings.size())).first->second;
+                                        return valueOf({static_cast<std::uint8_t>(Kind::Literal), static_cast<std::uint8_t>(Constant::String), string, 0, 0});
+                                    }},
+                            pExpr->value);
+                }
+                if constexpr (std::is_same_v<T, AST::pUnaryExpr>) {
+                    const Number right = number(pExpr->right);
+                    const bool pure = values[right].pure;
+                    // negating a lone variable or literal costs no more than reading a temporary
+                    return valueOf({static_cast<std::uint8_t>(Kind::Unary), static_cast<std::uint8_t>(pExpr->op.type), right, 0, 0}, right, none, pure,
+                                   pure && values[right].left != none);
+                }
+                if constexpr (std::is_same_v<T, AST::pVariableExpr>) {
+                    const Symbol name = pExpr->name.symbol;
+                    const auto definition = definitions.find(name);
+                    return valueOf({static_cast<std::uint8_t>(Kind::Variable), 0, name, definition == definitions.end() ? 0 : definition->second,
+                                    scopes.isKeptFromCalls(name) ? 0 : calls});
+                }
+                // the missing initializer of a bare `var x;`
+                return fresh();
+            },
+            pExpr);
+    visits[visit] = {numbered, static_cast<std::uint32_t>(visits.size())};
+    return numbered;
+}
+
+auto cpplox::SubexpressionEliminator::valueOf(const Key &key, Number left, Number right, bool pure, bool candidate) -> Number {
+    const auto [found, added] = numbers.emplace(key, static_cast<Number>(values.size()));
+    if (added) {
+        Value value;
+        value.left = left;
+        value.right = right;
+        value.pure = pure;
+        value.candidate = candidate;
+        values.push_back(value);
+    }
+    values[found->second].count++;
+    return found->second;
+}
+
+auto cpplox::SubexpressionEliminator::fresh() -> Number {
+    Value value;
+    value.count = 1;
+    value.pure = false;
+    values.push_back(value);
+    return static_cast<Number>(values.size() - 1);
+}
+
+void cpplox::SubexpressionEliminator::settleCounts() {
+    // operands are numbered before what uses them, so going down visits every
+    // value after all the values containing it
+    for (std::size_t i = values.size(); i-- > 0;) {
+        Value &value = values[i];
+        const std::uint32_t occurrences = value.count - value.skipped;
+        value.shared = value.candidate && occurrences >= 2;
+        if (value.shared) exprsShared++;
+        const std::uint32_t skipped = value.count - (value.shared ? 1 : occurrences);
+        if (value.left != none) values[value.left].skipped += skipped;
+        if (value.right != none) values[value.right].skipped += skipped;
+    }
+}
+
+auto cpplox::SubexpressionEliminator::rewrite(const AST::pStmt &pStmt) -> AST::pStmt {
+    return std::visit(
+            [this](auto &&pStmt) -> AST::pStmt {
+                using T = std::decay_t<decltype(pStmt)>;
+                if constexpr (std::is_same_v<T, AST::pExpressionStmt>) {
+                    const AST::pExpr expression = rewrite(pStmt->expression, false);
+                    if (expression == pStmt->expression) return pStmt;
+                    return arena.make<AST::ExprStmt>(expression);
+                }
+                if constexpr (std::is_same_v<T, AST::pIfStmt>) {
+                    const AST::pExpr condition = rewrite(pStmt->condition, false);
+                    if (condition == pStmt->condition) return pStmt;
+                    return arena.make<AST::IfStmt>(condition, pStmt->thenBranch, pStmt->elseBranch);
+                }
+                if constexpr (std::is_same_v<T, AST::pPrintStmt>) {
+                    const AST::pExpr expression = rewrite(pStmt->expression, false);
+                    if (expression == pStmt->expression) return pStmt;
+                    return arena.make<AST::PrintStmt>(expression);
+                }
+                if constexpr (std::is_same_v<T, AST::pReturnStmt>) {
+                    const AST::pExpr value = rewrite(pStmt->value, false);
+                    if (value == pStmt->value) return pStmt;
+                    return arena.make<AST::ReturnStmt>(pStmt->keyword, value);
+                }
+                if constexpr (std::is_same_v<T, AST::pVarStmt>) {
+                    const AST::pExpr initializer = rewrite(pStmt->initializer, false);
+                    if (initializer == pStmt->initializer) return pStmt;
+                    return arena.make<AST::VarStmt>(pStmt->name, initializer);
+                }
+                return pStmt;
+            },
+            pStmt);
+}
+
+auto cpplox::SubexpressionEliminator::rewrite(const AST::pExpr &pExpr, bool conditional) -> AST::pExpr {
+    const Visit visit = visits[cursor++];
+    Value &value = values[visit.number];
+    if (value.shared && value.available) {
+        cursor = visit.end;
+        return arena.make<AST::VariableExpr>(Name{value.temporary, AST::lineOf(pExpr)});
+    }
+
+    const AST::pExpr rewritten = std::visit(
+            [this, conditional, &pExpr](auto &&expr) -> AST::pExpr {
+                using T = std::decay_t<decltype(expr)>;
+                if constexpr (std::is_same_v<T, AST::pAssignExpr>) {
+                    if (AST::isTemporary(expr->name.symbol)) return pExpr;
+                    const AST::pExpr value = rewrite(expr->value, conditional);
+                    if (value == expr->value) return pExpr;
+                    return arena.make<AST::AssignExpr>(expr->name, value);
+                }
+                if constexpr (std::is_same_v<T, AST::pBinaryExpr> || std::is_same_v<T, AST::pLogicalExpr>) {
+                    const AST::pExpr left = rewrite(expr->left, conditional);
+                    // the right of and and or may not run
+                    const AST::pExpr right = rewrite(expr->right, conditional || std::is_same_v<T, AST::pLogicalExpr>);
+                    if (left == expr->left && right == expr->right) return pExpr;
+                    using Node = std::remove_const_t<std::remove_pointer_t<T>>;
+                    return arena.make<Node>(left, expr->op, right);
+                }
+                if constexpr (std::is_same_v<T, AST::pCallExpr>) {
+                    const AST::pExpr callee = rewrite(expr->callee, conditional);
+                    std::vector<AST::pExpr> arguments;
+                    arguments.reserve(expr->arguments.size());
+                    bool changed = callee != expr->callee;
+                    for (const AST::pExpr &argument: expr->arguments) {
+                        arguments.push_back(rewrite(argument, conditional));
+                        changed |= arguments.back() != argument;
+                    }
+                    if (!changed) return pExpr;
+                    return arena.make<AST::CallExpr>(callee, expr->paren, arena.copy(arguments));
+                }
+                if constexpr (std::is_same_v<T, AST::pGroupingExpr>) {
+                    const AST::pExpr inner = rewrite(expr->expression, conditional);
+                    if (inner == expr->expression) return pExpr;
+                    return arena.make<AST::GroupingExpr>(inner);
+                }
+                if constexpr (std::is_same_v<T, AST::pUnaryExpr>) {
+                    const AST::pExpr right = rewrite(expr->right, conditional);
+                    if (right == expr->right) return pExpr;
+                    return arena.make<AST::UnaryExpr>(expr->op, right);
+                }
+                return pExpr;
+            },
+            pExpr);
+    cursor = visit.end;
+    // a grouping has the number of what it encloses, which does the sharing
+    if (!value.shared || std::holds_alternative<AST::pGroupingExpr>(pExpr)) return rewritten;
+
+    if (!value.named) {
+        value.temporary = AST::temporary("shared", temporaries++);
+        value.named = true;
+        declared.push_back(value.temporary);
+    }
+    const int line = AST::lineOf(pExpr);
+    if (conditional) return AST::cached(arena, value.temporary, rewritten, line);
+    value.available = true;
+    return arena.make<AST::AssignExpr>(Name{value.temporary, line}, rewritten);
+}
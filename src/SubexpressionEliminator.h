@@ -0,0 +1,125 @@
+#ifndef CPPLOX_SUBEXPRESSIONELIMINATOR_H
+#define CPPLOX_SUBEXPRESSIONELIMINATOR_H
+
+#include "Arena.h"
+#include "Expr.h"
+#include "Stmt.h"
+#include "Symbol.h"
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace cpplox {
+
+    // Common subexpression elimination over straight-line code: a run of
+    // expression, print and var statements in one statement list, up to and
+    // including the condition of an if or the value of a return that ends it.
+    // Expressions are hash-consed into value numbers; a variable's number
+    // changes whenever it is assigned or declared, and a global's also after
+    // any call, as does that of a local some closure assigns. Arithmetic,
+    // comparisons and negations that come out with the same number more than
+    // once are computed once into a temporary, declared with `var $t;` right
+    // before the run:
+    //     a * b + a * b    becomes    ($t = a * b) + $t
+    // An occurrence the run may skip, on the right of an and or an or,
+    // becomes `$t or ($t = e)` instead, so it computes e unless a value is
+    // already there; a false one is just computed again.
+    // Runs last, after the LoopHoister, when
+    // Runner::Options::eliminateSubexpressions is set.
+    class SubexpressionEliminator {
+    public:
+        explicit SubexpressionEliminator(Arena &arena) : arena(arena) {}
+
+        auto eliminate(const std::vector<AST::pStmt> &program) -> std::vector<AST::pStmt>;
+        // a function body parsed on its first call, see AST::LazyBody
+        auto eliminateBody(Span<Name> params, const std::vector<AST::pStmt> &body) -> std::vector<AST::pStmt>;
+
+        // value numbers computed once instead of several times
+        std::size_t sharedExprs() const { return exprsShared; }
+
+    private:
+        using Number = std::uint32_t;
+        static constexpr Number none = UINT32_MAX;
+
+        // what makes two expressions equal: the operator and the numbers of the operands
+        struct Key {
+            std::uint8_t kind;
+            std::uint8_t op;
+            std::uint32_t a;
+            std::uint32_t b;
+            std::uint32_t c;
+
+            bool operator==(const Key &other) const {
+                return kind == other.kind && op == other.op && a == other.a && b == other.b && c == other.c;
+            }
+        };
+
+        struct KeyHash {
+            std::size_t operator()(const Key &key) const;
+        };
+
+        struct Value {
+            Number left = none;
+            Number right = none;
+            // occurrences in the run, then those inside a copy that isn't evaluated
+            std::uint32_t count = 0;
+            std::uint32_t skipped = 0;
+            bool pure = true;
+            bool candidate = false;
+            // set once the run has decided to share it
+            bool shared = false;
+            bool named = false;
+            Symbol temporary = 0;
+            // assigned on every path from the start of the run to here
+            bool available = false;
+        };
+
+        // a node met while numbering, in the order the rewrite meets it again
+        struct Visit {
+            Number number;
+            // the index after the node's subtree
+            std::uint32_t end;
+        };
+
+        Arena &arena;
+        std::size_t exprsShared = 0;
+        std::size_t temporaries = 0;
+        AST::Scopes scopes;
+        // bumped by every assignment and declaration
+        std::unordered_map<Symbol, std::uint32_t> definitions;
+        std::uint32_t nextDefinition = 0;
+        // bumped by every call, which may assign any global
+        std::uint32_t calls = 0;
+        std::unordered_map<std::string_view, std::uint32_t> strings;
+
+        // the current run
+        std::unordered_map<Key, Number, KeyHash> numbers;
+        std::vector<Value> values;
+        std::vector<Visit> visits;
+        std::size_t cursor = 0;
+        std::vector<Symbol> declared;
+
+        auto eliminateAll(const std::vector<AST::pStmt> &statements) -> std::vector<AST::pStmt>;
+        auto eliminate(Span<AST::pStmt> statements) -> Span<AST::pStmt>;
+        // true if statements differ from the input
+        bool eliminateInto(std::vector<AST::pStmt> &statements, Span<AST::pStmt> input);
+        auto eliminate(const AST::pStmt &pStmt) -> AST::pStmt;
+        void define(Symbol name);
+
+        // numbers the expressions of a run, counting how often each value occurs
+        void number(const AST::pStmt &pStmt);
+        auto number(const AST::pExpr &pExpr) -> Number;
+        auto valueOf(const Key &key, Number left = none, Number right = none, bool pure = true, bool candidate = false) -> Number;
+        auto fresh() -> Number;
+        // drops the occurrences that sit inside a shared value's later copies
+        void settleCounts();
+
+        auto rewrite(const AST::pStmt &pStmt) -> AST::pStmt;
+        auto rewrite(const AST::pExpr &pExpr, bool conditional) -> AST::pExpr;
+    };
+
+}// namespace cpplox
+
+#endif// CPPLOX_SUBEXPRESSIONELIMINATOR_H
@@ -0,0 +1,13 @@
+#include "Symbol.h"
+
+cpplox::SymbolTable &cpplox::SymbolTable::global() {
+    static SymbolTable table;
+    return table;
+}
+
+cpplox::Symbol cpplox::SymbolTable::intern(std::string_view name) {
+    if (const auto it = ids.find(name); it != ids.end()) return it->second;
+    const auto symbol = static_cast<Symbol>(names.size());
+    ids.emplace(names.emplace_back(name), symbol);
+    return symbol;
+}
@@ -0,0 +1,40 @@
+#ifndef CPPLOX_SYMBOL_H
+#define CPPLOX_SYMBOL_H
+
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+namespace cpplox {
+
+    // an interned identifier; equal names always get the same id
+    using Symbol = std::uint32_t;
+
+    // The scanner interns every identifier it sees, so from the token stream
+    // onward names are compared and hashed as integers.
+    class SymbolTable {
+    public:
+        static SymbolTable &global();
+        // worker threads intern into a table of their own and translate afterwards
+        SymbolTable() = default;
+        SymbolTable(const SymbolTable &) = delete;
+        SymbolTable &operator=(const SymbolTable &) = delete;
+
+        Symbol intern(std::string_view name);
+        std::string_view name(Symbol symbol) const { return names[symbol]; }
+        std::size_t size() const { return names.size(); }
+
+    private:
+        // a deque never moves its elements, so the keys can view into it
+        std::deque<std::string> names;
+        std::unordered_map<std::string_view, Symbol> ids;
+    };
+
+    // shorthand for SymbolTable::global().intern
+    inline Symbol intern(std::string_view name) { return SymbolTable::global().intern(name); }
+
+}// namespace cpplox
+
+#endif// CPPLOX_SYMBOL_H
@@ -2,15 +2,15 @@
 #define CPPLOX_TOKEN_H
 
 #include "lib/magic_enum/include/magic_enum.hpp"
-#include "Object.h"
+#include "Symbol.h"
+#include <cstdint>
 #include <ostream>
-#include <string>
-#include <utility>
-#include <variant>
+#include <string_view>
+#include <type_traits>
 
 namespace cpplox {
 
-    enum class TokenType {
+    enum class TokenType : std::uint8_t {
         // Single-character tokens.
         LEFT_PAREN,
         RIGHT_PAREN,
@@ -60,23 +60,48 @@ namespace cpplox {
         EOF_TOKEN
     };
 
+    // 16 bytes and trivially copyable; the lexeme is recovered from the source
+    // it was scanned from, and a NUMBER's value lives in a side table
+    // (Scanner::number, TokenStream::previousNumber, TokenList::number), as
+    // does an IDENTIFIER's interned Symbol
     class Token {
     public:
-        Token(TokenType type, std::string lexeme, Object literal, int line)
-            : type(type), lexeme(std::move(lexeme)), literal(std::move(literal)),
-              line(line) {}
+        Token() = default;
+        Token(TokenType type, std::uint32_t offset, std::uint32_t length, std::uint32_t line, std::uint8_t flags = 0)
+            : type(type), flags(flags), line(line), offset(offset), length(length) {}
+
+        // set on a NUMBER written without a nonzero fraction whose value is below 2^53,
+        // so it holds an integer the double represents exactly
+        static constexpr std::uint8_t EXACT_INTEGER = 1;
+
+        bool isExactInteger() const { return flags & EXACT_INTEGER; }
+
+        std::string_view lexeme(std::string_view source) const { return source.substr(offset, length); }
 
         friend std::ostream &operator<<(std::ostream &os, const Token &token) {
-            os << magic_enum::enum_name(token.type) << ", " << token.lexeme << ", "
-               << token.literal;
+            os << magic_enum::enum_name(token.type) << ", " << token.line << ":" << token.offset << "+" << token.length;
             return os;
         }
 
-        const TokenType type;
-        const std::string lexeme;
-        const Object literal;
-        const int line;
+        TokenType type = TokenType::EOF_TOKEN;
+        // fills what would otherwise be padding after type
+        std::uint8_t flags = 0;
+        std::uint32_t line = 0;
+        // the lexeme's position in its SourceBuffer
+        std::uint32_t offset = 0;
+        std::uint32_t length = 0;
+    };
+
+    static_assert(sizeof(Token) == 16 && std::is_trivially_copyable_v<Token>);
+
+    // what the AST keeps of an identifier
+    struct Name {
+        Symbol symbol;
+        int line;
+
+        std::string_view lexeme() const { return SymbolTable::global().name(symbol); }
     };
+
 }// namespace cpplox
 
 #endif// CPPLOX_TOKEN_H
@@ -0,0 +1,68 @@
+#include "TokenList.h"
+
+#include <algorithm>
+#include <cassert>
+
+namespace {
+
+    template<typename T>
+    T lookup(const std::vector<std::uint32_t> &tokens, const std::vector<T> &values, std::size_t index) {
+        const auto it = std::lower_bound(tokens.begin(), tokens.end(), index);
+        assert(it != tokens.end() && *it == index && "no side table entry for this token");
+        return values[static_cast<std::size_t>(it - tokens.begin())];
+    }
+
+}// namespace
+
+void cpplox::TokenList::push(const Token &token, double number, Symbol symbol) {
+    if (token.type == TokenType::NUMBER) {
+        numberTokens.push_back(static_cast<std::uint32_t>(types.size()));
+        numbers.push_back(number);
+    } else if (token.type == TokenType::IDENTIFIER) {
+        symbolTokens.push_back(static_cast<std::uint32_t>(types.size()));
+        symbols.push_back(symbol);
+    }
+    types.push_back(token.type);
+    flags.push_back(token.flags);
+    lines.push_back(token.line);
+    offsets.push_back(token.offset);
+    lengths.push_back(token.length);
+}
+
+void cpplox::TokenList::reserve(std::size_t count) {
+    types.reserve(count);
+    flags.reserve(count);
+    lines.reserve(count);
+    offsets.reserve(count);
+    lengths.reserve(count);
+}
+
+cpplox::Token cpplox::TokenList::operator[](std::size_t index) const {
+    return Token(types[index], offsets[index], lengths[index], lines[index], flags[index]);
+}
+
+void cpplox::TokenList::append(const TokenList &chunk, std::uint32_t lineOffset, const std::vector<Symbol> &symbolMap) {
+    const auto base = static_cast<std::uint32_t>(size());
+    types.insert(types.end(), chunk.types.begin(), chunk.types.end());
+    flags.insert(flags.end(), chunk.flags.begin(), chunk.flags.end());
+    offsets.insert(offsets.end(), chunk.offsets.begin(), chunk.offsets.end());
+    lengths.insert(lengths.end(), chunk.lengths.begin(), chunk.lengths.end());
+    for (const std::uint32_t line: chunk.lines) lines.push_back(line + lineOffset);
+    for (const std::uint32_t index: chunk.numberTokens) numberTokens.push_back(index + base);
+    numbers.insert(numbers.end(), chunk.numbers.begin(), chunk.numbers.end());
+    for (const std::uint32_t index: chunk.symbolTokens) symbolTokens.push_back(index + base);
+    for (const Symbol symbol: chunk.symbols) symbols.push_back(symbolMap[symbol]);
+}
+
+cpplox::Token cpplox::TokenList::Reader::nextToken() {
+    // the list ends with EOF_TOKEN, which is handed out again on every later call
+    const Token token = tokens[next];
+    if (next + 1 < tokens.size()) next++;
+    if (token.type == TokenType::NUMBER) numberCursor++;
+    else if (token.type == TokenType::IDENTIFIER) symbolCursor++;
+    return token;
+}
+
+double cpplox::TokenList::number(std::size_t index) const { return lookup(numberTokens, numbers, index); }
+
+cpplox::Symbol cpplox::TokenList::symbol(std::size_t index) const { return lookup(symbolTokens, symbols, index); }
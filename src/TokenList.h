@@ -0,0 +1,69 @@
+#ifndef CPPLOX_TOKENLIST_H
+#define CPPLOX_TOKENLIST_H
+
+#include "Token.h"
+#include "TokenSource.h"
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+namespace cpplox {
+
+    // A fully scanned source, stored column by column: 14 bytes per token,
+    // plus 12 bytes per NUMBER and 8 per IDENTIFIER in the side tables.
+    class TokenList {
+    public:
+        explicit TokenList(std::string_view source) : source(source) {}
+
+        // number and symbol are only kept for NUMBER and IDENTIFIER tokens
+        void push(const Token &token, double number = 0, Symbol symbol = 0);
+        void reserve(std::size_t count);
+
+        std::size_t size() const { return types.size(); }
+        Token operator[](std::size_t index) const;
+        const Token back() const { return (*this)[size() - 1]; }
+        std::string_view lexeme(std::size_t index) const { return source.substr(offsets[index], lengths[index]); }
+        // the value of the NUMBER token at index
+        double number(std::size_t index) const;
+        // the interned name of the IDENTIFIER token at index
+        Symbol symbol(std::size_t index) const;
+
+        // appends a list scanned from a later part of the same source; its lines
+        // are shifted by lineOffset and its symbols translated through symbolMap
+        void append(const TokenList &chunk, std::uint32_t lineOffset, const std::vector<Symbol> &symbolMap);
+
+        // feeds the list to a TokenStream front to back, walking the side tables in step
+        class Reader : public TokenSource {
+        public:
+            explicit Reader(const TokenList &tokens) : tokens(tokens) {}
+
+            Token nextToken() override;
+            double number() const override { return tokens.numbers[numberCursor - 1]; }
+            Symbol symbol() const override { return tokens.symbols[symbolCursor - 1]; }
+            std::string_view lexeme(const Token &token) const override { return token.lexeme(tokens.source); }
+
+        private:
+            const TokenList &tokens;
+            std::size_t next = 0;
+            std::size_t numberCursor = 0;
+            std::size_t symbolCursor = 0;
+        };
+
+    private:
+        std::string_view source;
+        std::vector<TokenType> types;
+        std::vector<std::uint8_t> flags;
+        std::vector<std::uint32_t> lines;
+        std::vector<std::uint32_t> offsets;
+        std::vector<std::uint32_t> lengths;
+        // side tables sorted by token index, one entry per NUMBER or IDENTIFIER token
+        std::vector<std::uint32_t> numberTokens;
+        std::vector<double> numbers;
+        std::vector<std::uint32_t> symbolTokens;
+        std::vector<Symbol> symbols;
+    };
+
+}// namespace cpplox
+
+#endif// CPPLOX_TOKENLIST_H
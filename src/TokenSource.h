@@ -0,0 +1,27 @@
+#ifndef CPPLOX_TOKENSOURCE_H
+#define CPPLOX_TOKENSOURCE_H
+
+#include "Symbol.h"
+#include "Token.h"
+#include <string_view>
+
+namespace cpplox {
+
+    // Where a TokenStream pulls its tokens from: the Scanner lexing on demand,
+    // or a TokenList that was lexed up front (in parallel for large scripts).
+    class TokenSource {
+    public:
+        virtual ~TokenSource() = default;
+
+        // EOF_TOKEN once the source is exhausted, and on every call after that
+        virtual Token nextToken() = 0;
+        // the value of the last NUMBER token nextToken() returned
+        virtual double number() const = 0;
+        // the interned name of the last IDENTIFIER token nextToken() returned
+        virtual Symbol symbol() const = 0;
+        virtual std::string_view lexeme(const Token &token) const = 0;
+    };
+
+}// namespace cpplox
+
+#endif// CPPLOX_TOKENSOURCE_H
@@ -0,0 +1,23 @@
+#include "TokenStream.h"
+
+#include <cassert>
+
+const cpplox::Token &cpplox::TokenStream::peek(std::size_t ahead) {
+    assert(ahead + 2 <= capacity && "lookahead would overwrite previous()");
+    while (scanned <= current + ahead) {
+        const std::size_t slot = scanned++ & mask;
+        ring[slot] = source.nextToken();
+        if (ring[slot].type == TokenType::NUMBER) numbers[slot] = source.number();
+        else if (ring[slot].type == TokenType::IDENTIFIER) symbols[slot] = source.symbol();
+    }
+    return ring[(current + ahead) & mask];
+}
+
+const cpplox::Token &cpplox::TokenStream::previous() const {
+    assert(current > 0 && "nothing has been consumed yet");
+    return ring[(current - 1) & mask];
+}
+
+void cpplox::TokenStream::advance() {
+    if (peek().type != TokenType::EOF_TOKEN) current++;
+}
@@ -0,0 +1,49 @@
+#ifndef CPPLOX_TOKENSTREAM_H
+#define CPPLOX_TOKENSTREAM_H
+
+#include "Token.h"
+#include "TokenSource.h"
+#include <array>
+#include <cstddef>
+#include <string_view>
+
+namespace cpplox {
+
+    // Pulls tokens from the Scanner (or a pre-scanned TokenList) only when the parser asks for them.
+    // A small ring keeps the previous token and the lookahead, so memory
+    // does not grow with the length of the script.
+    class TokenStream {
+    public:
+        explicit TokenStream(TokenSource &source) : source(source) {}
+
+        // the next token waiting to be parsed, or one `ahead` of it
+        const Token &peek(std::size_t ahead = 0);
+        // the most recently consumed token
+        const Token &previous() const;
+        // consumes the current token; EOF_TOKEN is never consumed
+        void advance();
+
+        // the value of previous() when it is a NUMBER
+        double previousNumber() const { return numbers[(current - 1) & mask]; }
+        // the interned name of previous() when it is an IDENTIFIER
+        Symbol previousSymbol() const { return symbols[(current - 1) & mask]; }
+        std::string_view lexeme(const Token &token) const { return source.lexeme(token); }
+
+    private:
+        // must stay a power of two; one slot belongs to previous()
+        static constexpr std::size_t capacity = 4;
+        static constexpr std::size_t mask = capacity - 1;
+
+        TokenSource &source;
+        std::array<Token, capacity> ring;
+        // side tables, indexed by ring slot
+        std::array<double, capacity> numbers{};
+        std::array<Symbol, capacity> symbols{};
+        // absolute positions in the token sequence
+        std::size_t current = 0;
+        std::size_t scanned = 0;
+    };
+
+}// namespace cpplox
+
+#endif// CPPLOX_TOKENSTREAM_H
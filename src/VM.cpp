@@ -0,0 +1,292 @@
+#include "VM.h"
+#include "Meta.h"
+
+#include <algorithm>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <typeinfo>
+#include <utility>
+
+namespace {
+
+    using cpplox::Value;
+
+    // the fast path of an arithmetic or comparison instruction: false if
+    // either operand isn't a number, for Interpreter::binary to handle
+    template<typename Operator>
+    bool numbers(Value *top, Operator op) {
+        if (!top[-2].isNumber() || !top[-1].isNumber()) return false;
+        top[-2] = op(top[-2].asNumber(), top[-1].asNumber());
+        return true;
+    }
+
+    std::uint32_t operand(const std::uint8_t *&ip) {
+        std::uint32_t value;
+        std::memcpy(&value, ip, sizeof(value));
+        ip += sizeof(value);
+        return value;
+    }
+
+}// namespace
+
+cpplox::Value cpplox::vm::Function::call(Interpreter &, const std::vector<Value> &arguments) { return vm.call(*this, arguments); }
+
+cpplox::vm::VM::VM(Interpreter &interpreter) : interpreter(interpreter) { Heap::global().addRoots(this); }
+
+cpplox::vm::VM::~VM() { Heap::global().removeRoots(this); }
+
+void cpplox::vm::VM::markRoots(Heap &heap) {
+    for (const Value *value = stack.data(); value < top; value++) heap.mark(*value);
+}
+
+void cpplox::vm::VM::interpret(const Program &program) {
+    try {
+        reset();
+        // the script's frame has no callee below it, so a nil stands in
+        *top++ = Value{};
+        enter(program.script(), nullptr, 0, 0);
+        run(0);
+    } catch (const InterpretErr &error) {
+        Errors::hadRuntimeError = true;
+        logger::error(error);
+        reset();
+    }
+}
+
+cpplox::Value cpplox::vm::VM::call(const Function &function, const std::vector<Value> &arguments) {
+    if (stack.empty()) reset();
+    reserve(arguments.size() + 1);
+    *top++ = Value{};
+    for (const Value argument: arguments) *top++ = argument;
+    const std::size_t base = frames.size();
+    enter(function.prototype, function.captures.data(), static_cast<std::uint32_t>(arguments.size()), 0);
+    return run(base);
+}
+
+void cpplox::vm::VM::reset() {
+    if (stack.empty()) stack.resize(1024);
+    frames.clear();
+    top = stack.data();
+}
+
+void cpplox::vm::VM::reserve(std::size_t size) {
+    const std::size_t used = static_cast<std::size_t>(top - stack.data());
+    if (stack.size() - used >= size) return;
+    std::vector<std::size_t> offsets;
+    offsets.reserve(frames.size());
+    for (const Frame &frame: frames) offsets.push_back(static_cast<std::size_t>(frame.slots - stack.data()));
+    stack.resize(std::max(stack.size() * 2, used + size));
+    top = stack.data() + used;
+    for (std::size_t i = 0; i < frames.size(); i++) frames[i].slots = stack.data() + offsets[i];
+}
+
+void cpplox::vm::VM::enter(const Prototype &prototype, const Value *captures, std::uint32_t count, std::uint32_t line) {
+    if (count != prototype.arity)
+        throw InterpretErr(Meta::sourceFile, static_cast<int>(line),
+                           "Expected " + std::to_string(prototype.arity) + " arguments but got " + std::to_string(count) + ".");
+    if (frames.size() == maxFrames) throw InterpretErr(Meta::sourceFile, static_cast<int>(line), "Stack overflow.");
+    reserve(prototype.frameSize);
+    Value *slots = top - count;
+    // what is left there may point to Objects since freed, which the Heap mustn't see
+    std::fill(top, slots + prototype.slots, Value{});
+    top = slots + prototype.slots;
+    for (std::size_t i = 0; i < prototype.captures.size(); i++) slots[prototype.captures[i].slot] = captures[i];
+    frames.push_back({&prototype, prototype.chunk.code.data(), slots});
+}
+
+cpplox::Value cpplox::vm::VM::run(std::size_t base) {
+    // the registers of the running frame, written back whenever another function may look at them
+    Frame *frame = &frames.back();
+    const std::uint8_t *code = frame->prototype->chunk.code.data();
+    const std::uint8_t *ip = frame->ip;
+    Value *slots = frame->slots;
+    Value *top = this->top;
+    const std::uint8_t *instruction = ip;
+    const auto line = [&]() { return frame->prototype->chunk.lines[static_cast<std::size_t>(instruction - code)]; };
+    const auto load = [&]() {
+        frame = &frames.back();
+        code = frame->prototype->chunk.code.data();
+        ip = frame->ip;
+        slots = frame->slots;
+        top = this->top;
+    };
+
+    for (;;) {
+        instruction = ip;
+        switch (static_cast<OpCode>(*ip++)) {
+            case OpCode::Constant:
+                *top++ = frame->prototype->chunk.constants[operand(ip)];
+                break;
+            case OpCode::Nil:
+                *top++ = Value{};
+                break;
+            case OpCode::True:
+                *top++ = true;
+                break;
+            case OpCode::False:
+                *top++ = false;
+                break;
+            case OpCode::Pop:
+                --top;
+                break;
+            case OpCode::GetLocal:
+                *top++ = slots[operand(ip)];
+                break;
+            case OpCode::SetLocal:
+                slots[operand(ip)] = top[-1];
+                break;
+            case OpCode::DefineLocal:
+                slots[operand(ip)] = *--top;
+                break;
+            case OpCode::Box: {
+                Value &slot = slots[operand(ip)];
+                slot = Heap::global().make<Box>(slot);
+                break;
+            }
+            case OpCode::GetBoxed:
+                *top++ = slots[operand(ip)].asBox()->value;
+                break;
+            case OpCode::SetBoxed:
+                slots[operand(ip)].asBox()->value = top[-1];
+                break;
+            case OpCode::GetGlobal: {
+                const std::uint32_t slot = operand(ip);
+                *top++ = interpreter.globals.get(slot, static_cast<int>(line()));
+                break;
+            }
+            case OpCode::SetGlobal: {
+                const std::uint32_t slot = operand(ip);
+                interpreter.globals.assign(slot, static_cast<int>(line()), top[-1]);
+                break;
+            }
+            case OpCode::DefineGlobal: {
+                const std::uint32_t slot = operand(ip);
+                interpreter.globals.define(slot, *--top);
+                break;
+            }
+            case OpCode::Equal: {
+                const bool equal = top[-2] == top[-1];
+                top[-2] = equal;
+                --top;
+                break;
+            }
+            case OpCode::NotEqual: {
+                const bool equal = top[-2] == top[-1];
+                top[-2] = !equal;
+                --top;
+                break;
+            }
+            case OpCode::Greater:
+                if (!numbers(top, std::greater<>())) top[-2] = Interpreter::binary(TokenType::GREATER, top[-2], top[-1], line());
+                --top;
+                break;
+            case OpCode::GreaterEqual:
+                if (!numbers(top, std::greater_equal<>())) top[-2] = Interpreter::binary(TokenType::GREATER_EQUAL, top[-2], top[-1], line());
+                --top;
+                break;
+            case OpCode::Less:
+                if (!numbers(top, std::less<>())) top[-2] = Interpreter::binary(TokenType::LESS, top[-2], top[-1], line());
+                --top;
+                break;
+            case OpCode::LessEqual:
+                if (!numbers(top, std::less_equal<>())) top[-2] = Interpreter::binary(TokenType::LESS_EQUAL, top[-2], top[-1], line());
+                --top;
+                break;
+            case OpCode::Add:
+                if (!numbers(top, std::plus<>())) top[-2] = Interpreter::binary(TokenType::PLUS, top[-2], top[-1], line());
+                --top;
+                break;
+            case OpCode::Subtract:
+                if (!numbers(top, std::minus<>())) top[-2] = Interpreter::binary(TokenType::MINUS, top[-2], top[-1], line());
+                --top;
+                break;
+            case OpCode::Multiply:
+                if (!numbers(top, std::multiplies<>())) top[-2] = Interpreter::binary(TokenType::STAR, top[-2], top[-1], line());
+                --top;
+                break;
+            case OpCode::Divide:
+                if (!numbers(top, std::divides<>())) top[-2] = Interpreter::binary(TokenType::SLASH, top[-2], top[-1], line());
+                --top;
+                break;
+            case OpCode::Not:
+                top[-1] = !Interpreter::isTruthy(top[-1]);
+                break;
+            case OpCode::Negate:
+                if (top[-1].isNumber()) top[-1] = -top[-1].asNumber();
+                else top[-1] = Interpreter::unary(TokenType::MINUS, top[-1], line());
+                break;
+            case OpCode::Print:
+                std::cout << *--top << std::endl;
+                break;
+            case OpCode::Jump: {
+                const std::uint32_t target = operand(ip);
+                // a loop that allocates would never reach a call otherwise
+                if (target < static_cast<std::size_t>(instruction - code) && Heap::global().wantsCollection()) {
+                    this->top = top;
+                    Heap::global().collect();
+                }
+                ip = code + target;
+                break;
+            }
+            case OpCode::JumpIfFalse: {
+                const std::uint32_t target = operand(ip);
+                if (!Interpreter::isTruthy(*--top)) ip = code + target;
+                break;
+            }
+            case OpCode::JumpIfFalseOrPop: {
+                const std::uint32_t target = operand(ip);
+                if (!Interpreter::isTruthy(top[-1])) ip = code + target;
+                else --top;
+                break;
+            }
+            case OpCode::JumpIfTrueOrPop: {
+                const std::uint32_t target = operand(ip);
+                if (Interpreter::isTruthy(top[-1])) ip = code + target;
+                else --top;
+                break;
+            }
+            case OpCode::Function: {
+                const Prototype &prototype = *frame->prototype->functions[operand(ip)];
+                std::vector<Value> captures;
+                captures.reserve(prototype.captures.size());
+                for (const Capture &capture: prototype.captures) captures.push_back(slots[capture.from]);
+                *top++ = Heap::global().make<Function>(*this, prototype, std::move(captures));
+                break;
+            }
+            case OpCode::Call: {
+                const std::uint8_t count = *ip++;
+                const Value callee = top[-count - 1];
+                frame->ip = ip;
+                this->top = top;
+                if (Heap::global().wantsCollection()) Heap::global().collect();
+                if (callee.isCallable() && typeid(*callee.asCallable()) == typeid(Function)) {
+                    const auto *function = static_cast<const Function *>(callee.asCallable());
+                    enter(function->prototype, function->captures.data(), count, line());
+                    load();
+                    break;
+                }
+                Callable *callable = Interpreter::checkCall(callee, count, line());
+                const std::vector<Value> arguments(top - count, top);
+                const Value result = callable->call(interpreter, arguments);
+                load();
+                top -= count;
+                top[-1] = result;
+                break;
+            }
+            case OpCode::Return: {
+                const Value result = top[-1];
+                top = frame->slots - 1;
+                frames.pop_back();
+                if (frames.size() == base) {
+                    this->top = top;
+                    return result;
+                }
+                *top++ = result;
+                this->top = top;
+                load();
+                break;
+            }
+        }
+    }
+}
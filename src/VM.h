@@ -0,0 +1,83 @@
+#ifndef CPPLOX_VM_H
+#define CPPLOX_VM_H
+
+#include "Bytecode.h"
+#include "Interpreter.h"
+#include "Object.h"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace cpplox::vm {
+
+    class VM;
+
+    // a function declared in a Program, with the values of its Prototype's captures
+    class Function : public Callable {
+    public:
+        // the Program is kept until exit, see Runner::run
+        Function(VM &vm, const Prototype &prototype, std::vector<Value> captures)
+            : vm(vm), prototype(prototype), captures(std::move(captures)) {}
+
+        int arity() override { return static_cast<int>(prototype.arity); }
+        Value call(Interpreter &interpreter, const std::vector<Value> &arguments) override;
+        std::string toString() override { return "<fn " + std::string(SymbolTable::global().name(prototype.name)) + ">"; }
+
+        void trace(Heap &heap) const override {
+            for (const Value capture: captures) heap.mark(capture);
+        }
+
+    private:
+        VM &vm;
+        const Prototype &prototype;
+        const std::vector<Value> captures;
+
+        friend class VM;
+    };
+
+    // Runs a Program on one value stack shared by all frames. A call to a
+    // Function pushes a frame and goes on in the same loop; other Callables
+    // are called through the interface. The globals and the natives are the
+    // Interpreter's, so a REPL session keeps them across lines.
+    // The Heap collects at calls and backward jumps, with the stack as roots.
+    class VM : private Heap::Roots {
+    public:
+        explicit VM(Interpreter &interpreter);
+        VM(const VM &) = delete;
+        VM &operator=(const VM &) = delete;
+        ~VM();
+
+        void interpret(const Program &program);
+        Value call(const Function &function, const std::vector<Value> &arguments);
+
+    private:
+        struct Frame {
+            const Prototype *prototype;
+            const std::uint8_t *ip;
+            // the first local; the callee sits right below it
+            Value *slots;
+        };
+
+        // deeper recursion is reported as a runtime error
+        static constexpr std::size_t maxFrames = 64 * 1024;
+
+        Interpreter &interpreter;
+        std::vector<Value> stack;
+        Value *top = nullptr;
+        std::vector<Frame> frames;
+
+        // runs until the frame count drops back to base, returning the last result
+        Value run(std::size_t base);
+        // pushes the frame of a call whose arguments are the top count values,
+        // copying in the values of the prototype's captures
+        void enter(const Prototype &prototype, const Value *captures, std::uint32_t count, std::uint32_t line);
+        // makes room for a frame of size values above top, moving the stack if need be
+        void reserve(std::size_t size);
+        void reset();
+        void markRoots(Heap &heap) override;
+    };
+
+}// namespace cpplox::vm
+
+#endif// CPPLOX_VM_H
@@ -1,16 +1,500 @@
 #include "gtest/gtest.h"
 
+#include "Cache.h"
+#include "ClosureCompiler.h"
+#include "Diagnostics.h"
+#include "FlatAst.h"
 #include "Interpreter.h"
+#include "LoopHoister.h"
+#include "Optimizer.h"
 #include "Parser.h"
-#include <memory>
+#include "Resolver.h"
+#include "Scanner.h"
+#include "SubexpressionEliminator.h"
+#include "VM.h"
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <sysexits.h>
+#include <vector>
 
 using namespace cpplox;
 
 TEST(InterpreterTest, BasicAssertions) {
-    Token plus(TokenType::PLUS, "+", std::monostate{}, 0);
-    AST::pExpr left = std::make_unique<AST::LiteralExpr>((double) 1);
-    AST::pExpr right = std::make_unique<AST::LiteralExpr>((double) 2);
+    Token plus(TokenType::PLUS, 0, 1, 0);
+    Arena arena;
+    AST::pExpr left = arena.make<AST::LiteralExpr>((double) 1);
+    AST::pExpr right = arena.make<AST::LiteralExpr>((double) 2);
     Interpreter interpreter;
-    auto val = interpreter.evaluate(std::make_unique<AST::BinaryExpr>(std::move(left), plus, std::move(right)));
-    EXPECT_EQ(std::get<double>(val), (double) 3);
+    auto val = interpreter.evaluate(arena.make<AST::BinaryExpr>(left, plus, right));
+    EXPECT_EQ(val.asNumber(), (double) 3);
+}
+
+namespace {
+
+    // a rewrite of the program between parsing and resolving
+    using Pass = std::vector<AST::pStmt> (*)(Arena &, const std::vector<AST::pStmt> &);
+
+    std::vector<AST::pStmt> hoist(Arena &arena, const std::vector<AST::pStmt> &program) { return LoopHoister(arena).hoist(program); }
+
+    std::vector<AST::pStmt> eliminate(Arena &arena, const std::vector<AST::pStmt> &program) {
+        return SubexpressionEliminator(arena).eliminate(program);
+    }
+
+    // resolves source and runs it through the given walk, returning what it printed
+    template<typename Walk>
+    std::string printed(const std::string &source, Walk &&walk, Pass pass = nullptr) {
+        Arena arena;
+        Scanner scanner(source);
+        std::vector<AST::pStmt> program = Parser(scanner, arena).parse();
+        if (pass) program = pass(arena, program);
+        Interpreter interpreter;
+        if (!Resolver(arena, interpreter.globals).resolve(program)) return "resolve error";
+        std::ostringstream output;
+        std::streambuf *old = std::cout.rdbuf(output.rdbuf());
+        walk(interpreter, program);
+        std::cout.rdbuf(old);
+        return output.str();
+    }
+
+    void treeWalk(Interpreter &interpreter, const std::vector<AST::pStmt> &program) { interpreter.interpret(program); }
+
+    void flatWalk(Interpreter &interpreter, const std::vector<AST::pStmt> &program) {
+        const flat::Tree tree(program);
+        interpreter.interpret(tree);
+    }
+
+    void vmWalk(Interpreter &interpreter, const std::vector<AST::pStmt> &program) {
+        const vm::Program compiled(program);
+        vm::VM(interpreter).interpret(compiled);
+    }
+
+    void closureWalk(Interpreter &interpreter, const std::vector<AST::pStmt> &program) { closure::Runtime(interpreter).interpret(program); }
+
+}// namespace
+
+TEST(InterpreterTest, FlatMatchesTree) {
+    const std::string source = "fun twice(n) { print n * 2; }\n"
+                               "var s = \"a\";\n"
+                               "for (var i = 0; i < 4; i = i + 1) { if (i == 2 or !true) twice(i); else s = s + \"b\"; }\n"
+                               "print s; print -(3 - 5) / 4; print nil and 1; print twice;\n";
+    const std::string expected = printed(source, treeWalk);
+    const std::string actual = printed(source, flatWalk);
+    EXPECT_EQ(expected, "4\nabbb\n0.5\nNULL\n<fn twice>\n");
+    EXPECT_EQ(actual, expected);
+    EXPECT_EQ(printed(source, vmWalk), expected);
+    EXPECT_EQ(printed(source, closureWalk), expected);
+}
+
+TEST(InterpreterTest, VmMatchesTree) {
+    const std::string source = "fun fib(n) { if (n < 2) { last = n; } else { fib(n - 1); var a = last; fib(n - 2); last = a + last; } }\n"
+                               "var last; fib(15); print last;\n"
+                               "fun count(n) { var i = 0; while (i < n) { { var j = i * 2; if (j > 4 and j < 8 or j == 0) print j; } i = i + 1; } }\n"
+                               "count(5); print count == count; print \"x\" + \"y\" == \"xy\"; print !nil;\n"
+                               "fun outer() { fun inner(s) { print s + \"!\"; } inner(\"hi\"); print inner; } outer();\n";
+    const std::string expected = printed(source, treeWalk);
+    EXPECT_EQ(expected, "610\n0\n6\nTRUE\nTRUE\nTRUE\nhi!\n<fn inner>\n");
+    EXPECT_EQ(printed(source, vmWalk), expected);
+
+    const std::string arity = printed("fun f(a) {} print 1; f(1, 2); print 2;", vmWalk);
+    EXPECT_EQ(arity.rfind("1\n", 0), 0u);
+    EXPECT_NE(arity.find("(1) : Expected 1 arguments but got 2."), std::string::npos);
+    EXPECT_EQ(arity.find("2\n"), std::string::npos);
+    EXPECT_EQ(printed("fun f(a) {} print 1; f(1, 2); print 2;", treeWalk), arity);
+    EXPECT_NE(printed("var x = 1; x();", vmWalk).find("Can only call functions and classes."), std::string::npos);
+    EXPECT_NE(printed("var x = 1; x();", flatWalk).find("Can only call functions and classes."), std::string::npos);
+    // the tree walk has no limit on recursion besides the native stack
+    EXPECT_NE(printed("fun f() { f(); } f();", vmWalk).find("Stack overflow."), std::string::npos);
+}
+
+TEST(InterpreterTest, ClosuresMatchTree) {
+    const std::string source = "fun fib(n) { if (n < 2) { last = n; } else { fib(n - 1); var a = last; fib(n - 2); last = a + last; } }\n"
+                               "var last; fib(15); print last;\n"
+                               "fun count(n) { var i = 0; while (i < n) { { var j = i * 2; if (j > 4 and j < 8 or j == 0) print j; } i = i + 1; } }\n"
+                               "count(5); print count == count; print \"x\" + \"y\" == \"xy\"; print !nil;\n"
+                               "fun outer() { fun inner(s) { print s + \"!\"; } inner(\"hi\"); print inner; } outer();\n"
+                               "fun wide(a, b, c, d, e, f, g, h, i, j, k, l, m, n, o, p, q) { print a + q; }\n"
+                               "wide(1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16, 17);\n";
+    const std::string expected = printed(source, treeWalk);
+    EXPECT_EQ(expected, "610\n0\n6\nTRUE\nTRUE\nTRUE\nhi!\n<fn inner>\n18\n");
+    EXPECT_EQ(printed(source, closureWalk), expected);
+
+    const std::string arity = "fun f(a) {} print 1; f(1, 2); print 2;";
+    EXPECT_EQ(printed(arity, closureWalk), printed(arity, treeWalk));
+    EXPECT_NE(printed("var x = 1; x();", closureWalk).find("Can only call functions and classes."), std::string::npos);
+    const std::string six = "fun six(a, b, c, d, e, f) { print a + b + c + d + e + f; } six(1, 2, 3, 4, 5, true);";
+    EXPECT_NE(printed(six, closureWalk).find("Operands must be two numbers or two strings."), std::string::npos);
+    EXPECT_EQ(printed(six, closureWalk), printed(six, treeWalk));
+
+    // bodies are compiled, and parsed, on their first call only
+    Arena arena;
+    Scanner scanner("fun f(n) { print n + 1; } fun unused() { this is not { valid } lox; } f(1); f(2);");
+    Interpreter interpreter;
+    const std::vector<AST::pStmt> program = Parser(scanner, arena, true).parse();
+    ASSERT_TRUE(Resolver(arena, interpreter.globals).resolve(program));
+    std::ostringstream output;
+    std::streambuf *old = std::cout.rdbuf(output.rdbuf());
+    closureWalk(interpreter, program);
+    std::cout.rdbuf(old);
+    EXPECT_EQ(output.str(), "2\n3\n");
+    EXPECT_EQ(std::get<AST::pFunctionStmt>(program[0])->lazy, nullptr);
+    EXPECT_NE(std::get<AST::pFunctionStmt>(program[1])->lazy, nullptr);
+}
+
+TEST(InterpreterTest, ReturnUnwinds) {
+    const std::string source = "fun fib(n) { if (n < 2) return n; return fib(n - 1) + fib(n - 2); }\n"
+                               "print fib(15);\n"
+                               "fun find(n) { var i = 0; while (true) { { var j = i * i; if (j >= n) return i; } i = i + 1; } }\n"
+                               "print find(50);\n"
+                               "fun early(x) { if (x) return; print \"late\"; } print early(true); early(false);\n"
+                               "fun none() {} print none();\n"
+                               "fun inner() { fun sq(x) { return x * x; } return sq; } print inner()(7);\n";
+    const std::string expected = "610\n8\nNULL\nlate\nNULL\n49\n";
+    for (const auto walk: {treeWalk, flatWalk, vmWalk, closureWalk}) EXPECT_EQ(printed(source, walk), expected);
+
+    EXPECT_EQ(printed("return 1;", treeWalk), "resolve error");
+    EXPECT_EQ(printed("{ return; }", treeWalk), "resolve error");
+    // an error unwinds through the blocks and calls around it the same way
+    const std::string error = "var a = 1; fun f() { { var b = a; a = b + \"x\"; } print \"unreachable\"; } f(); print a;";
+    for (const auto walk: {treeWalk, flatWalk, vmWalk, closureWalk}) {
+        const std::string output = printed(error, walk);
+        EXPECT_NE(output.find("Operands must be two numbers or two strings."), std::string::npos);
+        EXPECT_EQ(output.find("unreachable"), std::string::npos);
+    }
+}
+
+TEST(InterpreterTest, ClosuresCaptureVariables) {
+    const std::string source = "fun counter() { var n = 0; fun inc() { n = n + 1; return n; } return inc; }\n"
+                               "var c = counter(); var d = counter(); c(); print c(); print d();\n"
+                               "fun adder(n) { fun add(m) { return n + m; } return add; } print adder(5)(10);\n"
+                               "fun outer() { var x = \"x\"; fun mid() { fun inner() { return x + \"!\"; } return inner; } return mid(); } print outer()();\n"
+                               "fun fact() { fun f(n) { if (n < 2) return 1; return n * f(n - 1); } return f; } print fact()(5);\n"
+                               "fun loop() { var fs = nil; for (var i = 0; i < 3; i = i + 1) { var j = i; fun f() { return j; } if (i == 1) fs = f; } return fs; }\n"
+                               "print loop()();\n"
+                               "fun twice(n) { fun bump() { n = n * 2; } bump(); bump(); return n; } print twice(3);\n"
+                               "fun shared() { var v = 0; fun set(x) { v = x; } var t = 0;\n"
+                               "  for (var i = 0; i < 3; i = i + 1) { t = t + v * 2; set(i + 1); } print t; print v * 2 + v * 2; set(5); print v * 2 + v * 2; }\n"
+                               "shared();\n";
+    const std::string expected = "2\n1\n15\nx!\n120\n1\n12\n6\n12\n20\n";
+    for (const auto walk: {treeWalk, flatWalk, vmWalk, closureWalk}) {
+        EXPECT_EQ(printed(source, walk), expected);
+        // v * 2 changes with each call to set, which assigns it
+        EXPECT_EQ(printed(source, walk, hoist), expected);
+        EXPECT_EQ(printed(source, walk, eliminate), expected);
+    }
+
+    Arena arena;
+    Scanner scanner(source);
+    Interpreter interpreter;
+    const std::vector<AST::pStmt> program = Parser(scanner, arena).parse();
+    ASSERT_TRUE(Resolver(arena, interpreter.globals).resolve(program));
+    // inc finds n in a slot of its own, and n lives in a Box as inc assigns it
+    const auto counter = std::get<AST::pFunctionStmt>(program[0]);
+    const auto inc = std::get<AST::pFunctionStmt>(counter->body[1]);
+    ASSERT_EQ(inc->captures.size(), 1u);
+    EXPECT_EQ(inc->captures[0].from.depth, 0u);
+    EXPECT_TRUE(std::get<AST::pVarStmt>(counter->body[0])->binding.boxed);
+    // add only reads its n, which is copied
+    const auto adder = std::get<AST::pFunctionStmt>(program[6]);
+    ASSERT_EQ(std::get<AST::pFunctionStmt>(adder->body[0])->captures.size(), 1u);
+    EXPECT_TRUE(adder->boxed.empty());
+    // mid captures x only to hand it on to inner
+    const auto outer = std::get<AST::pFunctionStmt>(program[8]);
+    EXPECT_EQ(std::get<AST::pFunctionStmt>(outer->body[1])->captures.size(), 1u);
+    // twice boxes its parameter, which bump assigns
+    const auto twice = std::get<AST::pFunctionStmt>(program[14]);
+    ASSERT_EQ(twice->boxed.size(), 1u);
+    EXPECT_EQ(twice->boxed[0], 0u);
+}
+
+TEST(InterpreterTest, OperatorPrecedence) {
+    const std::string source = "fun id(x) { print x; }\n"
+                               "print 1 + 2 * 3 - 8 / 4;\n"
+                               "print -2 * -3 < 7 == !false;\n"
+                               "print nil or 1 and false;\n"
+                               "print 2 - 1 - 1;\n"
+                               "var a; var b; a = b = 3; print a;\n"
+                               "id(-(1 + 2));\n";
+    const std::string output = printed(source, treeWalk);
+    EXPECT_EQ(output, "5\nTRUE\nFALSE\n0\n3\n-3\n");
+}
+
+TEST(InterpreterTest, ResolverBindsScopes) {
+    const std::string source = "var a = \"global\";\n"
+                               "fun f(a) { var b = a; { var a = b + 1; print a; } print a; }\n"
+                               "{ var a = 1; { var b = a; a = 2; print b; } print a; }\n"
+                               "f(10); print a;\n"
+                               "fun g() { print later; } var later = 3; g();\n";
+    const std::string expected = "1\n2\n11\n10\nglobal\n3\n";
+    EXPECT_EQ(printed(source, treeWalk), expected);
+    EXPECT_EQ(printed(source, flatWalk), expected);
+    EXPECT_EQ(printed(source, vmWalk), expected);
+    EXPECT_EQ(printed(source, closureWalk), expected);
+
+    EXPECT_EQ(printed("{ var a = 1; var a = 2; }", treeWalk), "resolve error");
+    EXPECT_EQ(printed("{ var a = a; }", treeWalk), "resolve error");
+    EXPECT_EQ(printed("fun f(a, a) {}", treeWalk), "resolve error");
+    // globals may be redeclared, and initialized from their previous value
+    EXPECT_EQ(printed("var a = 1; var a = a + 1; print a;", treeWalk), "2\n");
+}
+
+TEST(InterpreterTest, ResolverChecksPrunedCode) {
+    // dead code the Optimizer drops is rejected all the same, as it is without the Optimizer
+    // a lazy body is checked when it's first called, and fails that call instead
+    const std::pair<std::string, int> sources[] = {{"fun f() { return 1; { var a = a; } } f();", EX_SOFTWARE},
+                                                   {"if (false) { var b = 1; var b = 2; }", EX_DATAERR}};
+    for (const auto &[source, lazyStatus]: sources) {
+        const std::string script = ::testing::TempDir() + "pruned.lox";
+        std::ofstream(script) << source;
+        for (const bool optimize: {true, false})
+            for (const bool lazyBodies: {false, true}) {
+                Runner::Options options;
+                options.cache = false;
+                options.optimize = optimize;
+                options.lazyBodies = lazyBodies;
+                std::ostringstream output;
+                std::streambuf *old = std::cout.rdbuf(output.rdbuf());
+                const int status = Runner::runScript(script, options);
+                std::cout.rdbuf(old);
+                EXPECT_EQ(status, lazyBodies ? lazyStatus : EX_DATAERR) << source << (optimize ? " optimized" : "") << (lazyBodies ? " lazy" : "");
+                Errors::hadError = false;
+                Errors::hadRuntimeError = false;
+                Diagnostics::global().clear();
+            }
+    }
+}
+
+TEST(InterpreterTest, OptimizerFoldsConstants) {
+    const std::string source = "print 1 + 2 * (3 - 1);\n"
+                               "print \"one\" + 1;\n"
+                               "if (!true) print 1; else print nil or \"b\";\n"
+                               "while (1 > 2) print 2;\n"
+                               "fun f() { return 1; print 3; { print 4; } }\n";
+    Arena arena;
+    Scanner scanner(source);
+    Optimizer optimizer(arena);
+    const std::vector<AST::pStmt> program = optimizer.optimize(Parser(scanner, arena).parse());
+    ASSERT_EQ(program.size(), 4u);
+
+    const auto expression = [](const AST::pStmt &statement) { return std::get<AST::pPrintStmt>(statement)->expression; };
+    EXPECT_EQ(std::get<double>(std::get<AST::pLiteralExpr>(expression(program[0]))->value), 5.0);
+    EXPECT_TRUE(std::get<AST::pLiteralExpr>(expression(program[0]))->exactInteger);
+    // would fail at run time, so it stays for the interpreter to report on line 2
+    EXPECT_EQ(std::get<AST::pBinaryExpr>(expression(program[1]))->op.line, 2u);
+    EXPECT_EQ(std::get<std::string_view>(std::get<AST::pLiteralExpr>(expression(program[2]))->value), "b");
+    // what follows a return can't run
+    EXPECT_EQ(std::get<AST::pFunctionStmt>(program[3])->body.size(), 1u);
+    EXPECT_EQ(optimizer.prunedStmts(), 4u);
+}
+
+TEST(InterpreterTest, LoopHoisterKeepsBehaviour) {
+    const std::string source = "var g = 1; fun bump() { g = g + 1; }\n"
+                               "var s = 0; for (var i = 0; i < 3; i = i + 1) { s = s + g * 2; bump(); } print s;\n"
+                               "{ var l = 3; var t = 0; var k = 0; while (k < 3) { t = t + l * 2 + g * 2; bump(); k = k + 1; } print t; }\n"
+                               "fun f(n) { for (var i = 0; i < 2; i = i + 1) for (var j = 0; j < 2; j = j + 1) print (n + 1) * j + -(n * i); }\n"
+                               "f(1);\n"
+                               "var x = \"a\"; var y = 0; while (y < 2) print (y = y + 1) + x * 2;\n";
+    // the runtime error of the last line is logged after everything else
+    const std::string expected = printed(source, treeWalk);
+    EXPECT_EQ(expected.rfind("12\n48\n0\n2\n-1\n1\n", 0), 0u);
+    EXPECT_NE(expected.find("(6) : Operands must be numbers."), std::string::npos);
+    EXPECT_EQ(printed(source, treeWalk, hoist), expected);
+    EXPECT_EQ(printed(source, flatWalk, hoist), expected);
+    EXPECT_EQ(printed(source, vmWalk, hoist), expected);
+    EXPECT_EQ(printed(source, closureWalk, hoist), expected);
+
+    Arena arena;
+    Scanner scanner(source);
+    LoopHoister hoister(arena);
+    const std::vector<AST::pStmt> program = hoister.hoist(Parser(scanner, arena).parse());
+    // l * 2, x * 2, and in f (n + 1) for the outer loop and -(n * i) for the inner one;
+    // g * 2 changes with every call to bump
+    EXPECT_EQ(hoister.hoistedExprs(), 4u);
+    // x * 2 gets a global temporary, declared right before its loop
+    ASSERT_EQ(program.size(), 12u);
+    EXPECT_TRUE(std::holds_alternative<AST::pVarStmt>(program[10]));
+}
+
+TEST(InterpreterTest, SubexpressionEliminatorKeepsBehaviour) {
+    const std::string source = "var a = 3; var b = 4; var g = 1; fun bump() { g = g + 1; }\n"
+                               "print (a * b + 1) * (a * b + 1) - a * b;\n"
+                               "var c = a * b; a = 5; print a * b + c;\n"
+                               "print g * 2 == bump(); print g * 2;\n"
+                               "print a * b > 10 and a * b; print (nil or a * b) + a * b;\n"
+                               "{ var a = 1; var x = -(a * b); if (x + -(a * b) < 0) print a * b; }\n"
+                               "fun f(n, m) { var s = n * m + n * m; n = n + 1; print s + n * m + n * m; }\n"
+                               "f(2, 3);\n";
+    const std::string expected = "157\n32\nFALSE\n4\n20\n40\n4\n30\n";
+    EXPECT_EQ(printed(source, treeWalk), expected);
+    EXPECT_EQ(printed(source, treeWalk, eliminate), expected);
+    EXPECT_EQ(printed(source, flatWalk, eliminate), expected);
+    EXPECT_EQ(printed(source, vmWalk, eliminate), expected);
+    EXPECT_EQ(printed(source, closureWalk, eliminate), expected);
+
+    Arena arena;
+    Scanner scanner("var a = 1; var b = 2; print (a * b + 1) * (a * b + 1) + a * b; a = 2; print a * b - a * b;");
+    SubexpressionEliminator eliminator(arena);
+    const std::vector<AST::pStmt> program = eliminator.eliminate(Parser(scanner, arena).parse());
+    // a * b + 1 in the first print, and a * b for each value of a; the inner
+    // a * b of the second a * b + 1 is never computed, so it doesn't count
+    EXPECT_EQ(eliminator.sharedExprs(), 3u);
+    ASSERT_EQ(program.size(), 8u);
+    const auto first = std::get<AST::pBinaryExpr>(std::get<AST::pPrintStmt>(program[5])->expression);
+    EXPECT_TRUE(std::holds_alternative<AST::pVariableExpr>(first->right));
+}
+
+TEST(InterpreterTest, HeapFreesGarbage) {
+    const std::string source = "var s = \"\"; fun grow(t) { for (var i = 0; i < 50; i = i + 1) t = t + \"ab\"; print t == s; }\n"
+                               "for (var i = 0; i < 200; i = i + 1) { s = s + \"ab\"; if (i == 49) grow(\"\"); }\n"
+                               "print s == s + \"\"; print \"a\" + \"b\" == \"ab\"; print grow == grow;\n";
+    const std::string expected = "TRUE\nTRUE\nTRUE\nTRUE\n";
+    for (const auto walk: {treeWalk, flatWalk, vmWalk, closureWalk}) {
+        EXPECT_EQ(printed(source, walk), expected);
+        Heap::global().collect();
+        // only the strings nothing refers to any more are gone: those of the finished runs
+        EXPECT_LT(Heap::global().liveObjects(), 10u);
+    }
+    EXPECT_TRUE(Value(3.0) == Value(3.0));
+    EXPECT_FALSE(Value(0.0 / 0.0) == Value(0.0 / 0.0));
+    EXPECT_TRUE(Value(-0.0 / 0.0).isNumber());
+    EXPECT_TRUE(Value().isNil());
+    EXPECT_FALSE(Value(false).isTruthy());
+    EXPECT_TRUE(Value(0.0).isTruthy());
+}
+
+TEST(InterpreterTest, StringLiteralsAreMadeOnce) {
+    const std::string source = "for (var i = 0; i < 100; i = i + 1) print \"x\"; print \"x\";\n";
+    for (const auto walk: {treeWalk, flatWalk}) {
+        std::size_t made = 0;
+        const std::string output = printed(source, [walk, &made](Interpreter &interpreter, const std::vector<AST::pStmt> &program) {
+            const std::size_t before = Heap::global().liveObjects();
+            walk(interpreter, program);
+            made = Heap::global().liveObjects() - before;
+        });
+        EXPECT_EQ(output.size(), 2u * 101);
+        EXPECT_EQ(made, 1u);
+    }
+}
+
+TEST(InterpreterTest, LazyBodiesParseOnFirstCall) {
+    const std::string source = "fun outer(n) { fun inner(m) { print m * 2; } inner(n + 1); print 1 + 1; }\n"
+                               "fun unused() { this is not { valid } lox; }\n"
+                               "outer(1); outer(2);\n";
+    Arena arena;
+    Scanner scanner(source);
+    Interpreter interpreter;
+    const std::vector<AST::pStmt> program = Optimizer(arena).optimize(Parser(scanner, arena, true).parse());
+    ASSERT_TRUE(Resolver(arena, interpreter.globals).resolve(program));
+    const auto outer = std::get<AST::pFunctionStmt>(program[0]);
+    ASSERT_NE(outer->lazy, nullptr);
+    EXPECT_TRUE(outer->lazy->optimize);
+    EXPECT_TRUE(outer->body.empty());
+
+    std::ostringstream output;
+    std::streambuf *old = std::cout.rdbuf(output.rdbuf());
+    interpreter.interpret(program);
+    std::cout.rdbuf(old);
+    EXPECT_EQ(output.str(), "4\n2\n6\n2\n");
+    EXPECT_EQ(outer->lazy, nullptr);
+    EXPECT_EQ(outer->body.size(), 3u);
+    // folded once the body was parsed
+    EXPECT_TRUE(std::holds_alternative<AST::pLiteralExpr>(std::get<AST::pPrintStmt>(outer->body[2])->expression));
+    EXPECT_NE(std::get<AST::pFunctionStmt>(program[1])->lazy, nullptr);
+
+    // a body's syntax errors fail the call like a runtime error, and leave the run's flag alone
+    Scanner call("unused();");
+    const std::vector<AST::pStmt> later = Parser(call, arena).parse();
+    ASSERT_TRUE(Resolver(arena, interpreter.globals).resolve(later));
+    const bool hadError = Errors::hadError;
+    const bool hadRuntimeError = Errors::hadRuntimeError;
+    Errors::hadRuntimeError = false;
+    old = std::cout.rdbuf(output.rdbuf());
+    interpreter.interpret(later);
+    std::cout.rdbuf(old);
+    EXPECT_NE(output.str().find("Can't call 'unused', its body has errors."), std::string::npos);
+    EXPECT_TRUE(Errors::hadRuntimeError);
+    EXPECT_EQ(Errors::hadError, hadError);
+    Errors::hadRuntimeError = hadRuntimeError;
+}
+
+TEST(InterpreterTest, CacheRoundTrip) {
+    const std::string source = "var s = \"a\" + \"b\"; fun f(n) { var m = n * 2; { var k = m; print k + 0.5; } }\n"
+                               "fun g(n) { if (n) return; return 1; }\n"
+                               "for (var i = 0; i < 2; i = i + 1) f(i); print s; print f; print g(true); print g(false);\n"
+                               "fun counter(n) { fun inc() { n = n + 1; return n; } return inc; } var c = counter(1); c(); print c();\n";
+    const std::string expected = "0.5\n2.5\nab\n<fn f>\nNULL\n1\n3\n";
+
+    Arena arena;
+    Scanner scanner(source);
+    Interpreter writer;
+    const std::vector<AST::pStmt> program = Optimizer(arena).optimize(Parser(scanner, arena).parse());
+    ASSERT_TRUE(Resolver(arena, writer.globals).resolve(program));
+    Runner::Options options;
+    options.cacheDirectory = ::testing::TempDir();
+    Cache(".lox", source, options).store(program, writer.globals);
+
+    // a fresh interpreter hands out its own global slots
+    Interpreter reader;
+    reader.globals.slot(intern("unrelated"));
+    Arena loaded;
+    std::optional<std::vector<AST::pStmt>> cached = Cache(".lox", source, options).load(loaded, reader.globals);
+    ASSERT_TRUE(cached.has_value());
+    std::ostringstream output;
+    std::streambuf *old = std::cout.rdbuf(output.rdbuf());
+    reader.interpret(*cached);
+    std::cout.rdbuf(old);
+    EXPECT_EQ(output.str(), expected);
+
+    // a different source, or one compiled without the Optimizer, misses
+    EXPECT_FALSE(Cache(".lox", source + " ", options).load(loaded, reader.globals).has_value());
+    // even one that differs in the top bits of bytes 7 and 15 only, which a hash
+    // over whole words with a multiply each can let cancel out
+    std::string flipped = source;
+    flipped[7] = static_cast<char>(flipped[7] ^ 0x80);
+    flipped[15] = static_cast<char>(flipped[15] ^ 0x80);
+    EXPECT_FALSE(Cache(".lox", flipped, options).load(loaded, reader.globals).has_value());
+
+    // a file cut short or changed after it was written misses, whatever the header says
+    const std::string path = Cache(".lox", source, options).path();
+    std::ostringstream stored;
+    stored << std::ifstream(path, std::ios::binary).rdbuf();
+    const std::string bytes = stored.str();
+    const auto misses = [&](const std::string &contents) {
+        // a new file under the old name, as the loaded program still views into the old one
+        std::ofstream(path + ".tmp", std::ios::binary) << contents;
+        std::rename((path + ".tmp").c_str(), path.c_str());
+        Arena arena;
+        return !Cache(".lox", source, options).load(arena, reader.globals).has_value();
+    };
+    EXPECT_TRUE(misses(bytes.substr(0, bytes.size() - 3)));
+    std::string corrupt = bytes;
+    corrupt[bytes.size() / 2] = static_cast<char>(corrupt[bytes.size() / 2] ^ 0x5a);
+    corrupt[bytes.size() - 2] = static_cast<char>(corrupt[bytes.size() - 2] ^ 0x01);
+    EXPECT_TRUE(misses(corrupt));
+    EXPECT_TRUE(misses(bytes + "\x01"));
+    EXPECT_FALSE(misses(bytes));
+
+    options.optimize = false;
+    EXPECT_FALSE(Cache(".lox", source, options).load(loaded, reader.globals).has_value());
+}
+
+TEST(InterpreterTest, ParserCollectsDiagnostics) {
+    // one error per statement, then the parse picks up at the next one
+    const std::string source = "var = 1;\nprint (2;\nprint 3 @ 4;\n1 = 2;\nprint \"ok\";\nfun f( { }\nvar x = 5";
+    Diagnostics diagnostics;
+    Arena arena;
+    Scanner scanner(source, diagnostics);
+    const std::vector<AST::pStmt> program = Parser(scanner, arena, false, diagnostics).parse();
+
+    std::vector<int> lines;
+    for (const Diagnostic &diagnostic: diagnostics.errors()) lines.push_back(diagnostic.line);
+    EXPECT_EQ(lines, (std::vector<int>{1, 2, 3, 3, 4, 6, 7}));
+    EXPECT_EQ(diagnostics.errors()[0].message, " at '=': Expect variable name.");
+    EXPECT_EQ(diagnostics.errors().back().message, " at end: Expect ';' after variable declaration.");
+    // the invalid assignment target is reported without dropping its statement
+    ASSERT_EQ(program.size(), 7u);
+    EXPECT_TRUE(std::holds_alternative<AST::pExpressionStmt>(program[3]));
+    EXPECT_TRUE(std::holds_alternative<AST::pPrintStmt>(program[4]));
 }
@@ -0,0 +1,132 @@
+#include "gtest/gtest.h"
+
+#include "Scanner.h"
+#include "Simd.h"
+#include "TokenStream.h"
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace cpplox;
+
+namespace {
+
+    // every vector kernel must stop where the scalar one does and count the same lines
+    void expectSameAsScalar(const simd::Kernels &kernels, const std::string &input) {
+        const simd::Kernels &reference = simd::scalar();
+        const char *begin = input.data();
+        const char *end = begin + input.size();
+        for (std::size_t i = 0; i <= input.size(); i++) {
+            int expectedLines = 0, lines = 0;
+            EXPECT_EQ(reference.skipWhitespace(begin + i, end, expectedLines), kernels.skipWhitespace(begin + i, end, lines));
+            EXPECT_EQ(expectedLines, lines);
+            EXPECT_EQ(reference.skipToNewline(begin + i, end), kernels.skipToNewline(begin + i, end));
+            EXPECT_EQ(reference.skipIdentifier(begin + i, end), kernels.skipIdentifier(begin + i, end));
+            expectedLines = lines = 0;
+            EXPECT_EQ(reference.skipToQuote(begin + i, end, expectedLines), kernels.skipToQuote(begin + i, end, lines));
+            EXPECT_EQ(expectedLines, lines);
+        }
+    }
+
+    std::string randomInput(std::mt19937 &rng, std::size_t length) {
+        // biased towards long runs, with a few bytes above 0x7f
+        static const std::string alphabet = "    \t\r\n\n\"abcxyzAZ_09@[`{/\x80\xff";
+        std::uniform_int_distribution<std::size_t> pick(0, alphabet.size() - 1);
+        std::uniform_int_distribution<std::size_t> run(1, 40);
+        std::string input;
+        while (input.size() < length) input.append(run(rng), alphabet[pick(rng)]);
+        return input;
+    }
+
+}// namespace
+
+TEST(ScannerTest, SimdKernelsMatchScalar) {
+    std::vector<const simd::Kernels *> available{simd::sse2(), simd::avx2()};
+    std::mt19937 rng(42);
+    for (int round = 0; round < 20; round++) {
+        const std::string input = randomInput(rng, 300);
+        for (const simd::Kernels *kernels: available)
+            if (kernels) expectSameAsScalar(*kernels, input);
+    }
+}
+
+TEST(ScannerTest, CountsLinesAcrossRuns) {
+    const std::string source = "var a;\n\n   \t\n// comment \"\nprint \"one\ntwo\";\r\n  x_123456789012345678901234567890";
+    const TokenList tokens = Scanner(source).scanTokens();
+    ASSERT_EQ(tokens.size(), 8u);
+    EXPECT_EQ(tokens[0].line, 1u);
+    EXPECT_EQ(tokens[3].type, TokenType::PRINT);
+    EXPECT_EQ(tokens[3].line, 5u);
+    EXPECT_EQ(tokens.lexeme(4), "\"one\ntwo\"");
+    EXPECT_EQ(tokens[5].line, 6u);
+    EXPECT_EQ(tokens[5].type, TokenType::SEMICOLON);
+    EXPECT_EQ(tokens[6].type, TokenType::IDENTIFIER);
+    EXPECT_EQ(tokens[6].line, 7u);
+}
+
+TEST(ScannerTest, TagsExactIntegerLiterals) {
+    const std::string source = "0 42 7.0 7.25 9007199254740991 9007199254740993 1.000000000000000001";
+    const TokenList tokens = Scanner(source).scanTokens();
+    ASSERT_EQ(tokens.size(), 8u);
+    const bool exact[] = {true, true, true, false, true, false, false};
+    for (std::size_t i = 0; i < 7; i++) EXPECT_EQ(tokens[i].isExactInteger(), exact[i]) << tokens.lexeme(i);
+    EXPECT_EQ(tokens.number(1), 42.0);
+    EXPECT_EQ(tokens.number(3), 7.25);
+    EXPECT_EQ(tokens.number(6), 1.0);
+}
+
+TEST(ScannerTest, StreamMatchesScanTokens) {
+    const std::string source = "fun f(a, b) { return a >= b; } // done\nprint f(1, 2.5) == !nil;";
+    const TokenList expected = Scanner(source).scanTokens();
+    Scanner scanner(source);
+    TokenStream stream(scanner);
+    for (std::size_t i = 0; i < expected.size(); i++) {
+        EXPECT_EQ(stream.peek().type, expected[i].type);
+        EXPECT_EQ(stream.lexeme(stream.peek()), expected.lexeme(i));
+        stream.advance();
+        if (expected[i].type == TokenType::EOF_TOKEN) continue;
+        EXPECT_EQ(stream.lexeme(stream.previous()), expected.lexeme(i));
+        if (expected[i].type == TokenType::NUMBER) { EXPECT_EQ(stream.previousNumber(), expected.number(i)); }
+        if (expected[i].type == TokenType::IDENTIFIER) {
+            EXPECT_EQ(stream.previousSymbol(), expected.symbol(i));
+            EXPECT_EQ(SymbolTable::global().name(stream.previousSymbol()), expected.lexeme(i));
+        }
+    }
+    EXPECT_EQ(stream.peek().type, TokenType::EOF_TOKEN);
+}
+
+TEST(ScannerTest, ParallelMatchesSequential) {
+    // large enough for many pieces, with string literals that run across piece
+    // boundaries (some across several) and bytes that only lex inside a string
+    std::mt19937 rng(7);
+    std::string source;
+    for (int i = 0; source.size() < 2 * 1024 * 1024; i++) {
+        source += "var v" + std::to_string(i % 97) + " = " + std::to_string(i) + ".5 + w; // note @\n";
+        if (i % 500 == 0) {
+            source += "print \"";
+            const std::size_t lines = rng() % (i % 3000 == 0 ? 8000 : 40);
+            for (std::size_t l = 0; l < lines; l++) source += "@ # not code var x = 1;\n";
+            source += "\";\n";
+        }
+    }
+
+    std::ostringstream output;
+    std::streambuf *old = std::cout.rdbuf(output.rdbuf());
+    const TokenList expected = Scanner(source).scanTokens();
+    const TokenList actual = Scanner::scanTokensParallel(source, 8, 1);
+    std::cout.rdbuf(old);
+    EXPECT_EQ(output.str(), "");
+
+    ASSERT_EQ(actual.size(), expected.size());
+    for (std::size_t i = 0; i < expected.size(); i++) {
+        ASSERT_EQ(actual[i].type, expected[i].type) << "token " << i;
+        ASSERT_EQ(actual[i].line, expected[i].line) << "token " << i;
+        ASSERT_EQ(actual[i].offset, expected[i].offset) << "token " << i;
+        ASSERT_EQ(actual[i].length, expected[i].length) << "token " << i;
+        // braced: the macros end in an if of their own, see -Wdangling-else
+        if (expected[i].type == TokenType::NUMBER) { ASSERT_EQ(actual.number(i), expected.number(i)); }
+        if (expected[i].type == TokenType::IDENTIFIER) { ASSERT_EQ(actual.symbol(i), expected.symbol(i)); }
+    }
+}